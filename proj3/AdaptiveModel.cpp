@@ -0,0 +1,201 @@
+/**
+ * File: AdaptiveModel.cpp
+ * Description: Implements AdaptiveModel and the "ZADP" stream framing.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#include "AdaptiveModel.h"
+#include "BlockFormat.h"
+#include "CanonicalCode.h"
+#include "LengthLimit.h"
+#include "ZapFormat.h"
+#include <stdexcept>
+#include <string>
+
+/**
+ * name:       AdaptiveModel
+ * purpose:    Starts a model that has seen no text: every byte has a count
+ *             of 1, so every code is 8 bits long.
+ * arguments:  max_code_length - the longest code the model may build,
+ *             MIN_ADAPTIVE_CODE_LENGTH to 63.
+ * returns:    n/a
+ * effects:    Builds the first code. Throws a runtime_error if
+ *             ++max_code_length++ is out of range.
+ */
+AdaptiveModel::AdaptiveModel(int max_code_length)
+    : max_length(max_code_length), total(256), table_current(false) {
+    if (max_length < MIN_ADAPTIVE_CODE_LENGTH or max_length > 63) {
+        throw std::runtime_error("Adaptive code length limit must be from "
+                                 "8 to 63.");
+    }
+    counts.fill(1);
+    rebuild();
+}
+
+/**
+ * name:       update
+ * purpose:    Counts a segment once it has been coded, and rebuilds the
+ *             code the next segment is coded with.
+ * arguments:  frequencies - the count of each byte in the segment.
+ * returns:    void
+ * effects:    Adds to the counts, halving them (but never below 1) while
+ *             they sum past ADAPTIVE_DECAY_LIMIT, then rebuilds the code.
+ */
+void AdaptiveModel::update(const FrequencyTable &frequencies) {
+    for (int symbol = 0; symbol < 256; symbol++) {
+        counts[symbol] += frequencies[symbol];
+        total += frequencies[symbol];
+    }
+    while (total > ADAPTIVE_DECAY_LIMIT) {
+        total = 0;
+        for (uint64_t &count : counts) {
+            count = (count + 1) / 2;
+            total += count;
+        }
+    }
+    rebuild();
+}
+
+/**
+ * name:       codes
+ * purpose:    Gives the code the next segment is encoded with.
+ * arguments:  none
+ * returns:    The code word of every byte.
+ * effects:    None.
+ */
+const CodeTable &AdaptiveModel::codes() const {
+    return code_table;
+}
+
+/**
+ * name:       lengths
+ * purpose:    Gives the code lengths of the current code.
+ * arguments:  none
+ * returns:    The code length of every byte.
+ * effects:    None.
+ */
+const CodeLengths &AdaptiveModel::lengths() const {
+    return code_lengths;
+}
+
+/**
+ * name:       decodeTable
+ * purpose:    Gives the table the next segment is decoded with.
+ * arguments:  none
+ * returns:    The decode table of the current code.
+ * effects:    Builds the table the first time it is asked for after each
+ *             rebuild, so an encoder never pays for it.
+ */
+const HuffmanDecodeTable &AdaptiveModel::decodeTable() {
+    if (not table_current) {
+        decode_table.build(code_table);
+        table_current = true;
+    }
+    return decode_table;
+}
+
+/**
+ * name:       rebuild
+ * purpose:    Makes the code from the counts.
+ * arguments:  none
+ * returns:    void
+ * effects:    Sets code_lengths and code_table. Depends only on the
+ *             counts and max_length, which is what keeps the encoder and
+ *             decoder in step.
+ */
+void AdaptiveModel::rebuild() {
+    code_lengths = huffmanCodeLengths(counts);
+    if (maxCodeLength(code_lengths) > max_length) {
+        code_lengths = lengthLimitedCodeLengths(counts, max_length);
+    }
+    code_table = canonicalCodes(code_lengths);
+    table_current = false;
+}
+
+/**
+ * name:       writeAdaptiveHeader
+ * purpose:    Starts an adaptive stream.
+ * arguments:  out - the file to write to.
+ *             interval - the most text any segment will hold.
+ *             max_code_length - the model's code length limit.
+ * returns:    void
+ * effects:    Writes the magic, ++interval++ and ++max_code_length++ to
+ *             ++out++.
+ */
+void writeAdaptiveHeader(FileWriter &out, uint64_t interval,
+                         int max_code_length) {
+    std::string header = ADAPTIVE_MAGIC;
+    putVarint(header, interval);
+    putVarint(header, static_cast<uint64_t>(max_code_length));
+    out.write(header);
+}
+
+/**
+ * name:       readAdaptiveHeader
+ * purpose:    Reads the rest of an adaptive stream header after its magic.
+ * arguments:  in - the stream, positioned just past ADAPTIVE_MAGIC.
+ *             interval - set to the stream's segment size.
+ *             max_code_length - set to the model's code length limit.
+ * returns:    void
+ * effects:    Throws a runtime_error if the interval is 0 or larger than
+ *             MAX_BLOCK_SIZE, or the limit is one no model can have.
+ */
+void readAdaptiveHeader(FileReader &in, uint64_t &interval,
+                        int &max_code_length) {
+    interval = readVarint(in);
+    uint64_t limit = readVarint(in);
+    if (interval == 0 or interval > MAX_BLOCK_SIZE or
+            limit < MIN_ADAPTIVE_CODE_LENGTH or limit > 63) {
+        throw std::runtime_error("Zapped adaptive stream is malformed.");
+    }
+    max_code_length = static_cast<int>(limit);
+}
+
+/**
+ * name:       writeSegmentHeader
+ * purpose:    Writes the lengths that start a segment, or end the stream.
+ * arguments:  out - the file to write to.
+ *             text_size - the number of bytes the segment holds; 0 ends
+ *             the stream.
+ *             payload_size - the number of payload bytes that follow.
+ * returns:    void
+ * effects:    Writes to ++out++; only the 0 when ++text_size++ is 0.
+ */
+void writeSegmentHeader(FileWriter &out, uint64_t text_size,
+                        uint64_t payload_size) {
+    std::string header;
+    putVarint(header, text_size);
+    if (text_size > 0) {
+        putVarint(header, payload_size);
+    }
+    out.write(header);
+}
+
+/**
+ * name:       readSegmentHeader
+ * purpose:    Reads the lengths that start a segment.
+ * arguments:  in - the stream, positioned at a segment.
+ *             interval - the stream's segment size.
+ *             max_code_length - the model's code length limit.
+ *             text_size - set to the number of bytes the segment holds.
+ *             payload_size - set to the number of payload bytes.
+ * returns:    false at the end of the stream, true otherwise.
+ * effects:    Throws a runtime_error if the stream is truncated, a segment
+ *             is longer than ++interval++, or its payload is longer than
+ *             its text could code to.
+ */
+bool readSegmentHeader(FileReader &in, uint64_t interval,
+                       int max_code_length, uint64_t &text_size,
+                       uint64_t &payload_size) {
+    text_size = readVarint(in);
+    if (text_size == 0) {
+        return false;
+    }
+    payload_size = readVarint(in);
+    if (text_size > interval or
+            payload_size > (text_size * max_code_length + 7) / 8) {
+        throw std::runtime_error("Zapped adaptive stream is malformed.");
+    }
+    return true;
+}
@@ -0,0 +1,70 @@
+/**
+ * File: AdaptiveModel.h
+ * Description: Declares AdaptiveModel and the framing of the "ZADP"
+ * adaptive stream, which codes text as it arrives instead of counting it
+ * first. The text is cut into segments of at most the stream's interval,
+ * and each segment is coded with a canonical code built from the bytes
+ * before it; the encoder and decoder count every segment and rebuild the
+ * code the same way, so no code is ever stored. Counts start at 1 for
+ * every byte, so any byte can be coded, and are halved whenever they sum
+ * past ADAPTIVE_DECAY_LIMIT, so the code follows text that changes. A
+ * stream is the magic, the interval and the code length limit as
+ * varints, then per segment its text and payload lengths as varints and
+ * the payload; a text length of 0 ends it.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#ifndef ADAPTIVEMODEL_H
+#define ADAPTIVEMODEL_H
+
+#include <cstddef>
+#include <cstdint>
+#include "FileIO.h"
+#include "HuffmanCode.h"
+#include "HuffmanDecodeTable.h"
+
+// segment size used when --adaptive is given no interval
+static const uint64_t DEFAULT_ADAPTIVE_INTERVAL = 1 << 14;
+// the most the counts may sum to before they are halved
+static const uint64_t ADAPTIVE_DECAY_LIMIT = 1 << 16;
+// code length limit used when the options set none
+static const int DEFAULT_ADAPTIVE_CODE_LENGTH = 15;
+// every byte keeps a code, and 256 of them need 8 bits
+static const int MIN_ADAPTIVE_CODE_LENGTH = 8;
+
+class AdaptiveModel {
+public:
+    explicit AdaptiveModel(int max_code_length);
+
+    void update(const FrequencyTable &frequencies);
+
+    const CodeTable &codes() const;
+    const CodeLengths &lengths() const;
+    const HuffmanDecodeTable &decodeTable();
+
+private:
+    void rebuild();
+
+    int max_length;
+    FrequencyTable counts;
+    uint64_t total;
+    CodeLengths code_lengths;
+    CodeTable code_table;
+    // built from code_table when a decoder first asks after a rebuild
+    HuffmanDecodeTable decode_table;
+    bool table_current;
+};
+
+void writeAdaptiveHeader(FileWriter &out, uint64_t interval,
+                         int max_code_length);
+void readAdaptiveHeader(FileReader &in, uint64_t &interval,
+                        int &max_code_length);
+
+void writeSegmentHeader(FileWriter &out, uint64_t text_size,
+                        uint64_t payload_size);
+bool readSegmentHeader(FileReader &in, uint64_t interval,
+                       int max_code_length, uint64_t &text_size,
+                       uint64_t &payload_size);
+
+#endif
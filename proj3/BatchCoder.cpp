@@ -0,0 +1,627 @@
+/**
+ * File: BatchCoder.cpp
+ * Description: Implements BatchCoder and the listing of batch inputs.
+ * Jobs are handed to the pool in order and finished in the same order,
+ * so an archive lists its files as they were given and at most a few
+ * files per worker are held in memory at once.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#include "BatchCoder.h"
+#include "ZapFormat.h"
+#include <sys/stat.h>
+#include <dirent.h>
+#include <cerrno>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+const std::string ZAPPED_SUFFIX = ".zap";
+
+/**
+ * name:       checkName
+ * purpose:    Makes sure a name stays inside the directory it is put in.
+ * arguments:  name - a relative path from a list or an archive.
+ * returns:    void
+ * effects:    Throws a runtime_error if ++name++ is empty, too long,
+ *             absolute, or has an empty, "." or ".." part.
+ */
+static void checkName(const std::string& name) {
+    bool valid = not name.empty() and name.size() <= MAX_BATCH_NAME_SIZE
+                    and name[0] != '/';
+    size_t start = 0;
+    while (valid and start <= name.size()) {
+        size_t end = std::min(name.find('/', start), name.size());
+        std::string part = name.substr(start, end - start);
+        valid = not part.empty() and part != "." and part != ".." and
+                part.find('\0') == std::string::npos;
+        start = end + 1;
+    }
+    if (not valid) {
+        throw std::runtime_error("Batch file name " + name +
+                                 " is not a relative path.");
+    }
+}
+
+/**
+ * name:       relativeName
+ * purpose:    Picks the name a listed file is stored under.
+ * arguments:  path - the path as listed.
+ * returns:    ++path++ without leading slashes or "./" parts, so
+ *             "/data/a.txt" is stored as "data/a.txt".
+ * effects:    None.
+ */
+static std::string relativeName(const std::string& path) {
+    size_t start = 0;
+    while (start < path.size()) {
+        if (path[start] == '/') {
+            start++;
+        } else if (path.compare(start, 2, "./") == 0) {
+            start += 2;
+        } else {
+            break;
+        }
+    }
+    return path.substr(start);
+}
+
+/**
+ * name:       joinPath
+ * purpose:    Puts a relative name under a directory.
+ * arguments:  dir - the directory.
+ *             name - the relative name.
+ * returns:    The joined path.
+ * effects:    None.
+ */
+static std::string joinPath(const std::string& dir, const std::string& name) {
+    if (dir.empty() or dir.back() == '/') {
+        return dir + name;
+    }
+    return dir + "/" + name;
+}
+
+/**
+ * name:       makeParentDirectories
+ * purpose:    Creates the directories a file is about to be written in.
+ * arguments:  path - the file's path.
+ * returns:    void
+ * effects:    Creates every missing directory on the way to ++path++.
+ *             Throws a runtime_error if one cannot be created.
+ */
+static void makeParentDirectories(const std::string& path) {
+    for (size_t slash = path.find('/', 1); slash != std::string::npos;
+                                        slash = path.find('/', slash + 1)) {
+        std::string dir = path.substr(0, slash);
+        // workers may race to make the same directory; either one wins
+        if (::mkdir(dir.c_str(), 0755) != 0 and errno != EEXIST) {
+            throw std::runtime_error("Unable to create directory " + dir);
+        }
+    }
+}
+
+/**
+ * name:       writeFile
+ * purpose:    Writes one result of a batch.
+ * arguments:  path - the file to write.
+ *             bytes - its contents.
+ *             stats - the job's record, which the time is added to.
+ * returns:    void
+ * effects:    Creates ++path++ and its directories. Throws a runtime_error
+ *             if it cannot be written.
+ */
+static void writeFile(const std::string& path,
+                      const std::vector<unsigned char>& bytes,
+                      CoderStats& stats) {
+    StageTimer write(stats, WRITE_STAGE);
+    makeParentDirectories(path);
+    FileWriter output(path);
+    output.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+    output.close();
+}
+
+/**
+ * name:       listDirectory
+ * purpose:    Lists the files under a directory, for listBatchFiles.
+ * arguments:  dir - the directory to walk.
+ *             prefix - the name of ++dir++ relative to where the walk
+ *             started; empty at the top.
+ *             files - each file found is appended here.
+ * returns:    void
+ * effects:    Walks subdirectories too, in name order. Symbolic links are
+ *             skipped, so a link cannot make the walk loop. Throws a
+ *             runtime_error if a directory cannot be read.
+ */
+static void listDirectory(const std::string& dir, const std::string& prefix,
+                          std::vector<BatchFile>& files) {
+    DIR* listing = ::opendir(dir.c_str());
+    if (not listing) {
+        throw std::runtime_error("Unable to read directory " + dir);
+    }
+    std::vector<std::string> entries;
+    while (struct dirent* entry = ::readdir(listing)) {
+        std::string name = entry->d_name;
+        if (name != "." and name != "..") {
+            entries.push_back(name);
+        }
+    }
+    ::closedir(listing);
+    std::sort(entries.begin(), entries.end());
+    for (const std::string& entry : entries) {
+        std::string path = joinPath(dir, entry);
+        std::string name = prefix.empty() ? entry : prefix + "/" + entry;
+        struct stat info;
+        if (::lstat(path.c_str(), &info) != 0) {
+            continue; // removed while the walk was going
+        }
+        if (S_ISDIR(info.st_mode)) {
+            listDirectory(path, name, files);
+        } else if (S_ISREG(info.st_mode)) {
+            files.push_back({path, name});
+        }
+    }
+}
+
+/**
+ * name:       listBatchFiles
+ * purpose:    Finds the files a batch codes.
+ * arguments:  source - a directory, whose files are all coded, or a list
+ *             of files: one path per line, optionally followed by a tab
+ *             and the name to store it under. STDIO_NAME reads the list
+ *             from stdin.
+ * returns:    The files, in order. A directory's files are named by their
+ *             path within it; a listed file by its path, made relative.
+ * effects:    Throws a runtime_error if ++source++ cannot be read or a
+ *             name is not a relative path.
+ */
+std::vector<BatchFile> listBatchFiles(const std::string& source) {
+    std::vector<BatchFile> files;
+    struct stat info;
+    if (source != STDIO_NAME and ::stat(source.c_str(), &info) == 0 and
+                                                S_ISDIR(info.st_mode)) {
+        listDirectory(source, "", files);
+        return files;
+    }
+    std::ifstream list_file;
+    if (source != STDIO_NAME) {
+        list_file.open(source);
+        if (not list_file) {
+            throw std::runtime_error("Unable to open file " + source);
+        }
+    }
+    std::istream& list = (source == STDIO_NAME) ? std::cin : list_file;
+    std::string line;
+    while (std::getline(list, line)) {
+        if (not line.empty() and line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty()) {
+            continue;
+        }
+        size_t tab = line.find('\t');
+        BatchFile file = {line.substr(0, tab), ""};
+        file.name = (tab == std::string::npos) ? relativeName(file.input)
+                                               : line.substr(tab + 1);
+        checkName(file.name);
+        files.push_back(file);
+    }
+    return files;
+}
+
+/**
+ * name:       isBatchArchive
+ * purpose:    Tells an archive from a directory or a list of files.
+ * arguments:  source - the batch input given to unzap.
+ * returns:    true if ++source++ is STDIO_NAME or starts with
+ *             ARCHIVE_MAGIC.
+ * effects:    Reads the start of ++source++ if it is a file.
+ */
+bool isBatchArchive(const std::string& source) {
+    if (source == STDIO_NAME) {
+        return true; // stdin cannot be looked at and then read again
+    }
+    struct stat info;
+    if (::stat(source.c_str(), &info) != 0 or not S_ISREG(info.st_mode)) {
+        return false;
+    }
+    FileReader input(source);
+    std::string magic(ARCHIVE_MAGIC.size(), '\0');
+    magic.resize(input.read(&magic[0], magic.size()));
+    return magic == ARCHIVE_MAGIC;
+}
+
+/**
+ * name:       readArchiveVarint
+ * purpose:    Reads a varint (see ZapFormat.h) from an archive.
+ * arguments:  in - the archive.
+ * returns:    The integer read.
+ * effects:    Throws a runtime_error if the varint is truncated or longer
+ *             than 64 bits.
+ */
+static uint64_t readArchiveVarint(FileReader& in) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        unsigned char byte;
+        if (not in.readByte(byte)) {
+            throw std::runtime_error("Zapped archive is truncated.");
+        }
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+    throw std::runtime_error("Zapped archive is malformed.");
+}
+
+/**
+ * name:       batchWorkers
+ * purpose:    Picks the size of the thread pool for a jobs option.
+ * arguments:  jobs - the files to code at once; 0 for one per hardware
+ *             thread.
+ * returns:    0 to code on the calling thread (one job), otherwise the
+ *             number of workers.
+ * effects:    None.
+ */
+static size_t batchWorkers(int jobs) {
+    size_t workers = jobs > 0 ? jobs : ThreadPool::hardwareThreads();
+    return workers > 1 ? workers : 0;
+}
+
+/**
+ * name:       BatchCoder
+ * purpose:    Constructs a BatchCoder.
+ * arguments:  options_in - the settings each file is zapped with.
+ *             options_in.jobs is the number of files coded at once, 0 for
+ *             one per hardware thread.
+ * returns:    n/a
+ * effects:    Starts the worker threads, unless there is one job.
+ */
+BatchCoder::BatchCoder(const CoderOptions& options_in)
+    : options(options_in), pool(batchWorkers(options_in.jobs)) {
+    options.jobs = 1;
+}
+
+/**
+ * name:       zap
+ * purpose:    Zaps files, each to a file of its own.
+ * arguments:  files - the files to zap.
+ *             output_dir - the directory the results are written under,
+ *             as each name plus ZAPPED_SUFFIX.
+ * returns:    The number of files zapped.
+ * effects:    Writes the results, creating directories as needed. Throws a
+ *             runtime_error if a file cannot be read or written, once no
+ *             file is still being coded.
+ */
+uint64_t BatchCoder::zap(const std::vector<BatchFile>& files,
+                         const std::string& output_dir) {
+    size_t k = 0;
+    return run([&](BatchJob& job) {
+        if (k == files.size()) {
+            return false;
+        }
+        job.input = files[k].input;
+        job.output = joinPath(output_dir, files[k].name + ZAPPED_SUFFIX);
+        k++;
+        return true;
+    }, true, nullptr);
+}
+
+/**
+ * name:       zapArchive
+ * purpose:    Zaps files into one archive.
+ * arguments:  files - the files to zap.
+ *             archive_file - the archive to write, or STDIO_NAME.
+ * returns:    The number of files zapped.
+ * effects:    Writes ++archive_file++, storing the files in the order
+ *             given. Throws a runtime_error as zap does.
+ */
+uint64_t BatchCoder::zapArchive(const std::vector<BatchFile>& files,
+                                const std::string& archive_file) {
+    FileWriter archive(archive_file);
+    archive.write(ARCHIVE_MAGIC);
+    size_t k = 0;
+    uint64_t count = run([&](BatchJob& job) {
+        if (k == files.size()) {
+            return false;
+        }
+        job.input = files[k].input;
+        job.name = files[k].name;
+        job.output.clear();
+        k++;
+        return true;
+    }, true, &archive);
+    std::string end;
+    putVarint(end, 0);
+    archive.write(end);
+    archive.close();
+    stats.output_bytes = archive.bytesWritten();
+    return count;
+}
+
+/**
+ * name:       unzap
+ * purpose:    Unzaps files, each to a file of its own.
+ * arguments:  files - the zapped files.
+ *             output_dir - the directory the results are written under,
+ *             as each name without ZAPPED_SUFFIX (or with ".out" added if
+ *             it has none).
+ * returns:    The number of files unzapped.
+ * effects:    Writes the results, creating directories as needed. Throws a
+ *             runtime_error if a file cannot be read, decoded or written,
+ *             once no file is still being coded.
+ */
+uint64_t BatchCoder::unzap(const std::vector<BatchFile>& files,
+                           const std::string& output_dir) {
+    size_t k = 0;
+    return run([&](BatchJob& job) {
+        if (k == files.size()) {
+            return false;
+        }
+        std::string name = files[k].name;
+        size_t suffix = ZAPPED_SUFFIX.size();
+        if (name.size() > suffix and
+                name.compare(name.size() - suffix, suffix, ZAPPED_SUFFIX) == 0) {
+            name.resize(name.size() - suffix);
+        } else {
+            name += ".out";
+        }
+        job.input = files[k].input;
+        job.output = joinPath(output_dir, name);
+        k++;
+        return true;
+    }, false, nullptr);
+}
+
+/**
+ * name:       unzapArchive
+ * purpose:    Unzaps every file in an archive.
+ * arguments:  archive_file - the archive, or STDIO_NAME for stdin.
+ *             output_dir - the directory the files are written under, by
+ *             the names stored in the archive.
+ * returns:    The number of files unzapped.
+ * effects:    Reads the archive front to back, holding only the files
+ *             being coded. Throws a runtime_error if the archive is
+ *             truncated or malformed, or a name in it is not a relative
+ *             path.
+ */
+uint64_t BatchCoder::unzapArchive(const std::string& archive_file,
+                                  const std::string& output_dir) {
+    FileReader archive(archive_file);
+    std::string magic(ARCHIVE_MAGIC.size(), '\0');
+    magic.resize(archive.read(&magic[0], magic.size()));
+    if (magic != ARCHIVE_MAGIC) {
+        throw std::runtime_error("Zapped archive is malformed.");
+    }
+    uint64_t count = run([&](BatchJob& job) {
+        uint64_t name_size = readArchiveVarint(archive);
+        if (name_size == 0) {
+            return false;
+        }
+        if (name_size > MAX_BATCH_NAME_SIZE) {
+            throw std::runtime_error("Zapped archive is malformed.");
+        }
+        job.name.resize(name_size);
+        if (archive.read(&job.name[0], name_size) != name_size) {
+            throw std::runtime_error("Zapped archive is truncated.");
+        }
+        checkName(job.name);
+        // the size is only trusted as far as the bytes actually arrive
+        uint64_t size = readArchiveVarint(archive);
+        job.zapped.clear();
+        while (job.zapped.size() < size) {
+            size_t start = job.zapped.size();
+            size_t part = std::min<uint64_t>(size - start,
+                                             FileWriter::CHUNK_SIZE);
+            job.zapped.resize(start + part);
+            if (archive.read(reinterpret_cast<char *>(&job.zapped[start]),
+                             part) != part) {
+                throw std::runtime_error("Zapped archive is truncated.");
+            }
+        }
+        job.input.clear();
+        job.output = joinPath(output_dir, job.name);
+        return true;
+    }, false, nullptr);
+    stats.input_bytes = archive.bytesRead();
+    return count;
+}
+
+/**
+ * name:       statistics
+ * purpose:    Reports where the last batch spent its time.
+ * arguments:  none
+ * returns:    The stage times and counters of every file of the last
+ *             call added together; total_seconds is the batch's wall
+ *             time.
+ * effects:    None.
+ */
+const CoderStats& BatchCoder::statistics() const {
+    return stats;
+}
+
+/**
+ * name:       run
+ * purpose:    Codes files until there are no more.
+ * arguments:  next - fills in the next job's input and output, or returns
+ *             false when there is none.
+ *             zapping - true to zap, false to unzap.
+ *             archive - where finished files are stored, for zapArchive;
+ *             nullptr when each job writes its own output.
+ * returns:    The number of files coded.
+ * effects:    Resets stats and adds every file's to it. Rethrows anything
+ *             ++next++ or a job threw, once no job is still running.
+ */
+uint64_t BatchCoder::run(const std::function<bool(BatchJob&)>& next,
+                         bool zapping, FileWriter* archive) {
+    stats = CoderStats();
+    double seconds = 0;
+    StageTimer total(seconds);
+    size_t max_pending = std::max<size_t>(1, 2 * pool.size());
+    uint64_t count = 0;
+    try {
+        while (true) {
+            if (pending_jobs.size() == max_pending) {
+                finishJob(archive);
+                count++;
+            }
+            std::unique_ptr<BatchJob> job = takeJob();
+            BatchJob* task = job.get();
+            pending_jobs.push_back(std::move(job));
+            if (not next(*task)) {
+                spare_jobs.push_back(std::move(pending_jobs.back()));
+                pending_jobs.pop_back();
+                break;
+            }
+            task->done = pool.submit([this, task, zapping]() {
+                codeJob(*task, zapping);
+            });
+        }
+        while (not pending_jobs.empty()) {
+            finishJob(archive);
+            count++;
+        }
+    } catch (...) {
+        abandonJobs();
+        throw;
+    }
+    total.stop();
+    stats.total_seconds = seconds;
+    stats.threads = std::max(stats.threads, static_cast<int>(pool.size()));
+    return count;
+}
+
+/**
+ * name:       codeJob
+ * purpose:    Zaps or unzaps one file, on a worker thread.
+ * arguments:  job - the file; its input and output are filled in.
+ *             zapping - true to zap, false to unzap.
+ * returns:    void
+ * effects:    Zapping fills the job's zapped bytes; unzapping fills its
+ *             text. Writes the result unless it goes in an archive. Sets
+ *             the job's stats.
+ */
+void BatchCoder::codeJob(BatchJob& job, bool zapping) {
+    job.stats = CoderStats();
+    std::unique_ptr<HuffmanCoder> coder = takeCoder();
+    try {
+        std::unique_ptr<MappedFile> input;
+        if (not job.input.empty()) {
+            StageTimer read(job.stats, READ_STAGE);
+            input.reset(new MappedFile(job.input));
+        }
+        if (zapping) {
+            coder->compress(input->data(), input->size(), job.zapped);
+            job.stats.add(coder->statistics());
+            if (not job.output.empty()) {
+                writeFile(job.output, job.zapped, job.stats);
+            }
+        } else {
+            if (input) {
+                coder->decompress(input->data(), input->size(), job.text);
+            } else {
+                coder->decompress(job.zapped.data(), job.zapped.size(),
+                                  job.text);
+            }
+            job.stats.add(coder->statistics());
+            writeFile(job.output, job.text, job.stats);
+        }
+    } catch (...) {
+        returnCoder(std::move(coder));
+        throw;
+    }
+    returnCoder(std::move(coder));
+}
+
+/**
+ * name:       finishJob
+ * purpose:    Waits for the oldest job and stores its result.
+ * arguments:  archive - the archive the result goes in, or nullptr if the
+ *             job wrote its own.
+ * returns:    void
+ * effects:    Moves the oldest job from pending_jobs to spare_jobs and
+ *             adds its stats. Rethrows anything it threw.
+ */
+void BatchCoder::finishJob(FileWriter* archive) {
+    std::unique_ptr<BatchJob> job = std::move(pending_jobs.front());
+    pending_jobs.pop_front();
+    spare_jobs.push_back(std::move(job));
+    BatchJob& finished = *spare_jobs.back();
+    finished.done.get();
+    stats.add(finished.stats);
+    if (archive) {
+        StageTimer write(stats, WRITE_STAGE);
+        std::string header;
+        putVarint(header, finished.name.size());
+        header += finished.name;
+        putVarint(header, finished.zapped.size());
+        archive->write(header);
+        archive->write(reinterpret_cast<const char *>(finished.zapped.data()),
+                       finished.zapped.size());
+    }
+}
+
+/**
+ * name:       abandonJobs
+ * purpose:    Gives up on the jobs of a batch that failed part way.
+ * arguments:  none
+ * returns:    void
+ * effects:    Waits for every pending job, since the workers hold pointers
+ *             to them, then keeps them in spare_jobs.
+ */
+void BatchCoder::abandonJobs() {
+    for (std::unique_ptr<BatchJob>& job : pending_jobs) {
+        if (job->done.valid()) {
+            job->done.wait();
+        }
+        spare_jobs.push_back(std::move(job));
+    }
+    pending_jobs.clear();
+}
+
+/**
+ * name:       takeJob
+ * purpose:    Gets a job whose buffers can be filled.
+ * arguments:  none
+ * returns:    A job from spare_jobs, or a new one if there is none.
+ * effects:    Modifies spare_jobs.
+ */
+std::unique_ptr<BatchCoder::BatchJob> BatchCoder::takeJob() {
+    if (spare_jobs.empty()) {
+        return std::unique_ptr<BatchJob>(new BatchJob());
+    }
+    std::unique_ptr<BatchJob> job = std::move(spare_jobs.back());
+    spare_jobs.pop_back();
+    return job;
+}
+
+/**
+ * name:       takeCoder
+ * purpose:    Gets a coder for a worker to use.
+ * arguments:  none
+ * returns:    An idle coder, or a new one if every coder is in use; there
+ *             are never more coders than workers.
+ * effects:    Modifies idle_coders under coders_lock.
+ */
+std::unique_ptr<HuffmanCoder> BatchCoder::takeCoder() {
+    std::lock_guard<std::mutex> guard(coders_lock);
+    if (idle_coders.empty()) {
+        return std::unique_ptr<HuffmanCoder>(new HuffmanCoder(options));
+    }
+    std::unique_ptr<HuffmanCoder> coder = std::move(idle_coders.back());
+    idle_coders.pop_back();
+    return coder;
+}
+
+/**
+ * name:       returnCoder
+ * purpose:    Hands a coder back once a worker is done with it.
+ * arguments:  coder - the coder, with its buffers.
+ * returns:    void
+ * effects:    Modifies idle_coders under coders_lock.
+ */
+void BatchCoder::returnCoder(std::unique_ptr<HuffmanCoder> coder) {
+    std::lock_guard<std::mutex> guard(coders_lock);
+    idle_coders.push_back(std::move(coder));
+}
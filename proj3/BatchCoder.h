@@ -0,0 +1,115 @@
+/**
+ * File: BatchCoder.h
+ * Description: Defines BatchCoder, which zaps or unzaps many files in one
+ * process, for jobs where starting zap once per file would cost more than
+ * the coding. Files are coded side by side on a thread pool, and each
+ * worker keeps its HuffmanCoder, with its block buffers, from file to
+ * file. Each file becomes a "ZBLK" stream (or a "ZMSG" message with a
+ * dictionary), written either to its own file under an output directory
+ * or into one "ZARC" archive:
+ *
+ *     "ZARC", then per file: varint name size, name, varint zapped size,
+ *     the zapped bytes; then a varint 0.
+ *
+ * Names are relative paths, checked so that unzapping can never write
+ * outside its output directory.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#ifndef BATCHCODER_H
+#define BATCHCODER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "HuffmanCoder.h"
+#include "CoderStats.h"
+#include "FileIO.h"
+#include "ThreadPool.h"
+
+/* One file of a batch: where to read it and the relative name its result
+ * is stored under. */
+struct BatchFile {
+    std::string input;
+    std::string name;
+};
+
+// the suffix zapping adds to each name, and unzapping takes off
+extern const std::string ZAPPED_SUFFIX;
+// longest name an archive may hold
+static const size_t MAX_BATCH_NAME_SIZE = 4096;
+
+std::vector<BatchFile> listBatchFiles(const std::string& source);
+
+bool isBatchArchive(const std::string& source);
+
+class BatchCoder {
+public:
+    explicit BatchCoder(const CoderOptions& options);
+
+    uint64_t zap(const std::vector<BatchFile>& files,
+                 const std::string& output_dir);
+    uint64_t zapArchive(const std::vector<BatchFile>& files,
+                        const std::string& archive_file);
+    uint64_t unzap(const std::vector<BatchFile>& files,
+                   const std::string& output_dir);
+    uint64_t unzapArchive(const std::string& archive_file,
+                          const std::string& output_dir);
+
+    const CoderStats& statistics() const;
+
+private:
+    BatchCoder(const BatchCoder &) = delete;
+    BatchCoder &operator=(const BatchCoder &) = delete;
+
+    /* One file being coded, and the buffers kept for the next. */
+    struct BatchJob {
+        // the file to read; empty when the zapped bytes come from an
+        // archive
+        std::string input;
+        // the name stored in an archive
+        std::string name;
+        // the file to write; empty when the result goes in an archive
+        std::string output;
+        std::vector<unsigned char> zapped;
+        std::vector<unsigned char> text;
+        CoderStats stats;
+        std::future<void> done;
+    };
+
+    uint64_t run(const std::function<bool(BatchJob&)>& next, bool zapping,
+                 FileWriter* archive);
+
+    void codeJob(BatchJob& job, bool zapping);
+
+    void finishJob(FileWriter* archive);
+
+    void abandonJobs();
+
+    std::unique_ptr<BatchJob> takeJob();
+
+    std::unique_ptr<HuffmanCoder> takeCoder();
+
+    void returnCoder(std::unique_ptr<HuffmanCoder> coder);
+
+    // the options every file is coded with; jobs is 1, since the files
+    // rather than their blocks are coded side by side
+    CoderOptions options;
+    CoderStats stats;
+    // files being coded, oldest first, and jobs whose buffers are kept
+    std::deque<std::unique_ptr<BatchJob>> pending_jobs;
+    std::vector<std::unique_ptr<BatchJob>> spare_jobs;
+    // coders not in use by a worker, shared by the workers
+    std::vector<std::unique_ptr<HuffmanCoder>> idle_coders;
+    std::mutex coders_lock;
+    ThreadPool pool;
+};
+
+#endif
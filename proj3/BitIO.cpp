@@ -0,0 +1,299 @@
+/**
+ * File: BitIO.cpp
+ * Description: Implements the BitWriter and BitReader classes. Codes are
+ * shifted into a 64-bit accumulator and only whole bytes ever reach the
+ * output buffer, so encoding costs one byte of memory per eight output bits
+ * instead of one byte per bit.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#include "BitIO.h"
+#include <algorithm>
+#include <stdexcept>
+
+/**
+ * name:       BitWriter
+ * purpose:    Constructs an empty BitWriter.
+ * arguments:  none
+ * returns:    n/a
+ * effects:    Initializes the accumulator and the output buffer.
+ */
+BitWriter::BitWriter() : accumulator(0), pending_bits(0), total_bits(0) {}
+
+/**
+ * name:       write
+ * purpose:    Appends the low ++length++ bits of ++bits++ to the output,
+ *             most significant bit first.
+ * arguments:  bits - the code to append, right-aligned.
+ *             length - the number of bits to append, from 0 to 64.
+ * returns:    void
+ * effects:    May move whole bytes from the accumulator to the buffer.
+ */
+void BitWriter::write(uint64_t bits, int length) {
+    if (length > 56) { // split so the accumulator never overflows
+        write(bits >> 32, length - 32);
+        write(bits & 0xffffffffULL, 32);
+        return;
+    }
+    if (pending_bits + length > 64) {
+        drainWholeBytes(); // leaves at most 7 pending bits
+    }
+    uint64_t mask = (length == 0) ? 0 : (~0ULL >> (64 - length));
+    accumulator = (accumulator << length) | (bits & mask);
+    pending_bits += length;
+    total_bits += length;
+}
+
+/**
+ * name:       writeCodes
+ * purpose:    Appends the code word of every byte of a text.
+ * arguments:  symbols - the bytes to code.
+ *             size - the number of bytes at ++symbols++.
+ *             codes - the code word of each byte; every byte of the text
+ *             must have one.
+ * returns:    void
+ * effects:    Writes the same bits as calling write() once per byte. When
+ *             no code is longer than 28 bits, the codes are packed with
+ *             their lengths into one word each and written by writeGroups;
+ *             the bytes it leaves over go through write().
+ */
+void BitWriter::writeCodes(const unsigned char* symbols, size_t size,
+                           const CodeTable& codes) {
+    int max_length = 0;
+    for (const HuffmanCode& code : codes) {
+        max_length = std::max(max_length, code.length);
+    }
+    size_t done = 0;
+    if (max_length <= 28) {
+        // the code left-aligned, with its length in the low 6 bits
+        uint64_t packed[256];
+        for (int symbol = 0; symbol < 256; symbol++) {
+            const HuffmanCode& code = codes[symbol];
+            packed[symbol] = (code.length == 0) ? 0
+                    : (code.bits << (64 - code.length)) | code.length;
+        }
+        // as many codes as fit with 7 pending bits in 63 bits, so no
+        // shift reaches 64
+        if (max_length <= 11) {
+            done = writeGroups<5>(symbols, size, packed, max_length);
+        } else if (max_length <= 14) {
+            done = writeGroups<4>(symbols, size, packed, max_length);
+        } else if (max_length <= 18) {
+            done = writeGroups<3>(symbols, size, packed, max_length);
+        } else {
+            done = writeGroups<2>(symbols, size, packed, max_length);
+        }
+    }
+    for (size_t i = done; i < size; i++) {
+        write(codes[symbols[i]].bits, codes[symbols[i]].length);
+    }
+}
+
+/**
+ * name:       writeGroups
+ * purpose:    The inner loop of writeCodes: ORs GROUP codes at a time into
+ *             a left-aligned accumulator, then stores it with one
+ *             unaligned 8-byte store and keeps only its whole bytes.
+ * arguments:  symbols - the bytes to code.
+ *             size - the number of bytes at ++symbols++.
+ *             packed - each byte's code from writeCodes.
+ *             max_length - the longest code; 7 + GROUP * ++max_length++
+ *             must be at most 63.
+ * returns:    The number of bytes coded, ++size++ rounded down to a
+ *             multiple of GROUP.
+ * effects:    Appends to the buffer, a slice of WRITE_SLICE bytes at a
+ *             time so it never grows far past what is written. The loop
+ *             has no branch that depends on the data.
+ */
+template <int GROUP>
+size_t BitWriter::writeGroups(const unsigned char* symbols, size_t size,
+                              const uint64_t* packed, int max_length) {
+    static const size_t WRITE_SLICE = 1 << 16;
+    drainWholeBytes();
+    uint64_t start_bits = pending_bits;
+    uint64_t acc = pending_bits ? accumulator << (64 - pending_bits) : 0;
+    uint64_t count = pending_bits;
+    size_t done = 0;
+    size_t written = 0;
+    while (size - done >= GROUP) {
+        size_t groups = std::min(size - done, WRITE_SLICE) / GROUP;
+        size_t start = buffer.size();
+        // the last store writes 8 bytes past its whole ones
+        buffer.resize(start + (groups * GROUP * max_length) / 8 + 16);
+        char* out = &buffer[start];
+        const unsigned char* in = symbols + done;
+        for (size_t g = 0; g < groups; g++, in += GROUP) {
+            for (int k = 0; k < GROUP; k++) {
+                uint64_t code = packed[in[k]];
+                acc |= (code & ~uint64_t(63)) >> count;
+                count += code & 63;
+            }
+            uint64_t word = acc;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            word = __builtin_bswap64(word);
+#endif
+            std::memcpy(out, &word, 8);
+            out += count >> 3;
+            acc <<= count & ~uint64_t(7);
+            count &= 7;
+        }
+        size_t bytes = out - &buffer[start];
+        buffer.resize(start + bytes);
+        written += bytes;
+        done += groups * GROUP;
+    }
+    accumulator = count ? acc >> (64 - count) : 0;
+    pending_bits = static_cast<int>(count);
+    total_bits += written * 8 + count - start_bits;
+    return done;
+}
+
+/**
+ * name:       writeZeros
+ * purpose:    Appends ++count++ zero bits to the output.
+ * arguments:  count - the number of zero bits to append.
+ * returns:    void
+ * effects:    Once the output is byte aligned, zero bytes are appended to
+ *             the buffer directly rather than passing through the
+ *             accumulator.
+ */
+void BitWriter::writeZeros(uint64_t count) {
+    drainWholeBytes();
+    int pad = (8 - pending_bits) % 8;
+    if (count < static_cast<uint64_t>(pad)) {
+        write(0, static_cast<int>(count));
+        return;
+    }
+    write(0, pad);
+    count -= pad;
+    drainWholeBytes(); // now byte aligned with nothing pending
+    buffer.append(count / 8, '\0');
+    total_bits += (count / 8) * 8;
+    write(0, static_cast<int>(count % 8));
+}
+
+/**
+ * name:       flush
+ * purpose:    Moves every pending bit to the output buffer, padding the
+ *             last byte with zero bits.
+ * arguments:  none
+ * returns:    void
+ * effects:    Must be called before bytes() is used. bitCount() is not
+ *             changed by the padding.
+ */
+void BitWriter::flush() {
+    drainWholeBytes();
+    if (pending_bits > 0) {
+        buffer.push_back(static_cast<char>(accumulator << (8 - pending_bits)));
+        pending_bits = 0;
+    }
+}
+
+/**
+ * name:       bytes
+ * purpose:    Gives access to the packed output.
+ * arguments:  none
+ * returns:    The packed bytes written so far (complete after flush()).
+ * effects:    None.
+ */
+const std::string& BitWriter::bytes() const {
+    return buffer;
+}
+
+/**
+ * name:       bitCount
+ * purpose:    Reports how many bits have been written, excluding padding.
+ * arguments:  none
+ * returns:    The number of bits written.
+ * effects:    None.
+ */
+uint64_t BitWriter::bitCount() const {
+    return total_bits;
+}
+
+/**
+ * name:       clear
+ * purpose:    Resets the writer so it can be reused.
+ * arguments:  none
+ * returns:    void
+ * effects:    Empties the buffer but keeps its capacity.
+ */
+void BitWriter::clear() {
+    buffer.clear();
+    accumulator = 0;
+    pending_bits = 0;
+    total_bits = 0;
+}
+
+/**
+ * name:       discardBytes
+ * purpose:    Drops the packed bytes once the caller has written them out,
+ *             so a long encoding can be streamed in pieces.
+ * arguments:  none
+ * returns:    void
+ * effects:    Empties the buffer but keeps its capacity, the pending bits
+ *             and bitCount().
+ */
+void BitWriter::discardBytes() {
+    buffer.clear();
+}
+
+/**
+ * name:       drainWholeBytes
+ * purpose:    Moves every complete byte from the accumulator to the buffer.
+ * arguments:  none
+ * returns:    void
+ * effects:    Leaves fewer than 8 bits pending.
+ */
+void BitWriter::drainWholeBytes() {
+    while (pending_bits >= 8) {
+        pending_bits -= 8;
+        buffer.push_back(static_cast<char>(accumulator >> pending_bits));
+    }
+}
+
+/**
+ * name:       BitReader
+ * purpose:    Constructs a BitReader over packed bytes.
+ * arguments:  data - pointer to the packed bytes. Must outlive the reader.
+ *             size - the number of bytes available at ++data++.
+ *             num_bits - the number of meaningful bits; anything after
+ *             them is padding.
+ * returns:    n/a
+ * effects:    Throws a runtime_error if ++num_bits++ needs more than
+ *             ++size++ bytes.
+ */
+BitReader::BitReader(const unsigned char* data_in, size_t size_in,
+                     uint64_t num_bits)
+    : data(data_in), size(size_in), byte_pos(0), bit_buffer(0),
+      buffered_bits(0), bits_left(num_bits) {
+    if ((num_bits + 7) / 8 > size) {
+        throw std::runtime_error("Encoded bit count exceeds the data size.");
+    }
+}
+
+/**
+ * name:       readBit
+ * purpose:    Reads and consumes a single bit.
+ * arguments:  none
+ * returns:    0 or 1.
+ * effects:    Throws a runtime_error if no bits remain.
+ */
+int BitReader::readBit() {
+    int bit = static_cast<int>(peek(1));
+    consume(1);
+    return bit;
+}
+
+/**
+ * name:       bitsRemaining
+ * purpose:    Reports how many meaningful bits have not been consumed.
+ * arguments:  none
+ * returns:    The number of bits left.
+ * effects:    None.
+ */
+uint64_t BitReader::bitsRemaining() const {
+    return bits_left;
+}
+
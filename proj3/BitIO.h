@@ -0,0 +1,212 @@
+/**
+ * File: BitIO.h
+ * Description: Defines the BitWriter and BitReader classes, which pack and
+ * unpack variable-length Huffman codes through a 64-bit accumulator. Bits
+ * are stored most significant bit first, the same order BinaryIO uses, so
+ * the packed bytes can be written to (and read from) a zapped file as is.
+ * A whole text can also be coded in one call, which ORs several codes into
+ * the accumulator at a time and stores it as one word.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#ifndef BITIO_H
+#define BITIO_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include "HuffmanCode.h"
+
+// GCC declines to inline the per-symbol decode path into loops that call
+// it more than once, which costs more than interleaving saves.
+#if defined(__GNUC__)
+#define ZAP_ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define ZAP_ALWAYS_INLINE inline
+#endif
+
+class BitWriter {
+public:
+    BitWriter();
+
+    void write(uint64_t bits, int length);
+    void writeCodes(const unsigned char* symbols, size_t size,
+                    const CodeTable& codes);
+    void writeZeros(uint64_t count);
+    void flush();
+
+    const std::string& bytes() const;
+    uint64_t bitCount() const;
+    void clear();
+    void discardBytes();
+
+private:
+    void drainWholeBytes();
+    template <int GROUP>
+    size_t writeGroups(const unsigned char* symbols, size_t size,
+                       const uint64_t* packed, int max_length);
+
+    // packed output, always a whole number of bytes
+    std::string buffer;
+    // pending bits, right-aligned; only the low pending_bits are valid
+    uint64_t accumulator;
+    int pending_bits;
+    uint64_t total_bits;
+};
+
+class BitReader {
+public:
+    BitReader(const unsigned char* data, size_t size, uint64_t num_bits);
+
+    uint64_t peek(int length);
+    void consume(int length);
+    int readBit();
+
+    uint64_t bitsRemaining() const;
+
+    // unchecked versions for decoding loops that check once per refill
+    bool canTakeFast(uint64_t length) const;
+    void refillFast();
+    uint64_t peekFast(int length) const;
+    void consumeFast(int length);
+
+private:
+    void refill();
+
+    const unsigned char* data;
+    size_t size;
+    size_t byte_pos;
+    // upcoming bits, left-aligned; only the high buffered_bits are valid
+    uint64_t bit_buffer;
+    int buffered_bits;
+    uint64_t bits_left;
+};
+
+// The reader's per-symbol methods are defined here so decoding loops in
+// other files can inline them.
+
+/**
+ * name:       peek
+ * purpose:    Returns the next ++length++ bits without consuming them.
+ * arguments:  length - the number of bits wanted, from 1 to 57.
+ * returns:    The bits, right-aligned. Bits past the end of the data read
+ *             as zero.
+ * effects:    May refill the bit buffer.
+ */
+ZAP_ALWAYS_INLINE uint64_t BitReader::peek(int length) {
+    if (buffered_bits < length) {
+        refill();
+    }
+    return bit_buffer >> (64 - length);
+}
+
+/**
+ * name:       consume
+ * purpose:    Skips past ++length++ bits.
+ * arguments:  length - the number of bits to skip, from 0 to 57.
+ * returns:    void
+ * effects:    Throws a runtime_error if fewer than ++length++ meaningful
+ *             bits remain.
+ */
+ZAP_ALWAYS_INLINE void BitReader::consume(int length) {
+    if (static_cast<uint64_t>(length) > bits_left) {
+        throw std::runtime_error("Encoding did not match Huffman tree.");
+    }
+    if (buffered_bits < length) {
+        refill();
+    }
+    bit_buffer <<= length;
+    buffered_bits -= length;
+    bits_left -= length;
+}
+
+/**
+ * name:       canTakeFast
+ * purpose:    Tells a decoding loop whether it may take ++length++ bits
+ *             through refillFast(), peekFast() and consumeFast().
+ * arguments:  length - the most bits the loop will consume, at most 56.
+ * returns:    true if at least ++length++ meaningful bits remain and a
+ *             refill can load a whole word.
+ * effects:    None.
+ */
+ZAP_ALWAYS_INLINE bool BitReader::canTakeFast(uint64_t length) const {
+    return bits_left >= length and size - byte_pos >= 8;
+}
+
+/**
+ * name:       refillFast
+ * purpose:    Tops the bit buffer up to at least 56 bits with one load.
+ * arguments:  none
+ * returns:    void
+ * effects:    Must only follow a canTakeFast() that returned true.
+ */
+ZAP_ALWAYS_INLINE void BitReader::refillFast() {
+    uint64_t word;
+    std::memcpy(&word, data + byte_pos, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    word = __builtin_bswap64(word);
+#endif
+    bit_buffer |= word >> buffered_bits; // see refill
+    byte_pos += (63 - buffered_bits) >> 3;
+    buffered_bits |= 56;
+}
+
+/**
+ * name:       peekFast
+ * purpose:    Returns the next ++length++ bits, which must be buffered.
+ * arguments:  length - the number of bits wanted, from 1 to 56.
+ * returns:    The bits, right-aligned.
+ * effects:    None.
+ */
+ZAP_ALWAYS_INLINE uint64_t BitReader::peekFast(int length) const {
+    return bit_buffer >> (64 - length);
+}
+
+/**
+ * name:       consumeFast
+ * purpose:    Skips past ++length++ bits, which must be buffered and
+ *             meaningful.
+ * arguments:  length - the number of bits to skip, from 0 to 56.
+ * returns:    void
+ * effects:    None beyond the reader; nothing is checked.
+ */
+ZAP_ALWAYS_INLINE void BitReader::consumeFast(int length) {
+    bit_buffer <<= length;
+    buffered_bits -= length;
+    bits_left -= length;
+}
+
+/**
+ * name:       refill
+ * purpose:    Tops the bit buffer up with whole bytes.
+ * arguments:  none
+ * returns:    void
+ * effects:    Leaves at least 57 buffered bits unless the data runs out, in
+ *             which case the missing bits read as zero.
+ */
+ZAP_ALWAYS_INLINE void BitReader::refill() {
+    if (size - byte_pos >= 8) {
+        // one 8-byte load; the bits below the buffered ones may already
+        // hold the start of the next byte, and OR-ing in the same bits 
+        // again on the next refill leaves them unchanged
+        uint64_t word;
+        std::memcpy(&word, data + byte_pos, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        word = __builtin_bswap64(word);
+#endif
+        bit_buffer |= word >> buffered_bits;
+        byte_pos += (63 - buffered_bits) >> 3;
+        buffered_bits |= 56;
+        return;
+    }
+    while (buffered_bits <= 56 and byte_pos < size) {
+        bit_buffer |= static_cast<uint64_t>(data[byte_pos++])
+                                                    << (56 - buffered_bits);
+        buffered_bits += 8;
+    }
+}
+
+#endif
@@ -0,0 +1,310 @@
+/**
+ * File: BlockFormat.cpp
+ * Description: Implements the "ZBLK" stream and block headers. The
+ * readers check every length against the stream's block size before
+ * anything is allocated, so a corrupt stream cannot make unzap reserve
+ * more than a block's worth of memory.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#include "BlockFormat.h"
+#include "ZapFormat.h"
+#include <stdexcept>
+
+/**
+ * name:       readVarint
+ * purpose:    Reads a varint (see ZapFormat.h) from a stream.
+ * arguments:  in - the stream to read from.
+ * returns:    The integer read.
+ * effects:    Throws a runtime_error if the varint is truncated or longer
+ *             than 64 bits.
+ */
+uint64_t readVarint(FileReader &in) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        unsigned char byte;
+        if (not in.readByte(byte)) {
+            throw std::runtime_error("Zapped block stream is truncated.");
+        }
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+    throw std::runtime_error("Zapped block stream is malformed.");
+}
+
+/**
+ * name:       writeStreamHeader
+ * purpose:    Starts a block stream.
+ * arguments:  out - the file to write to.
+ *             block_size - the most text any block will hold.
+ *             transforms - the pipeline every block goes through; empty
+ *             for a plain "ZBLK" stream.
+ * returns:    void
+ * effects:    Writes the magic, the pipeline if there is one, and the 
+ *             block size to ++out++.
+ */
+void writeStreamHeader(FileWriter &out, uint64_t block_size,
+                       const TransformPipeline &transforms) {
+    std::string header = BLOCK_MAGIC;
+    if (not transforms.empty()) {
+        header = TRANSFORM_MAGIC;
+        header += static_cast<char>(transforms.size());
+        for (TransformType stage : transforms) {
+            header += static_cast<char>(stage);
+        }
+    }
+    putVarint(header, block_size);
+    out.write(header);
+}
+
+/**
+ * name:       readStreamHeader
+ * purpose:    Reads the rest of a stream header after its magic.
+ * arguments:  in - the stream, positioned just past BLOCK_MAGIC.
+ * returns:    The stream's block size.
+ * effects:    Throws a runtime_error if the block size is 0 or larger than
+ *             MAX_BLOCK_SIZE.
+ */
+uint64_t readStreamHeader(FileReader &in) {
+    uint64_t block_size = readVarint(in);
+    if (block_size == 0 or block_size > MAX_BLOCK_SIZE) {
+        throw std::runtime_error("Zapped block stream is malformed.");
+    }
+    return block_size;
+}
+
+/**
+ * name:       readStreamTransforms
+ * purpose:    Reads the pipeline of a "ZBLT" stream after its magic.
+ * arguments:  in - the stream, positioned just past TRANSFORM_MAGIC.
+ * returns:    The stages, in the order they were applied.
+ * effects:    Throws a runtime_error if there are more than 
+ *             MAX_TRANSFORMS stages or one is unknown.
+ */
+TransformPipeline readStreamTransforms(FileReader &in) {
+    unsigned char count;
+    if (not in.readByte(count)) {
+        throw std::runtime_error("Zapped block stream is truncated.");
+    }
+    if (count > MAX_TRANSFORMS) {
+        throw std::runtime_error("Zapped block stream is malformed.");
+    }
+    TransformPipeline transforms;
+    for (int k = 0; k < count; k++) {
+        unsigned char stage;
+        if (not in.readByte(stage)) {
+            throw std::runtime_error("Zapped block stream is truncated.");
+        }
+        if (stage < RLE_TRANSFORM or stage > MTF_TRANSFORM) {
+            throw std::runtime_error("Zapped block stream is malformed.");
+        }
+        transforms.push_back(static_cast<TransformType>(stage));
+    }
+    return transforms;
+}
+
+/**
+ * name:       writeBlockHeader
+ * purpose:    Writes the header that goes in front of a block's payload.
+ * arguments:  out - the file to write to.
+ *             header - the block's type and lengths.
+ * returns:    void
+ * effects:    Writes the type byte, plus the lengths and any checksum
+ *             unless the block is END_BLOCK, to ++out++.
+ */
+void writeBlockHeader(FileWriter &out, const BlockHeader &header) {
+    bool checked = header.checked and header.type != END_BLOCK;
+    std::string bytes(1, static_cast<char>(header.type | 
+                                           (checked ? CHECKSUM_FLAG : 0)));
+    if (header.type != END_BLOCK) {
+        putVarint(bytes, header.text_size);
+        putVarint(bytes, header.payload_size);
+    }
+    if (checked) {
+        for (int k = 0; k < 4; k++) {
+            bytes += static_cast<char>(header.checksum >> (8 * k));
+        }
+    }
+    out.write(bytes);
+}
+
+/**
+ * name:       readBlockHeader
+ * purpose:    Reads the header of the next block.
+ * arguments:  in - the stream, positioned at a block header.
+ *             block_size - the stream's block size.
+ * returns:    The block's type, lengths and checksum. An END_BLOCK has
+ *             both lengths 0.
+ * effects:    Throws a runtime_error if the stream ends before the end
+ *             block, the type is unknown, or a length cannot be right for
+ *             the block size.
+ */
+BlockHeader readBlockHeader(FileReader &in, uint64_t block_size) {
+    unsigned char type;
+    if (not in.readByte(type)) {
+        throw std::runtime_error("Zapped block stream is truncated.");
+    }
+    BlockHeader header = {END_BLOCK, 0, 0, false, 0};
+    if (type == END_BLOCK) {
+        return header;
+    }
+    header.checked = (type & CHECKSUM_FLAG) != 0;
+    type &= ~CHECKSUM_FLAG;
+    if (type == END_BLOCK or type > CONTEXT_BLOCK) {
+        throw std::runtime_error("Zapped block stream is malformed.");
+    }
+    header.type = static_cast<BlockType>(type);
+    header.text_size = readVarint(in);
+    header.payload_size = readVarint(in);
+    if (header.text_size == 0 or header.text_size > block_size or
+        header.payload_size > maxPayloadSize(header.text_size)) {
+        throw std::runtime_error("Zapped block stream is malformed.");
+    }
+    if (header.checked) {
+        unsigned char bytes[4];
+        if (in.read(reinterpret_cast<char *>(bytes), 4) != 4) {
+            throw std::runtime_error("Zapped block stream is truncated.");
+        }
+        for (int k = 0; k < 4; k++) {
+            header.checksum |= static_cast<uint32_t>(bytes[k]) << (8 * k);
+        }
+    }
+    return header;
+}
+
+/**
+ * name:       maxPayloadSize
+ * purpose:    Bounds the payload of a block.
+ * arguments:  text_size - the number of bytes the block holds.
+ * returns:    The largest payload any valid block of that size can have:
+ *             a context map and a full code-length header for every 
+ *             cluster, or the interleaved stream sizes, and 63 bits per 
+ *             byte plus the padding of every stream.
+ * effects:    None.
+ */
+uint64_t maxPayloadSize(uint64_t text_size) {
+    return 1 + 128 + MAX_CONTEXT_CLUSTERS * (1 + 2 * 256) 
+                + (text_size * 63) / 8 + INTERLEAVED_STREAMS;
+}
+
+/**
+ * name:       writeBlockIndex
+ * purpose:    Writes the index that follows a stream's end block.
+ * arguments:  out - the file to write to, just past the end block.
+ *             index - one entry per block, in stream order.
+ * returns:    void
+ * effects:    Writes the index and its footer to ++out++.
+ */
+void writeBlockIndex(FileWriter &out, const BlockIndex &index) {
+    std::string bytes;
+    putVarint(bytes, index.size());
+    for (const BlockIndexEntry &entry : index) {
+        putVarint(bytes, entry.text_size);
+        putVarint(bytes, entry.coded_size);
+    }
+    uint64_t index_size = bytes.size();
+    for (int k = 0; k < 8; k++) {
+        bytes += static_cast<char>(index_size >> (8 * k));
+    }
+    bytes += INDEX_MAGIC;
+    out.write(bytes);
+}
+
+/**
+ * name:       skipBlockIndex
+ * purpose:    Reads past what follows a stream's end block.
+ * arguments:  in - the stream, just past the end block.
+ * returns:    void
+ * effects:    Reads ++in++ to its end. Throws a runtime_error if the bytes
+ *             there are not an index; streams written before the index 
+ *             may have none.
+ */
+void skipBlockIndex(FileReader &in) {
+    std::string rest;
+    in.readRest(rest);
+    if (rest.empty()) {
+        return; // written before streams had an index
+    }
+    uint64_t index_size = 0;
+    for (int k = 0; rest.size() >= INDEX_FOOTER_SIZE and k < 8; k++) {
+        index_size |= static_cast<uint64_t>(static_cast<unsigned char>(
+                    rest[rest.size() - INDEX_FOOTER_SIZE + k])) << (8 * k);
+    }
+    if (rest.size() < INDEX_FOOTER_SIZE or 
+            index_size != rest.size() - INDEX_FOOTER_SIZE or
+            rest.compare(rest.size() - INDEX_MAGIC.size(), 
+                         INDEX_MAGIC.size(), INDEX_MAGIC) != 0) {
+        throw std::runtime_error("Zapped block stream has trailing bytes.");
+    }
+}
+
+/**
+ * name:       readBlockIndex
+ * purpose:    Reads the index at the end of a stream held in memory.
+ * arguments:  stream - the whole stream, from its magic on.
+ *             size - the number of bytes at ++stream++.
+ *             first_block - the offset of the first block, just past the
+ *             stream header.
+ *             block_size - the stream's block size.
+ *             index - set to the entries read.
+ * returns:    true if the stream ends in an index; false if it has none.
+ * effects:    Throws a runtime_error if the index is malformed or does not
+ *             add up to the blocks between the header and the end block.
+ */
+bool readBlockIndex(const unsigned char *stream, size_t size,
+                    uint64_t first_block, uint64_t block_size,
+                    BlockIndex &index) {
+    index.clear();
+    if (size < first_block + 1 + INDEX_FOOTER_SIZE or
+            INDEX_MAGIC.compare(0, INDEX_MAGIC.size(), 
+                reinterpret_cast<const char *>(stream) + size - 
+                INDEX_MAGIC.size(), INDEX_MAGIC.size()) != 0) {
+        return false;
+    }
+    uint64_t index_size = 0;
+    for (int k = 0; k < 8; k++) {
+        index_size |= static_cast<uint64_t>(
+                    stream[size - INDEX_FOOTER_SIZE + k]) << (8 * k);
+    }
+    // the end block's type byte sits between the blocks and the index
+    if (index_size > size - INDEX_FOOTER_SIZE - first_block - 1) {
+        throw std::runtime_error("Zapped block index is malformed.");
+    }
+    uint64_t index_start = size - INDEX_FOOTER_SIZE - index_size;
+    std::string bytes(reinterpret_cast<const char *>(stream) + index_start,
+                      index_size);
+    size_t pos = 0;
+    uint64_t coded_total = 0;
+    try {
+        uint64_t count = getVarint(bytes, pos);
+        if (count > index_size / 2) { // every entry takes two bytes or more
+            throw std::runtime_error("Zapped block index is malformed.");
+        }
+        index.resize(count);
+        for (BlockIndexEntry &entry : index) {
+            entry.text_size = getVarint(bytes, pos);
+            entry.coded_size = getVarint(bytes, pos);
+            // a block header is at least a type byte and two lengths
+            if (entry.text_size == 0 or entry.text_size > block_size or
+                    entry.coded_size < 3 or entry.coded_size > size) {
+                throw std::runtime_error("Zapped block index is malformed.");
+            }
+            coded_total += entry.coded_size;
+            if (coded_total > size) { // checked as it goes, so no overflow
+                throw std::runtime_error("Zapped block index is malformed.");
+            }
+        }
+    } catch (const std::runtime_error &) {
+        index.clear();
+        throw std::runtime_error("Zapped block index is malformed.");
+    }
+    if (pos != index_size or first_block + coded_total + 1 != index_start or
+                                    stream[index_start - 1] != END_BLOCK) {
+        index.clear();
+        throw std::runtime_error("Zapped block index is malformed.");
+    }
+    return true;
+}
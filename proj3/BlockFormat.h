@@ -0,0 +1,107 @@
+/**
+ * File: BlockFormat.h
+ * Description: Declares the framing of the "ZBLK" block stream. A stream
+ * is the magic, the block size as a varint, then a sequence of blocks,
+ * each a type byte, its text length and payload length as varints, and
+ * the payload. A block of type END_BLOCK (with no lengths) closes the
+ * stream. Every block is coded on its own, so a reader only ever needs
+ * one block in memory and can start writing output as soon as the first
+ * block arrives. A "ZBLT" stream is the same with a transform pipeline
+ * (see BlockTransform.h) between the magic and the block size: a count
+ * byte, then a TransformType byte per stage. Its block headers give the
+ * transformed lengths.
+ *
+ * A block whose type byte has CHECKSUM_FLAG set has, after its lengths,
+ * the CRC-32C (see Checksum.h) of the text it decodes to, after any
+ * transforms are undone, as 4 bytes least significant first. A corrupt
+ * block is then refused as soon as it is decoded, not passed on.
+ *
+ * After the end block comes an index, so a reader can jump to the blocks
+ * holding a byte range: a varint block count, then for each block the
+ * length of its text before any transform and the bytes its header and
+ * payload take, both varints; then the index's own size as 8 bytes,
+ * least significant first, and INDEX_MAGIC. Readers that stop at the end
+ * block never see it.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#ifndef BLOCKFORMAT_H
+#define BLOCKFORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "FileIO.h"
+#include "BlockTransform.h"
+
+// block size used when reading stdin without --block-size
+static const uint64_t DEFAULT_BLOCK_SIZE = 1 << 20;
+// largest block size a stream may declare, which bounds decoder memory
+static const uint64_t MAX_BLOCK_SIZE = 1 << 30;
+
+enum BlockType {
+    END_BLOCK = 0,
+    // a canonical code-length header followed by the packed code bits
+    HUFFMAN_BLOCK = 1,
+    // a code-length header, the byte sizes of the first three of
+    // INTERLEAVED_STREAMS bit streams as varints, then the streams; byte
+    // i of the text is coded in stream i % INTERLEAVED_STREAMS
+    INTERLEAVED_BLOCK = 2,
+    // the text itself, for blocks a code would not make smaller
+    RAW_BLOCK = 3,
+    // one byte, repeated text_size times
+    RUN_BLOCK = 4,
+    // an order-1 context map (see ContextModel.h), the code-length header
+    // of each of its clusters, then the packed code bits
+    CONTEXT_BLOCK = 5
+};
+
+// set in a block's type byte when a checksum follows its lengths
+static const unsigned char CHECKSUM_FLAG = 0x80;
+
+// number of bit streams an INTERLEAVED_BLOCK is split into
+static const int INTERLEAVED_STREAMS = 4;
+// most code tables a CONTEXT_BLOCK may hold
+static const int MAX_CONTEXT_CLUSTERS = 16;
+
+struct BlockHeader {
+    BlockType type;
+    uint64_t text_size;
+    uint64_t payload_size;
+    // whether the block has a checksum, and the checksum
+    bool checked;
+    uint32_t checksum;
+};
+
+/* Where one block's text and coded bytes are, for the index. */
+struct BlockIndexEntry {
+    uint64_t text_size;
+    uint64_t coded_size;
+};
+
+typedef std::vector<BlockIndexEntry> BlockIndex;
+
+// the size and magic that close an indexed stream
+static const size_t INDEX_FOOTER_SIZE = 12;
+
+void writeStreamHeader(FileWriter &out, uint64_t block_size,
+                       const TransformPipeline &transforms);
+uint64_t readStreamHeader(FileReader &in);
+TransformPipeline readStreamTransforms(FileReader &in);
+
+void writeBlockHeader(FileWriter &out, const BlockHeader &header);
+BlockHeader readBlockHeader(FileReader &in, uint64_t block_size);
+
+uint64_t maxPayloadSize(uint64_t text_size);
+
+uint64_t readVarint(FileReader &in);
+
+void writeBlockIndex(FileWriter &out, const BlockIndex &index);
+void skipBlockIndex(FileReader &in);
+bool readBlockIndex(const unsigned char *stream, size_t size,
+                    uint64_t first_block, uint64_t block_size,
+                    BlockIndex &index);
+
+#endif
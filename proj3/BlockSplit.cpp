@@ -0,0 +1,88 @@
+/**
+ * File: BlockSplit.cpp
+ * Description: Implements the greedy block splitter. Histograms are added
+ * up as the scan moves along, so each segment costs one count and two
+ * code-length constructions however long the current piece has grown.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#include "BlockSplit.h"
+#include "Histogram.h"
+#include "LengthLimit.h"
+#include <algorithm>
+
+// bits a new block spends on its type byte and two varint lengths
+static const uint64_t BLOCK_HEADER_BITS = 8 * 8;
+
+/**
+ * name:       codedBlockBits
+ * purpose:    Estimates the size of a block from its histogram.
+ * arguments:  frequencies - the frequency of each byte in the block.
+ *             size - the number of bytes in the block, the sum of
+ *             ++frequencies++.
+ * returns:    The bits of the cheapest of the block types encodeBlock 
+ *             picks from: a run, the raw text, or the code-length header 
+ *             and the Huffman coded text. Block headers are not counted.
+ * effects:    None.
+ */
+uint64_t codedBlockBits(const FrequencyTable &frequencies, uint64_t size) {
+    int distinct = distinctBytes(frequencies);
+    if (distinct <= 1) {
+        return 8;
+    }
+    CodeLengths lengths = huffmanCodeLengths(frequencies);
+    uint64_t coded = 8 * (1 + 2 * distinct) + 
+                            encodedBitCount(frequencies, lengths);
+    return std::min(coded, 8 * size);
+}
+
+/**
+ * name:       splitBlock
+ * purpose:    Finds where a block should be cut into separately coded 
+ *             pieces.
+ * arguments:  text - the bytes of the block.
+ *             size - the number of bytes at ++text++.
+ *             pieces - replaced by the length of each piece, in order; 
+ *             they add up to ++size++.
+ * returns:    void
+ * effects:    Modifies ++pieces++. A segment starts a new piece when
+ *             coding it apart, header included, is cheaper than coding it
+ *             with the piece before it.
+ */
+void splitBlock(const unsigned char *text, size_t size, 
+                std::vector<size_t> &pieces) {
+    pieces.clear();
+    if (size < 2 * SPLIT_SEGMENT_SIZE) {
+        pieces.push_back(size);
+        return;
+    }
+    FrequencyTable piece = {};
+    size_t piece_size = std::min(size, SPLIT_SEGMENT_SIZE);
+    countBytes(text, piece_size, piece);
+    uint64_t piece_bits = codedBlockBits(piece, piece_size);
+    for (size_t start = piece_size; start < size; 
+                                            start += SPLIT_SEGMENT_SIZE) {
+        size_t segment_size = std::min(size - start, SPLIT_SEGMENT_SIZE);
+        FrequencyTable segment = {};
+        countBytes(text + start, segment_size, segment);
+        FrequencyTable joined = piece;
+        for (int symbol = 0; symbol < 256; symbol++) {
+            joined[symbol] += segment[symbol];
+        }
+        uint64_t segment_bits = codedBlockBits(segment, segment_size);
+        uint64_t joined_bits = codedBlockBits(joined, 
+                                              piece_size + segment_size);
+        if (piece_bits + segment_bits + BLOCK_HEADER_BITS < joined_bits) {
+            pieces.push_back(piece_size);
+            piece = segment;
+            piece_size = segment_size;
+            piece_bits = segment_bits;
+        } else {
+            piece = joined;
+            piece_size += segment_size;
+            piece_bits = joined_bits;
+        }
+    }
+    pieces.push_back(piece_size);
+}
@@ -0,0 +1,31 @@
+/**
+ * File: BlockSplit.h
+ * Description: Declares splitBlock, which cuts a block of text where its
+ * byte distribution changes. The text is counted in segments of
+ * SPLIT_SEGMENT_SIZE bytes, and each segment either joins the piece
+ * before it or starts a new one, whichever the histograms say codes
+ * smaller once the cost of another code-length header is paid. Inputs
+ * that mix text, binaries and logs then get a code for each part instead
+ * of one code for all of them.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#ifndef BLOCKSPLIT_H
+#define BLOCKSPLIT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "HuffmanCode.h"
+
+// granularity of the cut points; a block shorter than two segments is
+// never split
+static const size_t SPLIT_SEGMENT_SIZE = 16 << 10;
+
+uint64_t codedBlockBits(const FrequencyTable &frequencies, uint64_t size);
+
+void splitBlock(const unsigned char *text, size_t size, 
+                std::vector<size_t> &pieces);
+
+#endif
@@ -0,0 +1,401 @@
+/**
+ * File: BlockTransform.cpp
+ * Description: Implements the block transforms. The Burrows-Wheeler
+ * transform sorts the block's rotations by prefix doubling, with a
+ * counting sort per round, so it takes O(n log n) time whatever the text
+ * and stops early once every rotation is told apart. Every inverse checks
+ * its input, so a corrupt block cannot make it write past the block size.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#include "BlockTransform.h"
+#include <algorithm>
+#include <stdexcept>
+
+// the longest run RLE_TRANSFORM codes in one group: four bytes and a
+// count of up to 255 more
+static const size_t MAX_RUN = 4 + 255;
+
+/**
+ * name:       runLengthForward
+ * purpose:    Applies RLE_TRANSFORM.
+ * arguments:  in - the bytes to transform.
+ *             size - the number of bytes at ++in++.
+ *             out - the string the transformed bytes are appended to.
+ * returns:    void
+ * effects:    Modifies ++out++.
+ */
+static void runLengthForward(const unsigned char *in, size_t size,
+                             std::string &out) {
+    size_t i = 0;
+    while (i < size) {
+        unsigned char c = in[i];
+        size_t run = 1;
+        while (i + run < size and in[i + run] == c and run < MAX_RUN) {
+            run++;
+        }
+        if (run >= 4) {
+            out.append(4, static_cast<char>(c));
+            out += static_cast<char>(run - 4);
+        } else {
+            out.append(run, static_cast<char>(c));
+        }
+        i += run;
+    }
+}
+
+/**
+ * name:       runLengthInverse
+ * purpose:    Undoes RLE_TRANSFORM.
+ * arguments:  in - the transformed bytes.
+ *             size - the number of bytes at ++in++.
+ *             limit - the most bytes the original can have.
+ *             out - the string the original bytes are appended to.
+ * returns:    void
+ * effects:    Modifies ++out++. Throws a runtime_error if a count is
+ *             missing or the output would pass ++limit++.
+ */
+static void runLengthInverse(const unsigned char *in, size_t size,
+                             uint64_t limit, std::string &out) {
+    int last = -1;
+    int equal = 0;
+    for (size_t i = 0; i < size; i++) {
+        if (in[i] == last) {
+            equal++;
+        } else {
+            last = in[i];
+            equal = 1;
+        }
+        out += static_cast<char>(in[i]);
+        if (equal == 4) { // a count follows four equal bytes
+            if (++i == size or out.size() + in[i] > limit) {
+                throw std::runtime_error("Zapped block stream is malformed.");
+            }
+            out.append(in[i], static_cast<char>(last));
+            equal = 0;
+        }
+    }
+    if (out.size() > limit) {
+        throw std::runtime_error("Zapped block stream is malformed.");
+    }
+}
+
+/**
+ * name:       bwtForward
+ * purpose:    Applies BWT_TRANSFORM.
+ * arguments:  in - the bytes to transform.
+ *             size - the number of bytes at ++in++; below 2^32.
+ *             out - the string the transformed bytes are appended to.
+ * returns:    void
+ * effects:    Modifies ++out++. Uses 16 bytes of memory per input byte.
+ */
+static void bwtForward(const unsigned char *in, size_t size,
+                       std::string &out) {
+    uint32_t n = static_cast<uint32_t>(size);
+    // order[i] is the start of the i-th smallest rotation, and rank[j] the
+    // class of the rotation at j among rotations equal in the first h bytes
+    std::vector<uint32_t> order(n), rank(n), next_order(n), next_rank(n);
+    std::vector<uint32_t> count(std::max<uint32_t>(256, n) + 1, 0);
+    for (uint32_t j = 0; j < n; j++) {
+        count[in[j] + 1]++;
+    }
+    for (int c = 0; c < 256; c++) {
+        count[c + 1] += count[c];
+    }
+    for (uint32_t j = 0; j < n; j++) {
+        order[count[in[j]]++] = j;
+    }
+    uint32_t classes = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        if (i > 0 and in[order[i]] != in[order[i - 1]]) {
+            classes++;
+        }
+        rank[order[i]] = classes;
+    }
+    classes = (n > 0) ? classes + 1 : 0;
+    for (uint32_t h = 1; h < n and classes < n; h = (h > n / 2) ? n : 2 * h) {
+        // sorted by the second half already, so a stable counting sort by
+        // the first half sorts by both; indexes wrap without a division
+        for (uint32_t i = 0; i < n; i++) {
+            next_order[i] = (order[i] >= h) ? order[i] - h : order[i] + (n - h);
+        }
+        std::fill(count.begin(), count.begin() + classes + 1, 0);
+        for (uint32_t i = 0; i < n; i++) {
+            count[rank[next_order[i]] + 1]++;
+        }
+        for (uint32_t c = 0; c < classes; c++) {
+            count[c + 1] += count[c];
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            order[count[rank[next_order[i]]]++] = next_order[i];
+        }
+        uint32_t next_classes = 0;
+        next_rank[order[0]] = 0;
+        for (uint32_t i = 1; i < n; i++) {
+            uint32_t a = order[i], b = order[i - 1];
+            uint32_t a_half = (a < n - h) ? a + h : a - (n - h);
+            uint32_t b_half = (b < n - h) ? b + h : b - (n - h);
+            if (rank[a] != rank[b] or rank[a_half] != rank[b_half]) {
+                next_classes++;
+            }
+            next_rank[a] = next_classes;
+        }
+        rank.swap(next_rank);
+        classes = next_classes + 1;
+    }
+    uint32_t primary = 0;
+    size_t start = out.size();
+    out.resize(start + 4 + n);
+    for (uint32_t i = 0; i < n; i++) {
+        if (order[i] == 0) {
+            primary = i;
+        }
+        out[start + 4 + i] = static_cast<char>(in[(order[i] + n - 1) % n]);
+    }
+    for (int k = 0; k < 4; k++) {
+        out[start + k] = static_cast<char>(primary >> (8 * k));
+    }
+}
+
+/**
+ * name:       bwtInverse
+ * purpose:    Undoes BWT_TRANSFORM.
+ * arguments:  in - the transformed bytes.
+ *             size - the number of bytes at ++in++.
+ *             limit - the most bytes the original can have.
+ *             out - the string the original bytes are appended to.
+ * returns:    void
+ * effects:    Modifies ++out++. Throws a runtime_error if the row is out
+ *             of range or the output would pass ++limit++.
+ */
+static void bwtInverse(const unsigned char *in, size_t size,
+                       uint64_t limit, std::string &out) {
+    if (size < 4 or size - 4 > limit) {
+        throw std::runtime_error("Zapped block stream is malformed.");
+    }
+    uint32_t primary = 0;
+    for (int k = 0; k < 4; k++) {
+        primary |= static_cast<uint32_t>(in[k]) << (8 * k);
+    }
+    const unsigned char *last = in + 4;
+    uint32_t n = static_cast<uint32_t>(size - 4);
+    if (n == 0) {
+        return;
+    }
+    if (primary >= n) {
+        throw std::runtime_error("Zapped block stream is malformed.");
+    }
+    // the row of each rotation's left neighbour in the sorted order
+    uint32_t first[256] = {0};
+    for (uint32_t i = 0; i < n; i++) {
+        first[last[i]]++;
+    }
+    uint32_t total = 0;
+    for (int c = 0; c < 256; c++) {
+        uint32_t count = first[c];
+        first[c] = total;
+        total += count;
+    }
+    std::vector<uint32_t> left(n);
+    for (uint32_t i = 0; i < n; i++) {
+        left[i] = first[last[i]]++;
+    }
+    size_t start = out.size();
+    out.resize(start + n);
+    uint32_t row = primary;
+    for (uint32_t k = n; k-- > 0; ) {
+        out[start + k] = static_cast<char>(last[row]);
+        row = left[row];
+    }
+}
+
+/**
+ * name:       moveToFrontForward
+ * purpose:    Applies MTF_TRANSFORM.
+ * arguments:  in - the bytes to transform.
+ *             size - the number of bytes at ++in++.
+ *             out - the string the transformed bytes are appended to.
+ * returns:    void
+ * effects:    Modifies ++out++.
+ */
+static void moveToFrontForward(const unsigned char *in, size_t size,
+                               std::string &out) {
+    unsigned char recent[256];
+    for (int c = 0; c < 256; c++) {
+        recent[c] = static_cast<unsigned char>(c);
+    }
+    for (size_t i = 0; i < size; i++) {
+        int position = 0;
+        while (recent[position] != in[i]) {
+            position++;
+        }
+        std::copy_backward(recent, recent + position, recent + position + 1);
+        recent[0] = in[i];
+        out += static_cast<char>(position);
+    }
+}
+
+/**
+ * name:       moveToFrontInverse
+ * purpose:    Undoes MTF_TRANSFORM.
+ * arguments:  in - the transformed bytes.
+ *             size - the number of bytes at ++in++.
+ *             out - the string the original bytes are appended to.
+ * returns:    void
+ * effects:    Modifies ++out++.
+ */
+static void moveToFrontInverse(const unsigned char *in, size_t size,
+                               std::string &out) {
+    unsigned char recent[256];
+    for (int c = 0; c < 256; c++) {
+        recent[c] = static_cast<unsigned char>(c);
+    }
+    for (size_t i = 0; i < size; i++) {
+        int position = in[i];
+        unsigned char c = recent[position];
+        std::copy_backward(recent, recent + position, recent + position + 1);
+        recent[0] = c;
+        out += static_cast<char>(c);
+    }
+}
+
+/**
+ * name:       stageBound
+ * purpose:    Bounds the output of one transform.
+ * arguments:  stage - the transform.
+ *             size - the number of bytes it is given.
+ * returns:    The most bytes ++stage++ can turn ++size++ bytes into.
+ * effects:    None.
+ */
+static uint64_t stageBound(TransformType stage, uint64_t size) {
+    switch (stage) {
+    case RLE_TRANSFORM:
+        return size + size / 4 + 1;
+    case BWT_TRANSFORM:
+        return size + 4;
+    default:
+        return size;
+    }
+}
+
+/**
+ * name:       parseTransforms
+ * purpose:    Reads a pipeline as typed on the command line.
+ * arguments:  list - stage names separated by commas, e.g. "bwt,mtf";
+ *             the names are rle, bwt and mtf.
+ *             pipeline - set to the stages, in order.
+ * returns:    true if ++list++ names 1 to MAX_TRANSFORMS known stages.
+ * effects:    Modifies ++pipeline++.
+ */
+bool parseTransforms(const std::string& list, TransformPipeline& pipeline) {
+    pipeline.clear();
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t end = std::min(list.find(',', start), list.size());
+        std::string name = list.substr(start, end - start);
+        if (name == "rle") {
+            pipeline.push_back(RLE_TRANSFORM);
+        } else if (name == "bwt") {
+            pipeline.push_back(BWT_TRANSFORM);
+        } else if (name == "mtf") {
+            pipeline.push_back(MTF_TRANSFORM);
+        } else {
+            return false;
+        }
+        start = end + 1;
+    }
+    return pipeline.size() <= MAX_TRANSFORMS;
+}
+
+/**
+ * name:       transformedSizeBound
+ * purpose:    Bounds the size of a block after a pipeline has run.
+ * arguments:  pipeline - the stages.
+ *             size - the number of bytes in the block.
+ * returns:    The most bytes the pipeline can turn ++size++ bytes into.
+ * effects:    None.
+ */
+uint64_t transformedSizeBound(const TransformPipeline& pipeline,
+                              uint64_t size) {
+    for (TransformType stage : pipeline) {
+        size = stageBound(stage, size);
+    }
+    return size;
+}
+
+/**
+ * name:       forwardTransforms
+ * purpose:    Runs a pipeline over a block.
+ * arguments:  pipeline - the stages, run first to last.
+ *             text - the block; replaced by the transformed block.
+ *             size - the number of bytes of ++text++ in use; set to the
+ *             transformed size.
+ *             scratch - a buffer that keeps its capacity between calls.
+ * returns:    void
+ * effects:    Modifies ++text++, ++size++ and ++scratch++.
+ */
+void forwardTransforms(const TransformPipeline& pipeline, std::string& text,
+                       uint64_t& size, std::string& scratch) {
+    for (TransformType stage : pipeline) {
+        const unsigned char *in =
+                    reinterpret_cast<const unsigned char *>(text.data());
+        scratch.clear();
+        switch (stage) {
+        case RLE_TRANSFORM:
+            runLengthForward(in, size, scratch);
+            break;
+        case BWT_TRANSFORM:
+            bwtForward(in, size, scratch);
+            break;
+        case MTF_TRANSFORM:
+            moveToFrontForward(in, size, scratch);
+            break;
+        }
+        text.swap(scratch);
+        size = text.size();
+    }
+}
+
+/**
+ * name:       inverseTransforms
+ * purpose:    Undoes a pipeline on a decoded block.
+ * arguments:  pipeline - the stages, undone last to first.
+ *             text - the decoded block; replaced by the original.
+ *             size - the number of bytes of ++text++ in use; set to the
+ *             original size.
+ *             block_size - the stream's block size, which bounds the
+ *             original.
+ *             scratch - a buffer that keeps its capacity between calls.
+ * returns:    void
+ * effects:    Modifies ++text++, ++size++ and ++scratch++. Throws a
+ *             runtime_error if the block cannot have come from a block of
+ *             at most ++block_size++ bytes.
+ */
+void inverseTransforms(const TransformPipeline& pipeline, std::string& text,
+                       uint64_t& size, uint64_t block_size,
+                       std::string& scratch) {
+    // limits[k] bounds the input of stage k, and so the output of its undo
+    std::vector<uint64_t> limits(1, block_size);
+    for (TransformType stage : pipeline) {
+        limits.push_back(stageBound(stage, limits.back()));
+    }
+    for (size_t k = pipeline.size(); k-- > 0; ) {
+        const unsigned char *in =
+                    reinterpret_cast<const unsigned char *>(text.data());
+        scratch.clear();
+        switch (pipeline[k]) {
+        case RLE_TRANSFORM:
+            runLengthInverse(in, size, limits[k], scratch);
+            break;
+        case BWT_TRANSFORM:
+            bwtInverse(in, size, limits[k], scratch);
+            break;
+        case MTF_TRANSFORM:
+            moveToFrontInverse(in, size, scratch);
+            break;
+        }
+        text.swap(scratch);
+        size = text.size();
+    }
+}
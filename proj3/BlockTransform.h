@@ -0,0 +1,49 @@
+/**
+ * File: BlockTransform.h
+ * Description: Declares the transforms a "ZBLT" stream applies to each
+ * block before it is coded, and undoes after it is decoded. They do not
+ * compress on their own; they reshape the text so the Huffman code finds
+ * more to work with. A pipeline is a list of stages run in order (and
+ * undone in reverse), recorded in the stream header. Adding a stage means
+ * adding a TransformType, its two functions in BlockTransform.cpp, and a
+ * name for parseTransforms.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#ifndef BLOCKTRANSFORM_H
+#define BLOCKTRANSFORM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum TransformType {
+    // four equal bytes are followed by a count of further repeats
+    RLE_TRANSFORM = 1,
+    // Burrows-Wheeler transform: the 4-byte little-endian row of the
+    // text, then the last column of its sorted rotations
+    BWT_TRANSFORM = 2,
+    // move-to-front: each byte becomes its position in a list of recently
+    // seen bytes, so runs of a few bytes become runs of small numbers
+    MTF_TRANSFORM = 3
+};
+
+typedef std::vector<TransformType> TransformPipeline;
+
+// most stages a stream header may list
+static const size_t MAX_TRANSFORMS = 8;
+
+bool parseTransforms(const std::string& list, TransformPipeline& pipeline);
+
+uint64_t transformedSizeBound(const TransformPipeline& pipeline,
+                              uint64_t size);
+
+void forwardTransforms(const TransformPipeline& pipeline, std::string& text,
+                       uint64_t& size, std::string& scratch);
+void inverseTransforms(const TransformPipeline& pipeline, std::string& text,
+                       uint64_t& size, uint64_t block_size,
+                       std::string& scratch);
+
+#endif
@@ -0,0 +1,229 @@
+/**
+ * File: CanonicalCode.cpp
+ * Description: Implements the canonical Huffman code functions. Codes are
+ * assigned in order of (length, byte value), the same rule DEFLATE uses,
+ * and the header stores the number of coded bytes followed by one
+ * (byte, length) pair per coded byte in increasing byte order.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#include "CanonicalCode.h"
+#include <stdexcept>
+
+// lengths must fit the 64-bit HuffmanCode::bits with room to shift
+static const int MAX_CANONICAL_LENGTH = 63;
+
+/**
+ * name:       collectLengths
+ * purpose:    Records the depth of every leaf below ++node++.
+ * arguments:  node - the subtree to walk.
+ *             depth - the depth of ++node++.
+ *             lengths - the array that receives the depths.
+ * returns:    void
+ * effects:    Throws a runtime_error on an internal node that is missing a
+ *             child or on a leaf deeper than MAX_CANONICAL_LENGTH.
+ */
+static void collectLengths(const HuffmanTreeNode *node, int depth,
+                           CodeLengths &lengths) {
+    if (node->isLeaf()) {
+        if (depth > MAX_CANONICAL_LENGTH) {
+            throw std::runtime_error("Huffman code is too long.");
+        }
+        lengths[static_cast<unsigned char>(node->get_val())] = depth;
+        return;
+    }
+    if (not node->get_left() or not node->get_right()) {
+        throw std::runtime_error("Huffman tree is malformed.");
+    }
+    collectLengths(node->get_left(), depth + 1, lengths);
+    collectLengths(node->get_right(), depth + 1, lengths);
+}
+
+/**
+ * name:       isFullTree
+ * purpose:    Checks that every internal node has two children.
+ * arguments:  node - the subtree to check.
+ * returns:    true if the subtree is full.
+ * effects:    None.
+ */
+static bool isFullTree(const HuffmanTreeNode *node) {
+    if (node->isLeaf()) return true;
+    if (not node->get_left() or not node->get_right()) return false;
+    return isFullTree(node->get_left()) and isFullTree(node->get_right());
+}
+
+/**
+ * name:       codeLengthsFromTree
+ * purpose:    Finds the code length of every byte in a Huffman tree.
+ * arguments:  root - a pointer to the root of the Huffman tree.
+ * returns:    The depth of each leaf, indexed by its byte. A tree that is
+ *             a single leaf gives that byte length 1, matching encodeText.
+ * effects:    Throws a runtime_error if the tree is empty or malformed.
+ */
+CodeLengths codeLengthsFromTree(const HuffmanTreeNode *root) {
+    if (not root) throw std::runtime_error("Huffman tree is empty.");
+    CodeLengths lengths = {};
+    if (root->isLeaf()) {
+        lengths[static_cast<unsigned char>(root->get_val())] = 1;
+    } else {
+        collectLengths(root, 0, lengths);
+    }
+    return lengths;
+}
+
+/**
+ * name:       canonicalCodes
+ * purpose:    Assigns canonical code words for a set of code lengths.
+ * arguments:  lengths - the code length of each byte.
+ * returns:    The code word of each byte. Shorter codes come first, and
+ *             codes of equal length are consecutive in byte order.
+ * effects:    Throws a runtime_error if a length is too long or if the
+ *             lengths ask for more codes than fit (a corrupt header).
+ */
+CodeTable canonicalCodes(const CodeLengths &lengths) {
+    uint64_t length_counts[MAX_CANONICAL_LENGTH + 1] = {0};
+    for (int symbol = 0; symbol < 256; symbol++) {
+        if (lengths[symbol] > MAX_CANONICAL_LENGTH) {
+            throw std::runtime_error("Huffman code is too long.");
+        }
+        length_counts[lengths[symbol]]++;
+    }
+    length_counts[0] = 0;
+    uint64_t next_code[MAX_CANONICAL_LENGTH + 1] = {0};
+    uint64_t code = 0;
+    for (int length = 1; length <= MAX_CANONICAL_LENGTH; length++) {
+        code = (code + length_counts[length - 1]) << 1;
+        next_code[length] = code;
+        // Kraft: the codes of this length must fit in length bits
+        if (code + length_counts[length] > (uint64_t(1) << length)) {
+            throw std::runtime_error("Huffman code lengths are invalid.");
+        }
+    }
+    CodeTable codes = {};
+    for (int symbol = 0; symbol < 256; symbol++) {
+        int length = lengths[symbol];
+        if (length > 0) {
+            codes[symbol].bits = next_code[length]++;
+            codes[symbol].length = length;
+        }
+    }
+    return codes;
+}
+
+/**
+ * name:       treeFromCodes
+ * purpose:    Builds the Huffman tree whose root-to-leaf paths are a given
+ *             set of code words (left = 0, right = 1), so codes that were
+ *             not made from a tree can still be stored as one.
+ * arguments:  codes - the code word of each byte; must be prefix free and
+ *             complete.
+ *             arena - the arena the nodes are created in.
+ * returns:    A pointer to the root of the new tree. Internal nodes hold
+ *             '\0' and every frequency is 0.
+ * effects:    Creates the tree in ++arena++, which owns it. A single code
+ *             gives a lone leaf, as buildHuffmanTree does. Throws a 
+ *             runtime_error if the codes are not prefix free or leave a 
+ *             node with one child.
+ */
+HuffmanTreeNode *treeFromCodes(const CodeTable &codes, TreeArena &arena) {
+    int count = 0;
+    for (const HuffmanCode &code : codes) {
+        count += (code.length > 0);
+    }
+    if (count == 0) throw std::runtime_error("Huffman tree is empty.");
+    if (count == 1) {
+        for (int symbol = 0; symbol < 256; symbol++) {
+            if (codes[symbol].length > 0) {
+                return arena.create(static_cast<char>(symbol), 0);
+            }
+        }
+    }
+    HuffmanTreeNode *root = arena.create('\0', 0, nullptr, nullptr);
+    bool valid = true;
+    for (int symbol = 0; symbol < 256 and valid; symbol++) {
+        const HuffmanCode &code = codes[symbol];
+        if (code.length == 0) continue;
+        HuffmanTreeNode *curr = root;
+        for (int i = code.length - 1; i > 0 and valid; i--) {
+            bool right = (code.bits >> i) & 1;
+            HuffmanTreeNode *next = right ? curr->get_right()
+                                          : curr->get_left();
+            if (not next) {
+                next = arena.create('\0', 0, nullptr, nullptr);
+                right ? curr->set_right(next) : curr->set_left(next);
+            } else if (next->isLeaf()) {
+                // every internal node already has a child, so this is the
+                // leaf of a shorter code that is a prefix of this one
+                valid = false;
+            }
+            curr = next;
+        }
+        bool right = code.bits & 1;
+        if (valid and (right ? curr->get_right() : curr->get_left())) {
+            valid = false; // the slot is already taken
+        }
+        if (valid) {
+            HuffmanTreeNode *leaf = arena.create(static_cast<char>(symbol), 0);
+            right ? curr->set_right(leaf) : curr->set_left(leaf);
+        }
+    }
+    if (not valid or not isFullTree(root)) {
+        throw std::runtime_error("Huffman codes do not form a tree.");
+    }
+    return root;
+}
+
+/**
+ * name:       serializeCodeLengths
+ * purpose:    Serializes code lengths into a compact header.
+ * arguments:  lengths - the code length of each byte.
+ * returns:    One byte holding the number of coded bytes minus one, then
+ *             a (byte, length) pair for each coded byte.
+ * effects:    Throws a runtime_error if no byte has a code.
+ */
+std::string serializeCodeLengths(const CodeLengths &lengths) {
+    std::string header(1, '\0');
+    int count = 0;
+    for (int symbol = 0; symbol < 256; symbol++) {
+        if (lengths[symbol] > 0) {
+            header.push_back(static_cast<char>(symbol));
+            header.push_back(static_cast<char>(lengths[symbol]));
+            count++;
+        }
+    }
+    if (count == 0) throw std::runtime_error("Huffman tree is empty.");
+    header[0] = static_cast<char>(count - 1);
+    return header;
+}
+
+/**
+ * name:       deserializeCodeLengths
+ * purpose:    Reads a header written by serializeCodeLengths.
+ * arguments:  data - the bytes holding the header.
+ *             pos - the position of the header; moved past it.
+ * returns:    The code length of each byte.
+ * effects:    Throws a runtime_error if the header is truncated, lists a
+ *             byte twice or out of order, or gives a zero length.
+ */
+CodeLengths deserializeCodeLengths(const std::string &data, size_t &pos) {
+    if (pos >= data.size()) {
+        throw std::runtime_error("Zapped file header is truncated.");
+    }
+    int count = static_cast<unsigned char>(data[pos++]) + 1;
+    if (data.size() - pos < static_cast<size_t>(count) * 2) {
+        throw std::runtime_error("Zapped file header is truncated.");
+    }
+    CodeLengths lengths = {};
+    int previous = -1;
+    for (int i = 0; i < count; i++) {
+        int symbol = static_cast<unsigned char>(data[pos++]);
+        int length = static_cast<unsigned char>(data[pos++]);
+        if (symbol <= previous or length == 0) {
+            throw std::runtime_error("Zapped file header is malformed.");
+        }
+        lengths[symbol] = length;
+        previous = symbol;
+    }
+    return lengths;
+}
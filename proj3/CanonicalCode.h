@@ -0,0 +1,30 @@
+/**
+ * File: CanonicalCode.h
+ * Description: Declares functions for canonical Huffman codes. A canonical
+ * code is fully determined by the code length of each byte, so a zapped
+ * file only has to store those lengths and the decoder can build its
+ * lookup tables straight from them without rebuilding a tree.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#ifndef CANONICALCODE_H
+#define CANONICALCODE_H
+
+#include <cstddef>
+#include <string>
+#include "HuffmanCode.h"
+#include "HuffmanTreeNode.h"
+#include "TreeArena.h"
+
+CodeLengths codeLengthsFromTree(const HuffmanTreeNode *root);
+
+CodeTable canonicalCodes(const CodeLengths &lengths);
+
+HuffmanTreeNode *treeFromCodes(const CodeTable &codes, TreeArena &arena);
+
+std::string serializeCodeLengths(const CodeLengths &lengths);
+
+CodeLengths deserializeCodeLengths(const std::string &data, size_t &pos);
+
+#endif
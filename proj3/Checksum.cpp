@@ -0,0 +1,188 @@
+/**
+ * File: Checksum.cpp
+ * Description: Implements the CRC-32C kernels. The table-driven kernel
+ * uses eight tables ("slicing by 8"), so each step looks up the eight
+ * bytes of a word independently instead of one byte after another.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#include "Checksum.h"
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <nmmintrin.h>
+#define ZAP_CRC32C_SSE42 1
+#endif
+
+// the CRC-32C polynomial, bit reversed
+static const uint32_t POLYNOMIAL = 0x82f63b78;
+
+/* Slicing-by-8 tables: entries[k][b] is the CRC of byte b followed by k
+ * zero bytes. */
+struct CrcTables {
+    CrcTables();
+    uint32_t entries[8][256];
+};
+
+/**
+ * name:       CrcTables
+ * purpose:    Fills the tables from the polynomial.
+ * arguments:  none
+ * returns:    n/a
+ * effects:    None.
+ */
+CrcTables::CrcTables() {
+    for (uint32_t byte = 0; byte < 256; byte++) {
+        uint32_t crc = byte;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (POLYNOMIAL & (0 - (crc & 1)));
+        }
+        entries[0][byte] = crc;
+    }
+    for (int k = 1; k < 8; k++) {
+        for (int byte = 0; byte < 256; byte++) {
+            uint32_t previous = entries[k - 1][byte];
+            entries[k][byte] = (previous >> 8) ^ entries[0][previous & 0xff];
+        }
+    }
+}
+
+/**
+ * name:       crcTables
+ * purpose:    Gives the tables, building them on first use.
+ * arguments:  none
+ * returns:    The tables.
+ * effects:    None after the first call, which is safe from any thread.
+ */
+static const CrcTables &crcTables() {
+    static const CrcTables tables;
+    return tables;
+}
+
+/**
+ * name:       loadLittle32
+ * purpose:    Reads four bytes as a little-endian integer.
+ * arguments:  bytes - the bytes to read.
+ * returns:    The integer, the same on any CPU.
+ * effects:    None.
+ */
+static uint32_t loadLittle32(const unsigned char *bytes) {
+    return static_cast<uint32_t>(bytes[0]) |
+           static_cast<uint32_t>(bytes[1]) << 8 |
+           static_cast<uint32_t>(bytes[2]) << 16 |
+           static_cast<uint32_t>(bytes[3]) << 24;
+}
+
+/**
+ * name:       crcTable
+ * purpose:    Runs the table-driven kernel.
+ * arguments:  crc - the register so far, already inverted.
+ *             data - the bytes to add.
+ *             size - the number of bytes at ++data++.
+ * returns:    The register after ++data++.
+ * effects:    None.
+ */
+static uint32_t crcTable(uint32_t crc, const unsigned char *data,
+                         size_t size) {
+    const uint32_t (*entries)[256] = crcTables().entries;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint32_t low = crc ^ loadLittle32(data + i);
+        uint32_t high = loadLittle32(data + i + 4);
+        crc = entries[7][low & 0xff] ^ entries[6][(low >> 8) & 0xff] ^
+              entries[5][(low >> 16) & 0xff] ^ entries[4][low >> 24] ^
+              entries[3][high & 0xff] ^ entries[2][(high >> 8) & 0xff] ^
+              entries[1][(high >> 16) & 0xff] ^ entries[0][high >> 24];
+    }
+    for (; i < size; i++) {
+        crc = (crc >> 8) ^ entries[0][(crc ^ data[i]) & 0xff];
+    }
+    return crc;
+}
+
+#if ZAP_CRC32C_SSE42
+/**
+ * name:       crcHardware
+ * purpose:    Runs the SSE4.2 kernel.
+ * arguments:  crc - the register so far, already inverted.
+ *             data - the bytes to add.
+ *             size - the number of bytes at ++data++.
+ * returns:    The register after ++data++.
+ * effects:    None. Only called once haveHardware() has said so.
+ */
+__attribute__((target("sse4.2")))
+static uint32_t crcHardware(uint32_t crc, const unsigned char *data,
+                            size_t size) {
+    uint64_t wide = crc;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, 8);
+        wide = _mm_crc32_u64(wide, word);
+    }
+    crc = static_cast<uint32_t>(wide);
+    for (; i < size; i++) {
+        crc = _mm_crc32_u8(crc, data[i]);
+    }
+    return crc;
+}
+#endif
+
+/**
+ * name:       haveHardware
+ * purpose:    Checks whether the running CPU has the crc32 instruction.
+ * arguments:  none
+ * returns:    true if crcHardware may be used.
+ * effects:    None. The CPU is only queried once.
+ */
+static bool haveHardware() {
+#if ZAP_CRC32C_SSE42
+    static const bool sse42 = __builtin_cpu_supports("sse4.2");
+    return sse42;
+#else
+    return false;
+#endif
+}
+
+/**
+ * name:       crc32c
+ * purpose:    Computes the CRC-32C of some bytes with the fastest kernel
+ *             the CPU supports.
+ * arguments:  data - the bytes to check.
+ *             size - the number of bytes at ++data++.
+ * returns:    The CRC; "123456789" gives 0xe3069283.
+ * effects:    None.
+ */
+uint32_t crc32c(const unsigned char *data, size_t size) {
+#if ZAP_CRC32C_SSE42
+    if (haveHardware()) {
+        return ~crcHardware(~0u, data, size);
+    }
+#endif
+    return ~crcTable(~0u, data, size);
+}
+
+/**
+ * name:       crc32cScalar
+ * purpose:    Computes the CRC-32C of some bytes without the crc32
+ *             instruction, for comparison with crc32c.
+ * arguments:  data - the bytes to check.
+ *             size - the number of bytes at ++data++.
+ * returns:    The CRC.
+ * effects:    None.
+ */
+uint32_t crc32cScalar(const unsigned char *data, size_t size) {
+    return ~crcTable(~0u, data, size);
+}
+
+/**
+ * name:       checksumKernel
+ * purpose:    Names the kernel crc32c uses on this CPU.
+ * arguments:  none
+ * returns:    "sse4.2" or "scalar".
+ * effects:    None.
+ */
+const char *checksumKernel() {
+    return haveHardware() ? "sse4.2" : "scalar";
+}
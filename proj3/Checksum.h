@@ -0,0 +1,24 @@
+/**
+ * File: Checksum.h
+ * Description: Declares the CRC-32C (Castagnoli) kernels that check the
+ * text of each stream block. x86 CPUs with SSE4.2 compute it with the
+ * crc32 instruction, 8 bytes at a time; elsewhere a table-driven kernel
+ * takes 8 bytes per step. The kernel is picked at runtime, the same way
+ * the histogram kernels are.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <cstddef>
+#include <cstdint>
+
+uint32_t crc32c(const unsigned char *data, size_t size);
+
+uint32_t crc32cScalar(const unsigned char *data, size_t size);
+
+const char *checksumKernel();
+
+#endif
@@ -0,0 +1,136 @@
+/**
+ * File: ChunkQueue.cpp
+ * Description: Implements ChunkQueue with a mutex and one condition
+ * variable that both sides wait on.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#include "ChunkQueue.h"
+
+/**
+ * name:       ChunkQueue
+ * purpose:    Makes an empty, open queue.
+ * arguments:  depth_in - the most chunks that may wait for the consumer;
+ *             at least 1.
+ * returns:    n/a
+ * effects:    None.
+ */
+ChunkQueue::ChunkQueue(size_t depth_in)
+    : depth(depth_in > 0 ? depth_in : 1), closed(false), aborted(false) {}
+
+/**
+ * name:       push
+ * purpose:    Hands a chunk to the consumer, waiting while the queue is
+ *             full.
+ * arguments:  chunk - the bytes to hand over; replaced by an empty chunk,
+ *             one the consumer has finished with if there is one.
+ * returns:    false if the queue was aborted, in which case ++chunk++ is
+ *             left alone; true otherwise.
+ * effects:    Wakes the consumer.
+ */
+bool ChunkQueue::push(std::string &chunk) {
+    std::unique_lock<std::mutex> guard(lock);
+    changed.wait(guard, [this]() {
+        return aborted or chunks.size() < depth;
+    });
+    if (aborted) {
+        return false;
+    }
+    chunks.push_back(std::string());
+    chunks.back().swap(chunk);
+    if (not spares.empty()) {
+        chunk.swap(spares.back());
+        spares.pop_back();
+    }
+    guard.unlock();
+    changed.notify_all();
+    return true;
+}
+
+/**
+ * name:       pop
+ * purpose:    Takes the oldest chunk, waiting while the queue is empty.
+ * arguments:  chunk - replaced by the chunk; what it held is cleared and
+ *             kept for the producer to refill.
+ * returns:    false once the queue is closed and empty, or aborted; true
+ *             otherwise.
+ * effects:    Wakes the producer.
+ */
+bool ChunkQueue::pop(std::string &chunk) {
+    std::unique_lock<std::mutex> guard(lock);
+    changed.wait(guard, [this]() {
+        return aborted or closed or not chunks.empty();
+    });
+    if (aborted or chunks.empty()) {
+        return false;
+    }
+    chunk.clear(); // keeps its capacity
+    spares.push_back(std::string());
+    spares.back().swap(chunk);
+    chunk.swap(chunks.front());
+    chunks.pop_front();
+    guard.unlock();
+    changed.notify_all();
+    return true;
+}
+
+/**
+ * name:       close
+ * purpose:    Tells the consumer no more chunks will come.
+ * arguments:  none
+ * returns:    void
+ * effects:    pop() returns false once the queued chunks are taken.
+ */
+void ChunkQueue::close() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        closed = true;
+    }
+    changed.notify_all();
+}
+
+/**
+ * name:       abort
+ * purpose:    Stops the queue, from either side.
+ * arguments:  message_in - why, such as the error a read or write failed
+ *             with; empty when one side simply gives up.
+ * returns:    void
+ * effects:    Wakes both sides; push() and pop() return false from now on.
+ *             The first message given is the one error() reports.
+ */
+void ChunkQueue::abort(const std::string &message_in) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (not aborted) {
+            message = message_in;
+        }
+        aborted = true;
+    }
+    changed.notify_all();
+}
+
+/**
+ * name:       stopped
+ * purpose:    Tells a producer that is about to wait on a slow file that
+ *             nobody wants its chunks any more.
+ * arguments:  none
+ * returns:    true if the queue was aborted.
+ * effects:    None.
+ */
+bool ChunkQueue::stopped() {
+    std::lock_guard<std::mutex> guard(lock);
+    return aborted;
+}
+
+/**
+ * name:       error
+ * purpose:    Reports why the queue was aborted.
+ * arguments:  none
+ * returns:    The message given to abort(), or an empty string.
+ * effects:    None.
+ */
+std::string ChunkQueue::error() {
+    std::lock_guard<std::mutex> guard(lock);
+    return message;
+}
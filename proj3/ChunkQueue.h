@@ -0,0 +1,56 @@
+/**
+ * File: ChunkQueue.h
+ * Description: Defines ChunkQueue, a bounded queue of byte chunks between
+ * one producing and one consuming thread. FileReader uses one to read
+ * ahead of the coder and FileWriter to write behind it, so the disk and
+ * the coder work at the same time instead of taking turns. Chunks are
+ * swapped in and out rather than copied, and emptied chunks are handed
+ * back to the producer to refill, so a running pipeline allocates
+ * nothing.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#ifndef CHUNKQUEUE_H
+#define CHUNKQUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class ChunkQueue {
+public:
+    explicit ChunkQueue(size_t depth);
+
+    bool push(std::string &chunk);
+    bool pop(std::string &chunk);
+
+    void close();
+    void abort(const std::string &message);
+
+    bool stopped();
+    std::string error();
+
+private:
+    ChunkQueue(const ChunkQueue &) = delete;
+    ChunkQueue &operator=(const ChunkQueue &) = delete;
+
+    // most chunks waiting for the consumer
+    size_t depth;
+    std::deque<std::string> chunks;
+    // emptied chunks, kept for their capacity
+    std::vector<std::string> spares;
+    // set by close: no more chunks will come
+    bool closed;
+    // set by abort: neither side should go on
+    bool aborted;
+    // why the queue was aborted; empty if it was given up on, not failed
+    std::string message;
+    std::mutex lock;
+    std::condition_variable changed;
+};
+
+#endif
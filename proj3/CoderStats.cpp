@@ -0,0 +1,218 @@
+/**
+ * File: CoderStats.cpp
+ * Description: Implements CoderStats, StageTimer and the --stats report.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#include "CoderStats.h"
+#include <sys/resource.h>
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+static const char *STAGE_NAMES[STAGE_COUNT] = {
+    "read", "transform", "histogram", "build", "codegen", "encode", "decode",
+    "checksum", "write"
+};
+
+/**
+ * name:       add
+ * purpose:    Adds another record's times and counters to this one.
+ * arguments:  other - the record to add, usually one block's.
+ * returns:    void
+ * effects:    Sums every time and counter; keeps the longer of the two
+ *             longest codes.
+ */
+void CoderStats::add(const CoderStats& other) {
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        stage_seconds[stage] += other.stage_seconds[stage];
+    }
+    total_seconds += other.total_seconds;
+    input_bytes += other.input_bytes;
+    output_bytes += other.output_bytes;
+    blocks += other.blocks;
+    symbols += other.symbols;
+    code_bits += other.code_bits;
+    entropy_bits += other.entropy_bits;
+    max_code_length = std::max(max_code_length, other.max_code_length);
+    threads = std::max(threads, other.threads);
+}
+
+/**
+ * name:       countBlock
+ * purpose:    Records one coded block.
+ * arguments:  frequencies - the counts of the bytes the block coded.
+ *             bits - the bits its codes took, without headers.
+ *             code_length - its longest code word, or 0 if it has none.
+ * returns:    void
+ * effects:    Adds the block to blocks, symbols, code_bits and
+ *             entropy_bits, and raises max_code_length to ++code_length++.
+ */
+void CoderStats::countBlock(const FrequencyTable& frequencies, uint64_t bits,
+                            int code_length) {
+    uint64_t total = 0;
+    for (uint64_t count : frequencies) {
+        total += count;
+    }
+    // H = sum of count * log2(total / count) over the bytes that occur
+    for (uint64_t count : frequencies) {
+        if (count != 0) {
+            entropy_bits += count * std::log2(static_cast<double>(total) /
+                                              count);
+        }
+    }
+    blocks++;
+    symbols += total;
+    code_bits += bits;
+    max_code_length = std::max(max_code_length, code_length);
+}
+
+/**
+ * name:       StageTimer
+ * purpose:    Starts timing a stage.
+ * arguments:  stats - the record the time is added to.
+ *             stage - the stage being timed.
+ * returns:    N/A
+ * effects:    Reads the clock.
+ */
+StageTimer::StageTimer(CoderStats& stats, CoderStage stage)
+    : seconds(&stats.stage_seconds[stage]),
+      start(std::chrono::steady_clock::now()) {}
+
+/**
+ * name:       StageTimer
+ * purpose:    Starts timing something other than a stage.
+ * arguments:  seconds_in - the total the time is added to, such as 
+ *             CoderStats::total_seconds.
+ * returns:    N/A
+ * effects:    Reads the clock.
+ */
+StageTimer::StageTimer(double& seconds_in)
+    : seconds(&seconds_in), start(std::chrono::steady_clock::now()) {}
+
+/**
+ * name:       ~StageTimer
+ * purpose:    Stops the timer if stop has not.
+ * arguments:  none
+ * returns:    N/A
+ * effects:    See stop.
+ */
+StageTimer::~StageTimer() {
+    stop();
+}
+
+/**
+ * name:       stop
+ * purpose:    Ends the stage before the timer goes out of scope.
+ * arguments:  none
+ * returns:    void
+ * effects:    Adds the time since the timer started to its stage, the
+ *             first time it is called.
+ */
+void StageTimer::stop() {
+    if (seconds != nullptr) {
+        *seconds += std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - start).count();
+        seconds = nullptr;
+    }
+}
+
+/**
+ * name:       peakMemoryKilobytes
+ * purpose:    Reports the most memory the process has held.
+ * arguments:  none
+ * returns:    The peak resident set size in kilobytes.
+ * effects:    None.
+ */
+long peakMemoryKilobytes() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024; // bytes on macOS
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+/**
+ * name:       printStats
+ * purpose:    Prints the report behind --stats.
+ * arguments:  out - the stream to print to.
+ *             stats - the record to report.
+ *             operation - "zap" or "unzap".
+ *             json - true for one JSON object, false for lines meant to be
+ *             read.
+ * returns:    void
+ * effects:    Writes to ++out++. Stage times are summed over threads, so
+ *             JSON calls them "thread_seconds" and gives "threads"; the 
+ *             text report says so when there was more than one. The ratio
+ *             is output over input bytes, and
+ *             the per-symbol figures are left out (null in JSON) when
+ *             nothing was coded with a count of its own, as in a message
+ *             zapped with a dictionary.
+ */
+void printStats(std::ostream& out, const CoderStats& stats,
+                const std::string& operation, bool json) {
+    double ratio = stats.input_bytes == 0 ? 0 :
+        static_cast<double>(stats.output_bytes) / stats.input_bytes;
+    double bits_per_symbol = 0, entropy_per_symbol = 0;
+    if (stats.symbols != 0) {
+        bits_per_symbol = static_cast<double>(stats.code_bits) /
+                          stats.symbols;
+        entropy_per_symbol = stats.entropy_bits / stats.symbols;
+    }
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << std::fixed;
+    if (json) {
+        out << "{\"operation\": \"" << operation << "\""
+            << ", \"seconds\": " << std::setprecision(6)
+            << stats.total_seconds << ", \"threads\": " << stats.threads
+            << ", \"thread_seconds\": {";
+        for (int stage = 0; stage < STAGE_COUNT; stage++) {
+            out << (stage > 0 ? ", " : "") << "\"" << STAGE_NAMES[stage]
+                << "\": " << stats.stage_seconds[stage];
+        }
+        out << "}, \"input_bytes\": " << stats.input_bytes
+            << ", \"output_bytes\": " << stats.output_bytes
+            << ", \"ratio\": " << std::setprecision(4) << ratio
+            << ", \"blocks\": " << stats.blocks
+            << ", \"bits_per_symbol\": ";
+        if (stats.symbols != 0) {
+            out << bits_per_symbol << ", \"entropy_bits_per_symbol\": "
+                << entropy_per_symbol;
+        } else {
+            out << "null, \"entropy_bits_per_symbol\": null";
+        }
+        out << ", \"max_code_length\": " << stats.max_code_length
+            << ", \"peak_memory_kb\": " << peakMemoryKilobytes() << "}"
+            << std::endl;
+    } else {
+        out << operation << " took " << std::setprecision(6)
+            << stats.total_seconds << " s\n";
+        if (stats.threads > 1) {
+            out << "stage times summed over " << stats.threads 
+                << " threads:\n";
+        }
+        for (int stage = 0; stage < STAGE_COUNT; stage++) {
+            if (stats.stage_seconds[stage] > 0) {
+                out << "  " << std::left << std::setw(10)
+                    << STAGE_NAMES[stage] << std::right
+                    << stats.stage_seconds[stage] << " s\n";
+            }
+        }
+        out << std::setprecision(4) << stats.input_bytes << " bytes in, "
+            << stats.output_bytes << " bytes out, ratio " << ratio << "\n";
+        if (stats.symbols != 0) {
+            out << bits_per_symbol << " bits per symbol; the order-0 "
+                << "entropy is " << entropy_per_symbol << "\n";
+        }
+        out << stats.blocks << (stats.blocks == 1 ? " block" : " blocks")
+            << ", longest code " << stats.max_code_length
+            << " bits, peak memory " << peakMemoryKilobytes() << " KB"
+            << std::endl;
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
@@ -0,0 +1,81 @@
+/**
+ * File: CoderStats.h
+ * Description: Defines CoderStats, the timings and counters HuffmanCoder
+ * keeps for its last zap or unzap, and StageTimer, which adds the time a
+ * scope takes to one stage. Blocks coded on worker threads keep their own
+ * CoderStats, which are added up as the blocks are written, so stage
+ * times with -j are the total over all threads and can add up to more
+ * than the whole call took; the reports say so, and name the thread
+ * count.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#ifndef CODERSTATS_H
+#define CODERSTATS_H
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include "HuffmanCode.h"
+
+enum CoderStage {
+    READ_STAGE,
+    TRANSFORM_STAGE,
+    HISTOGRAM_STAGE,
+    BUILD_STAGE,
+    CODEGEN_STAGE,
+    ENCODE_STAGE,
+    DECODE_STAGE,
+    CHECKSUM_STAGE,
+    WRITE_STAGE,
+    STAGE_COUNT
+};
+
+struct CoderStats {
+    // seconds spent in each CoderStage, summed over the threads that ran
+    // it, and the wall time of the whole call
+    double stage_seconds[STAGE_COUNT] = {};
+    double total_seconds = 0;
+    // the most threads that coded blocks or files at once
+    int threads = 1;
+    uint64_t input_bytes = 0;
+    uint64_t output_bytes = 0;
+    uint64_t blocks = 0;
+    // bytes coded with a count of their own, after any transforms, the
+    // bits their codes took (headers excluded), and the order-0 entropy
+    // of each block summed over the blocks
+    uint64_t symbols = 0;
+    uint64_t code_bits = 0;
+    double entropy_bits = 0;
+    // the longest code word, which is the depth of the deepest leaf
+    int max_code_length = 0;
+
+    void add(const CoderStats& other);
+    void countBlock(const FrequencyTable& frequencies, uint64_t bits,
+                    int code_length);
+};
+
+class StageTimer {
+public:
+    StageTimer(CoderStats& stats, CoderStage stage);
+    explicit StageTimer(double& seconds);
+    ~StageTimer();
+
+    void stop();
+
+private:
+    StageTimer(const StageTimer &) = delete;
+    StageTimer &operator=(const StageTimer &) = delete;
+
+    double* seconds;
+    std::chrono::steady_clock::time_point start;
+};
+
+void printStats(std::ostream& out, const CoderStats& stats,
+                const std::string& operation, bool json);
+
+long peakMemoryKilobytes();
+
+#endif
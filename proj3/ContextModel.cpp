@@ -0,0 +1,267 @@
+/**
+ * File: ContextModel.cpp
+ * Description: Implements the order-1 context model. Contexts are
+ * clustered bottom up: the busiest ones start as clusters of their own,
+ * the rest share one, and the two clusters whose merge costs the fewest
+ * bits are merged until no merge pays for the code-length header it
+ * saves and no more than MAX_CONTEXT_CLUSTERS are left. Costs are
+ * estimated from the entropy of the histograms, which is quicker than
+ * building codes and ranks merges the same way.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#include "ContextModel.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+// contexts that start as clusters of their own; the rest start together
+static const int CONTEXT_SEEDS = 32;
+
+/**
+ * name:       clusterBits
+ * purpose:    Estimates the size of coding a histogram with one code.
+ * arguments:  counts - the frequency of each byte.
+ * returns:    The entropy of ++counts++ in bits, plus the bits of its 
+ *             code-length header.
+ * effects:    None.
+ */
+static double clusterBits(const FrequencyTable &counts) {
+    uint64_t total = 0;
+    double sum = 0;
+    int distinct = 0;
+    for (uint64_t count : counts) {
+        if (count > 0) {
+            total += count;
+            sum += count * std::log2(static_cast<double>(count));
+            distinct++;
+        }
+    }
+    if (total == 0) {
+        return 0;
+    }
+    return total * std::log2(static_cast<double>(total)) - sum +
+                                                    8 * (1 + 2 * distinct);
+}
+
+/**
+ * name:       mergedBits
+ * purpose:    Estimates the size of coding two histograms with one code.
+ * arguments:  a, b - the histograms.
+ * returns:    clusterBits of their sum.
+ * effects:    None.
+ */
+static double mergedBits(const FrequencyTable &a, const FrequencyTable &b) {
+    FrequencyTable sum;
+    for (int symbol = 0; symbol < 256; symbol++) {
+        sum[symbol] = a[symbol] + b[symbol];
+    }
+    return clusterBits(sum);
+}
+
+/**
+ * name:       countContextFrequencies
+ * purpose:    Counts each byte of a text by the byte before it.
+ * arguments:  text - the bytes to count.
+ *             size - the number of bytes at ++text++.
+ *             counts - replaced by 256 tables; counts[c][s] is the number
+ *             of times byte s follows byte c.
+ * returns:    void
+ * effects:    Modifies ++counts++. The first byte is counted after a 0.
+ */
+void countContextFrequencies(const unsigned char *text, size_t size,
+                             std::vector<FrequencyTable> &counts) {
+    counts.assign(256, FrequencyTable());
+    unsigned char previous = 0;
+    for (size_t i = 0; i < size; i++) {
+        counts[previous][text[i]]++;
+        previous = text[i];
+    }
+}
+
+/**
+ * name:       clusterContexts
+ * purpose:    Groups contexts whose followers look alike.
+ * arguments:  counts - the tables from countContextFrequencies.
+ *             cluster_of - set to the cluster of each context; contexts
+ *             that never occur are put in cluster 0.
+ *             cluster_counts - replaced by the summed histogram of each
+ *             cluster.
+ * returns:    The number of clusters, 1 to MAX_CONTEXT_CLUSTERS.
+ * effects:    Throws a runtime_error if ++counts++ is empty.
+ */
+int clusterContexts(const std::vector<FrequencyTable> &counts, 
+                    ContextMap &cluster_of,
+                    std::vector<FrequencyTable> &cluster_counts) {
+    std::array<uint64_t, 256> totals = {};
+    std::vector<int> contexts;
+    for (int context = 0; context < 256; context++) {
+        for (uint64_t count : counts[context]) {
+            totals[context] += count;
+        }
+        if (totals[context] > 0) {
+            contexts.push_back(context);
+        }
+    }
+    if (contexts.empty()) {
+        throw std::runtime_error("Huffman tree is empty.");
+    }
+    std::stable_sort(contexts.begin(), contexts.end(), 
+                     [&totals](int a, int b) { 
+                         return totals[a] > totals[b]; 
+                     });
+    // start with the busiest contexts alone and everything else together
+    cluster_counts.clear();
+    std::array<int, 256> group = {};
+    for (size_t i = 0; i < contexts.size(); i++) {
+        size_t g = std::min<size_t>(i, CONTEXT_SEEDS);
+        if (g == cluster_counts.size()) {
+            cluster_counts.push_back(FrequencyTable());
+        }
+        for (int symbol = 0; symbol < 256; symbol++) {
+            cluster_counts[g][symbol] += counts[contexts[i]][symbol];
+        }
+        group[contexts[i]] = static_cast<int>(g);
+    }
+    size_t n = cluster_counts.size();
+    std::vector<double> bits(n);
+    for (size_t i = 0; i < n; i++) {
+        bits[i] = clusterBits(cluster_counts[i]);
+    }
+    // gain[i][j] (i < j) is the bits saved by merging clusters i and j
+    std::vector<std::vector<double>> gain(n, std::vector<double>(n, 0));
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = i + 1; j < n; j++) {
+            gain[i][j] = bits[i] + bits[j] - 
+                            mergedBits(cluster_counts[i], cluster_counts[j]);
+        }
+    }
+    while (n > 1) {
+        size_t best_i = 0, best_j = 1;
+        for (size_t i = 0; i < n; i++) {
+            for (size_t j = i + 1; j < n; j++) {
+                if (gain[i][j] > gain[best_i][best_j]) {
+                    best_i = i;
+                    best_j = j;
+                }
+            }
+        }
+        if (n <= static_cast<size_t>(MAX_CONTEXT_CLUSTERS) and 
+                                        gain[best_i][best_j] <= 0) {
+            break;
+        }
+        // merge best_j into best_i, then move the last cluster to best_j
+        size_t last = n - 1;
+        for (int symbol = 0; symbol < 256; symbol++) {
+            cluster_counts[best_i][symbol] += cluster_counts[best_j][symbol];
+        }
+        bits[best_i] = clusterBits(cluster_counts[best_i]);
+        cluster_counts[best_j] = cluster_counts[last];
+        bits[best_j] = bits[last];
+        for (int context = 0; context < 256; context++) {
+            if (group[context] == static_cast<int>(best_j)) {
+                group[context] = static_cast<int>(best_i);
+            } else if (group[context] == static_cast<int>(last)) {
+                group[context] = static_cast<int>(best_j);
+            }
+        }
+        for (size_t k = 0; k < last; k++) { // move row and column last
+            if (k != best_j) {
+                double moved = gain[std::min(k, last)][std::max(k, last)];
+                gain[std::min(k, best_j)][std::max(k, best_j)] = moved;
+            }
+        }
+        n = last;
+        cluster_counts.resize(n);
+        bits.resize(n);
+        for (size_t k = 0; k < n; k++) { // only best_i's merges changed
+            if (k != best_i) {
+                gain[std::min(k, best_i)][std::max(k, best_i)] = 
+                            bits[k] + bits[best_i] - 
+                            mergedBits(cluster_counts[k], 
+                                       cluster_counts[best_i]);
+            }
+        }
+    }
+    for (int context = 0; context < 256; context++) {
+        cluster_of[context] = static_cast<uint8_t>(group[context]);
+    }
+    return static_cast<int>(n);
+}
+
+/**
+ * name:       serializeContextMap
+ * purpose:    Writes the context map of a CONTEXT_BLOCK.
+ * arguments:  cluster_of - the cluster of each context.
+ *             clusters - the number of clusters, 1 to 
+ *             MAX_CONTEXT_CLUSTERS.
+ * returns:    One byte holding the number of clusters minus one, then the
+ *             cluster of each context in 4 bits, two contexts per byte
+ *             with the lower context in the low bits.
+ * effects:    None.
+ */
+std::string serializeContextMap(const ContextMap &cluster_of, int clusters) {
+    std::string map(1 + 128, '\0');
+    map[0] = static_cast<char>(clusters - 1);
+    for (int context = 0; context < 256; context += 2) {
+        map[1 + context / 2] = static_cast<char>(cluster_of[context] | 
+                                            (cluster_of[context + 1] << 4));
+    }
+    return map;
+}
+
+/**
+ * name:       deserializeContextMap
+ * purpose:    Reads a map written by serializeContextMap.
+ * arguments:  data - the bytes holding the map.
+ *             pos - the position of the map; moved past it.
+ *             clusters - set to the number of clusters.
+ * returns:    The cluster of each context.
+ * effects:    Throws a runtime_error if the map is truncated, has too many
+ *             clusters, or names a cluster that does not exist.
+ */
+ContextMap deserializeContextMap(const std::string &data, size_t &pos,
+                                 int &clusters) {
+    if (data.size() - pos < 1 + 128) {
+        throw std::runtime_error("Zapped block stream is malformed.");
+    }
+    clusters = static_cast<unsigned char>(data[pos]) + 1;
+    if (clusters > MAX_CONTEXT_CLUSTERS) {
+        throw std::runtime_error("Zapped block stream is malformed.");
+    }
+    ContextMap cluster_of;
+    for (int context = 0; context < 256; context += 2) {
+        unsigned char pair = static_cast<unsigned char>(
+                                        data[pos + 1 + context / 2]);
+        cluster_of[context] = pair & 0x0f;
+        cluster_of[context + 1] = pair >> 4;
+        if (cluster_of[context] >= clusters or 
+                            cluster_of[context + 1] >= clusters) {
+            throw std::runtime_error("Zapped block stream is malformed.");
+        }
+    }
+    pos += 1 + 128;
+    return cluster_of;
+}
+
+/**
+ * name:       encodeWithContexts
+ * purpose:    Encodes text with a code chosen by each byte's predecessor.
+ * arguments:  text - the bytes to be encoded.
+ *             size - the number of bytes at ++text++.
+ *             codes_by_context - the code table for each previous byte.
+ *             writer - the BitWriter the code words are appended to.
+ * returns:    void
+ * effects:    Modifies ++writer++. The first byte is coded after a 0.
+ */
+void encodeWithContexts(const unsigned char *text, size_t size,
+                        const HuffmanCode *const *codes_by_context,
+                        BitWriter &writer) {
+    unsigned char previous = 0;
+    for (size_t i = 0; i < size; i++) {
+        const HuffmanCode &code = codes_by_context[previous][text[i]];
+        writer.write(code.bits, code.length);
+        previous = text[i];
+    }
+}
@@ -0,0 +1,43 @@
+/**
+ * File: ContextModel.h
+ * Description: Declares the order-1 context model used by CONTEXT_BLOCK
+ * blocks. Each byte is coded with a table chosen by the byte before it.
+ * The 256 possible previous bytes are grouped into at most
+ * MAX_CONTEXT_CLUSTERS clusters of similar followers, and each cluster
+ * gets one code, so the header stays a few kilobytes at most however the
+ * text looks. The first byte of a block is coded as if it followed a 0.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#ifndef CONTEXTMODEL_H
+#define CONTEXTMODEL_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "BitIO.h"
+#include "BlockFormat.h"
+#include "HuffmanCode.h"
+
+/* The cluster each previous byte's code is taken from. */
+typedef std::array<uint8_t, 256> ContextMap;
+
+void countContextFrequencies(const unsigned char *text, size_t size,
+                             std::vector<FrequencyTable> &counts);
+
+int clusterContexts(const std::vector<FrequencyTable> &counts, 
+                    ContextMap &cluster_of,
+                    std::vector<FrequencyTable> &cluster_counts);
+
+std::string serializeContextMap(const ContextMap &cluster_of, int clusters);
+ContextMap deserializeContextMap(const std::string &data, size_t &pos,
+                                 int &clusters);
+
+void encodeWithContexts(const unsigned char *text, size_t size,
+                        const HuffmanCode *const *codes_by_context,
+                        BitWriter &writer);
+
+#endif
@@ -0,0 +1,171 @@
+/**
+ * File: Dictionary.cpp
+ * Description: Implements Dictionary. A dictionary file is DICTIONARY_MAGIC
+ * followed by a code-length header (see CanonicalCode.h); the id is a
+ * 32-bit FNV-1a hash of that header, so the same code always has the same
+ * id and nothing but the code has to be stored.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#include "Dictionary.h"
+#include "CanonicalCode.h"
+#include "FileIO.h"
+#include "Histogram.h"
+#include "LengthLimit.h"
+#include "ZapFormat.h"
+#include <stdexcept>
+
+/**
+ * name:       Dictionary
+ * purpose:    Loads a dictionary saved by save().
+ * arguments:  filename - the path of the dictionary file.
+ * returns:    n/a
+ * effects:    Throws a runtime_error if the file cannot be read, is not a
+ *             dictionary, or does not give every byte a code.
+ */
+Dictionary::Dictionary(const std::string &filename) {
+    MappedFile file(filename);
+    std::string contents(reinterpret_cast<const char *>(file.data()), 
+                         file.size());
+    if (not hasMagic(contents, DICTIONARY_MAGIC)) {
+        throw std::runtime_error(filename + " is not a zap dictionary.");
+    }
+    size_t pos = DICTIONARY_MAGIC.size();
+    code_lengths = deserializeCodeLengths(contents, pos);
+    for (uint8_t length : code_lengths) {
+        if (length == 0) {
+            throw std::runtime_error(filename + " is not a zap dictionary.");
+        }
+    }
+    prepare();
+}
+
+/**
+ * name:       Dictionary
+ * purpose:    Makes a dictionary from code lengths.
+ * arguments:  lengths - a complete code with a length for every byte.
+ * returns:    n/a
+ * effects:    Throws a runtime_error if the lengths are not a valid code.
+ */
+Dictionary::Dictionary(const CodeLengths &lengths) : code_lengths(lengths) {
+    prepare();
+}
+
+/**
+ * name:       train
+ * purpose:    Trains a dictionary over sample files.
+ * arguments:  sample_files - the paths of files like the messages that 
+ *             will be coded.
+ *             max_code_length - the longest code to give any byte.
+ * returns:    The dictionary.
+ * effects:    Reads each sample file once. Throws a runtime_error if a 
+ *             file cannot be read or ++max_code_length++ is shorter than 8.
+ */
+Dictionary Dictionary::train(const std::vector<std::string> &sample_files,
+                             int max_code_length) {
+    FrequencyTable frequencies = {};
+    for (const std::string &sample : sample_files) {
+        MappedFile file(sample);
+        countBytes(file.data(), file.size(), frequencies);
+    }
+    return fromFrequencies(frequencies, max_code_length);
+}
+
+/**
+ * name:       fromFrequencies
+ * purpose:    Makes the dictionary for a set of byte frequencies.
+ * arguments:  frequencies - the number of times each byte occurs in the 
+ *             samples.
+ *             max_code_length - the longest code to give any byte, 8 to 
+ *             63.
+ * returns:    The dictionary.
+ * effects:    Every byte is counted once more than it occurs, so bytes the
+ *             samples lack still get a (long) code. Throws a runtime_error
+ *             if ++max_code_length++ is out of range.
+ */
+Dictionary Dictionary::fromFrequencies(const FrequencyTable &frequencies,
+                                       int max_code_length) {
+    FrequencyTable smoothed;
+    for (int symbol = 0; symbol < 256; symbol++) {
+        smoothed[symbol] = frequencies[symbol] + 1;
+    }
+    return Dictionary(lengthLimitedCodeLengths(smoothed, max_code_length));
+}
+
+/**
+ * name:       save
+ * purpose:    Writes the dictionary to a file.
+ * arguments:  filename - the path of the file to write.
+ * returns:    void
+ * effects:    Creates or overwrites ++filename++. Throws a runtime_error if
+ *             the file cannot be written.
+ */
+void Dictionary::save(const std::string &filename) const {
+    FileWriter out(filename);
+    out.write(DICTIONARY_MAGIC);
+    out.write(serializeCodeLengths(code_lengths));
+    out.close();
+}
+
+/**
+ * name:       id
+ * purpose:    Reports the number messages name this dictionary by.
+ * arguments:  none
+ * returns:    The dictionary's id.
+ * effects:    None.
+ */
+uint32_t Dictionary::id() const {
+    return dictionary_id;
+}
+
+/**
+ * name:       lengths
+ * purpose:    Gives access to the code length of every byte.
+ * arguments:  none
+ * returns:    The code lengths; none is 0.
+ * effects:    None.
+ */
+const CodeLengths &Dictionary::lengths() const {
+    return code_lengths;
+}
+
+/**
+ * name:       codes
+ * purpose:    Gives access to the canonical code word of every byte.
+ * arguments:  none
+ * returns:    The code table.
+ * effects:    None.
+ */
+const CodeTable &Dictionary::codes() const {
+    return code_table;
+}
+
+/**
+ * name:       table
+ * purpose:    Gives access to the lookup tables that decode the codes.
+ * arguments:  none
+ * returns:    The decode table.
+ * effects:    None.
+ */
+const HuffmanDecodeTable &Dictionary::table() const {
+    return decode_table;
+}
+
+/**
+ * name:       prepare
+ * purpose:    Builds the codes, decode table and id from code_lengths.
+ * arguments:  none
+ * returns:    void
+ * effects:    Throws a runtime_error if the lengths are not a valid code.
+ */
+void Dictionary::prepare() {
+    code_table = canonicalCodes(code_lengths);
+    decode_table.build(code_table);
+    std::string header = serializeCodeLengths(code_lengths);
+    dictionary_id = 2166136261u;
+    for (char byte : header) {
+        dictionary_id ^= static_cast<unsigned char>(byte);
+        dictionary_id *= 16777619u;
+    }
+}
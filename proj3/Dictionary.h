@@ -0,0 +1,55 @@
+/**
+ * File: Dictionary.h
+ * Description: Defines Dictionary, a code trained ahead of time over sample
+ * files by zap train and saved in a file of its own. A message zapped with
+ * a dictionary stores no code at all, only MESSAGE_MAGIC, the dictionary's
+ * id, the text length and the bits, which is what makes Huffman coding pay
+ * off on messages smaller than a code header. Every byte value gets a
+ * code, so a dictionary can code any message, not only ones like the
+ * samples. A Dictionary never changes once made, so one can be shared by
+ * any number of coders and threads.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#ifndef DICTIONARY_H
+#define DICTIONARY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "HuffmanCode.h"
+#include "HuffmanDecodeTable.h"
+
+// longest code zap train gives a byte unless --max-code-length is set
+static const int DEFAULT_DICTIONARY_CODE_LENGTH = 16;
+
+class Dictionary {
+public:
+    explicit Dictionary(const std::string &filename);
+
+    static Dictionary train(const std::vector<std::string> &sample_files,
+                            int max_code_length);
+    static Dictionary fromFrequencies(const FrequencyTable &frequencies,
+                                      int max_code_length);
+
+    void save(const std::string &filename) const;
+
+    uint32_t id() const;
+    const CodeLengths &lengths() const;
+    const CodeTable &codes() const;
+    const HuffmanDecodeTable &table() const;
+
+private:
+    explicit Dictionary(const CodeLengths &lengths);
+
+    void prepare();
+
+    CodeLengths code_lengths;
+    // built once from code_lengths, so no message pays for them
+    CodeTable code_table;
+    HuffmanDecodeTable decode_table;
+    uint32_t dictionary_id;
+};
+
+#endif
@@ -0,0 +1,772 @@
+/**
+ * File: FileIO.cpp
+ * Description: Implements MappedFile, FileReader and FileWriter with the
+ * POSIX file calls. Mapped pages are read in on demand and can be dropped by the
+ * kernel, so a multi-gigabyte input does not cost that much memory. The 
+ * read-ahead and write-behind threads use the same blocking calls, which
+ * every POSIX system has; the thread, not the call, is what lets the I/O
+ * overlap the coding.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#include "FileIO.h"
+#include "ChunkQueue.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const std::string STDIO_NAME = "-";
+
+// how often a read-ahead thread waiting on a pipe checks it is still wanted
+static const int POLL_MILLISECONDS = 100;
+
+/**
+ * name:       sameFile
+ * purpose:    Tells whether two paths name one file, so a coder can refuse
+ *             to truncate the input it is about to read.
+ * arguments:  first, second - the paths, either of which may be 
+ *             STDIO_NAME.
+ * returns:    true if both exist and have the same device and inode, 
+ *             whatever their names; false for STDIO_NAME or a path that
+ *             does not exist yet.
+ * effects:    none
+ */
+bool sameFile(const std::string &first, const std::string &second) {
+    if (first == STDIO_NAME or second == STDIO_NAME) {
+        return false;
+    }
+    struct stat first_info, second_info;
+    return ::stat(first.c_str(), &first_info) == 0 and
+           ::stat(second.c_str(), &second_info) == 0 and
+           first_info.st_dev == second_info.st_dev and
+           first_info.st_ino == second_info.st_ino;
+}
+
+/**
+ * name:       MappedFile
+ * purpose:    Opens a file and maps its contents.
+ * arguments:  filename - the path of the file to read, or STDIO_NAME 
+ *             for stdin.
+ * returns:    n/a
+ * effects:    Throws a runtime_error if the file cannot be opened or read.
+ *             Files that cannot be mapped (pipes, or a failed mmap) are
+ *             read into memory instead.
+ */
+MappedFile::MappedFile(const std::string &filename)
+    : mapping(nullptr), length(0) {
+    bool is_stdin = (filename == STDIO_NAME);
+    int fd = is_stdin ? STDIN_FILENO : ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Unable to open file " + filename);
+    }
+    struct stat info;
+    if (::fstat(fd, &info) == 0 and S_ISREG(info.st_mode)) {
+        length = static_cast<size_t>(info.st_size);
+        if (length > 0) {
+            void *pages = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE,
+                                 fd, 0);
+            if (pages != MAP_FAILED) {
+                mapping = pages;
+                // both coders go through the input front to back
+                ::madvise(mapping, length, MADV_SEQUENTIAL);
+            }
+        }
+    }
+    if (not mapping) {
+        length = 0;
+        try {
+            readAll(fd, filename);
+        } catch (...) {
+            if (not is_stdin) ::close(fd);
+            throw;
+        }
+    }
+    if (not is_stdin) {
+        ::close(fd); // the mapping stays valid after the descriptor closes
+    }
+}
+
+/**
+ * name:       ~MappedFile
+ * purpose:    Unmaps the file.
+ * arguments:  none
+ * returns:    n/a
+ * effects:    Pointers from data() are no longer valid.
+ */
+MappedFile::~MappedFile() {
+    if (mapping) {
+        ::munmap(mapping, length);
+    }
+}
+
+/**
+ * name:       data
+ * purpose:    Gives access to the file's bytes.
+ * arguments:  none
+ * returns:    A pointer to size() bytes; not null-terminated.
+ * effects:    None.
+ */
+const unsigned char *MappedFile::data() const {
+    if (mapping) {
+        return static_cast<const unsigned char *>(mapping);
+    }
+    return reinterpret_cast<const unsigned char *>(fallback.data());
+}
+
+/**
+ * name:       size
+ * purpose:    Reports the size of the file.
+ * arguments:  none
+ * returns:    The number of bytes at data().
+ * effects:    None.
+ */
+size_t MappedFile::size() const {
+    return mapping ? length : fallback.size();
+}
+
+/**
+ * name:       readAll
+ * purpose:    Reads a file that could not be mapped into fallback.
+ * arguments:  fd - the open file.
+ *             filename - the name of the file, for error messages.
+ * returns:    void
+ * effects:    Throws a runtime_error if a read fails.
+ */
+void MappedFile::readAll(int fd, const std::string &filename) {
+    char chunk[1 << 16];
+    while (true) {
+        ssize_t got = ::read(fd, chunk, sizeof(chunk));
+        if (got == 0) {
+            return;
+        }
+        if (got < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error("Unable to read file " + filename);
+        }
+        fallback.append(chunk, static_cast<size_t>(got));
+    }
+}
+
+/**
+ * name:       FileReader
+ * purpose:    Opens a file, or stdin, for reading.
+ * arguments:  filename_in - the path of the file, or STDIO_NAME for stdin.
+ * returns:    n/a
+ * effects:    Throws a runtime_error if the file cannot be opened.
+ */
+FileReader::FileReader(const std::string &filename_in)
+    : filename(filename_in), fd(STDIN_FILENO), owns_fd(false),
+      buffer_pos(0), total_read(0), memory(nullptr), memory_size(0) {
+    if (filename != STDIO_NAME) {
+        fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Unable to open file " + filename);
+        }
+        owns_fd = true;
+    }
+}
+
+/**
+ * name:       FileReader
+ * purpose:    Reads a memory buffer as if it were a file.
+ * arguments:  data - the bytes to read; must outlive the reader.
+ *             size - the number of bytes at ++data++.
+ * returns:    n/a
+ * effects:    None. Nothing is copied until read() is called.
+ */
+FileReader::FileReader(const unsigned char *data, size_t size)
+    : filename("memory buffer"), fd(-1), owns_fd(false), buffer_pos(0),
+      total_read(0), memory(data), memory_size(size) {
+    if (not memory) { // an empty buffer may have no data, but is no file
+        memory = reinterpret_cast<const unsigned char *>("");
+        memory_size = 0;
+    }
+}
+
+/**
+ * name:       ~FileReader
+ * purpose:    Closes the file.
+ * arguments:  none
+ * returns:    n/a
+ * effects:    Stops the read-ahead thread, if any. stdin is left open.
+ */
+FileReader::~FileReader() {
+    if (io_thread.joinable()) {
+        ahead->abort("");
+        io_thread.join();
+    }
+    if (owns_fd) {
+        ::close(fd);
+    }
+}
+
+/**
+ * name:       readAhead
+ * purpose:    Starts reading the file on a thread of its own, a chunk at a
+ *             time, up to PIPELINE_DEPTH chunks ahead of read().
+ * arguments:  none
+ * returns:    void
+ * effects:    Starts a thread; bytes already buffered are still read 
+ *             first. Does nothing on a memory buffer or if already reading
+ *             ahead. Errors are thrown by the read() that reaches them. 
+ *             stdin may be read past the bytes the caller ends up wanting.
+ */
+void FileReader::readAhead() {
+    if (memory or ahead) {
+        return;
+    }
+    ahead.reset(new ChunkQueue(PIPELINE_DEPTH));
+    io_thread = std::thread(&FileReader::readAheadLoop, this);
+}
+
+/**
+ * name:       read
+ * purpose:    Reads up to ++count++ bytes.
+ * arguments:  bytes - where to put the bytes.
+ *             count - how many bytes to read.
+ * returns:    The number of bytes read; less than ++count++ only at the 
+ *             end of the file.
+ * effects:    Throws a runtime_error if a read fails.
+ */
+size_t FileReader::read(char *bytes, size_t count) {
+    if (memory) { // already in memory, so no buffer is needed
+        size_t part = std::min<uint64_t>(count, memory_size - total_read);
+        std::memcpy(bytes, memory + total_read, part);
+        total_read += part;
+        return part;
+    }
+    size_t done = 0;
+    while (done < count) {
+        if (buffer_pos == buffer.size() and ahead) {
+            if (not nextChunk()) {
+                break; // the end of the file
+            }
+            continue;
+        }
+        if (buffer_pos == buffer.size()) {
+            if (count - done >= BUFFER_SIZE) {
+                // large reads skip the buffer
+                size_t got = readDirect(bytes + done, count - done);
+                done += got;
+                total_read += got;
+                if (got == 0) break;
+                continue;
+            }
+            buffer.resize(BUFFER_SIZE);
+            buffer.resize(readDirect(&buffer[0], BUFFER_SIZE));
+            buffer_pos = 0;
+            if (buffer.empty()) break;
+        }
+        size_t part = std::min(count - done, buffer.size() - buffer_pos);
+        buffer.copy(bytes + done, part, buffer_pos);
+        buffer_pos += part;
+        done += part;
+        total_read += part;
+    }
+    return done;
+}
+
+/**
+ * name:       readSome
+ * purpose:    Reads up to ++count++ bytes without waiting for more once 
+ *             some have arrived, for input that trickles in, such as a 
+ *             log piped to stdin.
+ * arguments:  bytes - where to put the bytes.
+ *             count - the most bytes to read.
+ * returns:    The number of bytes read, at least 1 unless ++count++ is 0 or
+ *             the file has ended.
+ * effects:    Waits only if nothing has been read yet. Throws a 
+ *             runtime_error if a read fails.
+ */
+size_t FileReader::readSome(char *bytes, size_t count) {
+    if (memory or count == 0) {
+        return read(bytes, count);
+    }
+    if (buffer_pos == buffer.size() and ahead) {
+        nextChunk();
+    } else if (buffer_pos == buffer.size()) {
+        // one read call, which returns whatever a pipe holds
+        buffer.resize(BUFFER_SIZE);
+        ssize_t got;
+        do {
+            got = ::read(fd, &buffer[0], BUFFER_SIZE);
+        } while (got < 0 and errno == EINTR);
+        if (got < 0) {
+            buffer.clear();
+            throw std::runtime_error("Unable to read file " + filename);
+        }
+        buffer.resize(static_cast<size_t>(got));
+        buffer_pos = 0;
+    }
+    size_t part = std::min(count, buffer.size() - buffer_pos);
+    buffer.copy(bytes, part, buffer_pos);
+    buffer_pos += part;
+    total_read += part;
+    return part;
+}
+
+/**
+ * name:       readByte
+ * purpose:    Reads one byte.
+ * arguments:  byte - set to the byte read.
+ * returns:    false at the end of the file, true otherwise.
+ * effects:    Throws a runtime_error if a read fails.
+ */
+bool FileReader::readByte(unsigned char &byte) {
+    char c;
+    if (read(&c, 1) == 0) {
+        return false;
+    }
+    byte = static_cast<unsigned char>(c);
+    return true;
+}
+
+/**
+ * name:       readRest
+ * purpose:    Reads everything up to the end of the file.
+ * arguments:  bytes - the string the bytes are appended to.
+ * returns:    void
+ * effects:    Throws a runtime_error if a read fails.
+ */
+void FileReader::readRest(std::string &bytes) {
+    char chunk[BUFFER_SIZE];
+    size_t got;
+    while ((got = read(chunk, sizeof(chunk))) > 0) {
+        bytes.append(chunk, got);
+    }
+}
+
+/**
+ * name:       readExactly
+ * purpose:    Reads a given number of bytes whose count came from the 
+ *             input itself, so may be far larger than the input.
+ * arguments:  bytes - the string the bytes replace.
+ *             count - the number of bytes wanted.
+ * returns:    true if all ++count++ bytes were read, false if the file 
+ *             ended first.
+ * effects:    Grows ++bytes++ only as the bytes arrive, at most doubling 
+ *             what has been read, so a short file claiming a huge count 
+ *             never makes it allocate more than about twice its own size. 
+ *             Throws a runtime_error if a read fails.
+ */
+bool FileReader::readExactly(std::string &bytes, uint64_t count) {
+    size_t got = 0;
+    while (got < count) {
+        uint64_t step = std::max<uint64_t>(got, AHEAD_SIZE);
+        size_t next = static_cast<size_t>(std::min<uint64_t>(count, 
+                                                             got + step));
+        bytes.resize(next);
+        size_t read_now = read(&bytes[got], next - got);
+        got += read_now;
+        if (got < next) {
+            bytes.resize(got);
+            return false;
+        }
+    }
+    bytes.resize(got);
+    return true;
+}
+
+/**
+ * name:       bytesRead
+ * purpose:    Reports how many bytes have been handed out by read().
+ * arguments:  none
+ * returns:    The number of bytes read so far.
+ * effects:    None.
+ */
+uint64_t FileReader::bytesRead() const {
+    return total_read;
+}
+
+/**
+ * name:       readDirect
+ * purpose:    Reads from the file, retrying short reads.
+ * arguments:  bytes - where to put the bytes.
+ *             count - how many bytes to read.
+ * returns:    The number of bytes read; less than ++count++ only at the 
+ *             end of the file.
+ * effects:    Throws a runtime_error if a read fails.
+ */
+size_t FileReader::readDirect(char *bytes, size_t count) {
+    size_t done = 0;
+    while (done < count) {
+        ssize_t got = ::read(fd, bytes + done, count - done);
+        if (got == 0) break;
+        if (got < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error("Unable to read file " + filename);
+        }
+        done += static_cast<size_t>(got);
+    }
+    return done;
+}
+
+/**
+ * name:       nextChunk
+ * purpose:    Replaces the buffer with the next chunk read ahead.
+ * arguments:  none
+ * returns:    false at the end of the file, true otherwise.
+ * effects:    Waits for the read-ahead thread. Leaves the buffer empty at
+ *             the end. Throws a runtime_error if the thread failed.
+ */
+bool FileReader::nextChunk() {
+    buffer_pos = 0;
+    if (ahead->pop(buffer)) {
+        return true;
+    }
+    buffer.clear();
+    std::string error = ahead->error();
+    if (not error.empty()) {
+        throw std::runtime_error(error);
+    }
+    return false;
+}
+
+/**
+ * name:       readAheadLoop
+ * purpose:    Runs the read-ahead thread.
+ * arguments:  none
+ * returns:    void
+ * effects:    Reads the file into chunks and queues them until the end of
+ *             the file, an error, or the reader giving up. A pipe is only
+ *             read once it has bytes, so a reader destroyed early is not
+ *             held up by a writer that never comes.
+ */
+void FileReader::readAheadLoop() {
+    std::string chunk;
+    try {
+        while (true) {
+            struct pollfd input = {fd, POLLIN, 0};
+            int result = ::poll(&input, 1, POLL_MILLISECONDS);
+            if (ahead->stopped()) {
+                return;
+            }
+            if (result == 0 or (result < 0 and errno == EINTR)) {
+                continue; // a poll that fails otherwise leaves it to read
+            }
+            chunk.resize(AHEAD_SIZE);
+            ssize_t got = ::read(fd, &chunk[0], AHEAD_SIZE);
+            if (got < 0) {
+                if (errno == EINTR) continue;
+                throw std::runtime_error("Unable to read file " + filename);
+            }
+            chunk.resize(static_cast<size_t>(got));
+            if (got == 0) {
+                ahead->close();
+                return;
+            }
+            if (not ahead->push(chunk)) {
+                return;
+            }
+        }
+    } catch (const std::runtime_error &error) {
+        ahead->abort(error.what());
+    }
+}
+
+/**
+ * name:       FileWriter
+ * purpose:    Creates or truncates a file for writing.
+ * arguments:  filename_in - the path of the file to write, or STDIO_NAME 
+ *             for stdout.
+ * returns:    n/a
+ * effects:    Throws a runtime_error if the file cannot be opened.
+ */
+FileWriter::FileWriter(const std::string &filename_in)
+    : filename(filename_in), fd(STDOUT_FILENO), owns_fd(false),
+      memory(nullptr), total_written(0), position(0), window_start(0), 
+      window_end(UINT64_MAX) {
+    if (filename != STDIO_NAME) {
+        fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("Unable to open file " + filename);
+        }
+        owns_fd = true;
+    }
+    buffer.reserve(CHUNK_SIZE);
+}
+
+/**
+ * name:       FileWriter
+ * purpose:    Writes to the end of a memory buffer instead of a file.
+ * arguments:  memory_in - the buffer output is appended to; must outlive
+ *             the writer.
+ * returns:    n/a
+ * effects:    None. Output goes straight into ++memory_in++ without being
+ *             buffered, so the writer allocates nothing of its own.
+ */
+FileWriter::FileWriter(std::vector<unsigned char> &memory_in)
+    : filename("memory buffer"), fd(-1), owns_fd(false), 
+      memory(&memory_in), total_written(0), position(0), window_start(0),
+      window_end(UINT64_MAX) {}
+
+/**
+ * name:       ~FileWriter
+ * purpose:    Closes the file if close() was not called.
+ * arguments:  none
+ * returns:    n/a
+ * effects:    Output still buffered is discarded; callers that finish
+ *             normally call close(), so this only happens while an
+ *             exception is unwinding; chunks the write-behind thread has
+ *             not reached are discarded too. stdout is left open.
+ */
+FileWriter::~FileWriter() {
+    if (io_thread.joinable()) {
+        behind->abort("");
+        io_thread.join();
+    }
+    if (owns_fd and fd >= 0) {
+        ::close(fd);
+    }
+}
+
+/**
+ * name:       writeBehind
+ * purpose:    Starts writing the file on a thread of its own, so full 
+ *             chunks are written while the caller goes on; up to 
+ *             PIPELINE_DEPTH of them wait to be written.
+ * arguments:  none
+ * returns:    void
+ * effects:    Starts a thread. Does nothing on a memory buffer or if 
+ *             already writing behind. An error writing a chunk is thrown
+ *             by a later write() or by close().
+ */
+void FileWriter::writeBehind() {
+    if (memory or behind) {
+        return;
+    }
+    behind.reset(new ChunkQueue(PIPELINE_DEPTH));
+    io_thread = std::thread(&FileWriter::writeBehindLoop, this);
+}
+
+/**
+ * name:       write
+ * purpose:    Appends bytes to the file.
+ * arguments:  bytes - the bytes to write.
+ *             count - the number of bytes.
+ * returns:    void
+ * effects:    Buffers small writes; writes of a chunk or more go straight
+ *             to the file. Bytes outside the window are dropped. Throws a
+ *             runtime_error if writing fails.
+ */
+void FileWriter::write(const char *bytes, size_t count) {
+    uint64_t kept = count;
+    bytes += clip(kept);
+    if (kept == 0) {
+        return;
+    }
+    count = static_cast<size_t>(kept);
+    total_written += count;
+    if (memory) {
+        writeDirect(bytes, count);
+        return;
+    }
+    if (buffer.size() + count <= CHUNK_SIZE) {
+        buffer.append(bytes, count);
+        return;
+    }
+    flush();
+    if (count >= CHUNK_SIZE and not behind) {
+        writeDirect(bytes, count);
+        return;
+    }
+    // the write-behind thread takes everything a chunk at a time
+    while (count > CHUNK_SIZE) {
+        buffer.append(bytes, CHUNK_SIZE);
+        flush();
+        bytes += CHUNK_SIZE;
+        count -= CHUNK_SIZE;
+    }
+    buffer.append(bytes, count);
+}
+
+/**
+ * name:       write
+ * purpose:    Appends a string's bytes to the file.
+ * arguments:  bytes - the bytes to write.
+ * returns:    void
+ * effects:    As write(const char *, size_t).
+ */
+void FileWriter::write(const std::string &bytes) {
+    write(bytes.data(), bytes.size());
+}
+
+/**
+ * name:       writeRepeated
+ * purpose:    Appends one byte value many times.
+ * arguments:  byte - the byte to write.
+ *             count - how many copies to write.
+ * returns:    void
+ * effects:    Uses at most one chunk of memory however large ++count++ is.
+ *             Copies outside the window are dropped. Throws a 
+ *             runtime_error if writing fails.
+ */
+void FileWriter::writeRepeated(char byte, uint64_t count) {
+    clip(count);
+    total_written += count;
+    if (memory) {
+        memory->insert(memory->end(), count, 
+                       static_cast<unsigned char>(byte));
+        return;
+    }
+    while (count > 0) {
+        if (buffer.size() == CHUNK_SIZE) {
+            flush();
+        }
+        size_t room = CHUNK_SIZE - buffer.size();
+        size_t part = count < room ? static_cast<size_t>(count) : room;
+        buffer.append(part, byte);
+        count -= part;
+    }
+}
+
+/**
+ * name:       close
+ * purpose:    Writes any buffered output and closes the file.
+ * arguments:  none
+ * returns:    void
+ * effects:    Waits for the write-behind thread, if any, to write every
+ *             chunk. Throws a runtime_error if writing or closing fails.
+ */
+void FileWriter::close() {
+    flush();
+    if (behind) {
+        behind->close();
+        io_thread.join();
+        std::string error = behind->error();
+        behind.reset();
+        if (not error.empty()) {
+            throw std::runtime_error(error);
+        }
+    }
+    if (not owns_fd) {
+        return; // stdout stays open for the rest of the program
+    }
+    int result = ::close(fd);
+    fd = -1;
+    if (result != 0) {
+        throw std::runtime_error("Unable to write file " + filename);
+    }
+}
+
+/**
+ * name:       bytesWritten
+ * purpose:    Reports how much output the writer has kept.
+ * arguments:  none
+ * returns:    The number of bytes written so far, buffered or not, not
+ *             counting any dropped outside the window.
+ * effects:    None.
+ */
+uint64_t FileWriter::bytesWritten() const {
+    return total_written;
+}
+
+/**
+ * name:       setWindow
+ * purpose:    Keeps only part of the output, for decoding a byte range.
+ * arguments:  start - the offset, counted in bytes handed to the writer
+ *             from this call on, of the first byte to keep.
+ *             length - how many bytes to keep.
+ * returns:    void
+ * effects:    Bytes before ++start++ and after the last byte kept are
+ *             dropped.
+ */
+void FileWriter::setWindow(uint64_t start, uint64_t length) {
+    window_start = (start > UINT64_MAX - position) ? UINT64_MAX 
+                                                   : position + start;
+    window_end = (length > UINT64_MAX - window_start) ? UINT64_MAX 
+                                                      : window_start + length;
+}
+
+/**
+ * name:       clip
+ * purpose:    Cuts a write down to the part inside the window.
+ * arguments:  count - the number of bytes being written; set to the
+ *             number kept, 0 if none are.
+ * returns:    How many of the bytes come before the first one kept.
+ * effects:    Moves position past every byte.
+ */
+uint64_t FileWriter::clip(uint64_t &count) {
+    uint64_t start = position;
+    uint64_t end = (count > UINT64_MAX - start) ? UINT64_MAX : start + count;
+    position = end;
+    uint64_t from = std::max(start, window_start);
+    uint64_t to = std::min(end, window_end);
+    count = (from < to) ? to - from : 0;
+    return (from < to) ? from - start : 0;
+}
+
+/**
+ * name:       flush
+ * purpose:    Writes the buffered output to the file, for output someone
+ *             is waiting on before the buffer would fill.
+ * arguments:  none
+ * returns:    void
+ * effects:    Empties the buffer, or hands it to the write-behind thread.
+ *             Throws a runtime_error if writing fails.
+ */
+void FileWriter::flush() {
+    if (behind) {
+        if (buffer.empty()) {
+            return;
+        }
+        if (not behind->push(buffer)) {
+            throw std::runtime_error(behind->error());
+        }
+        // a fresh chunk until the thread hands back the ones it wrote
+        buffer.reserve(CHUNK_SIZE);
+        return;
+    }
+    writeDirect(buffer.data(), buffer.size());
+    buffer.clear();
+}
+
+/**
+ * name:       writeDirect
+ * purpose:    Writes bytes to the file, retrying short writes.
+ * arguments:  bytes - the bytes to write.
+ *             count - the number of bytes.
+ * returns:    void
+ * effects:    Throws a runtime_error if writing fails.
+ */
+void FileWriter::writeDirect(const char *bytes, size_t count) {
+    if (memory) {
+        memory->insert(memory->end(), bytes, bytes + count);
+        return;
+    }
+    while (count > 0) {
+        ssize_t wrote = ::write(fd, bytes, count);
+        if (wrote < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error("Unable to write file " + filename);
+        }
+        bytes += wrote;
+        count -= static_cast<size_t>(wrote);
+    }
+}
+
+/**
+ * name:       writeBehindLoop
+ * purpose:    Runs the write-behind thread.
+ * arguments:  none
+ * returns:    void
+ * effects:    Writes each queued chunk to the file until the queue is
+ *             closed and empty, the writer gives up, or a write fails.
+ */
+void FileWriter::writeBehindLoop() {
+    std::string chunk;
+    try {
+        while (behind->pop(chunk)) {
+            writeDirect(chunk.data(), chunk.size());
+        }
+    } catch (const std::runtime_error &error) {
+        behind->abort(error.what());
+    }
+}
@@ -0,0 +1,150 @@
+/**
+ * File: FileIO.h
+ * Description: Defines MappedFile, which maps an input file read-only so
+ * zap and unzap can work on its bytes without copying them, FileReader,
+ * which reads a file or stdin a piece at a time, and FileWriter, which
+ * sends output to a file or stdout in large chunks so results never have
+ * to be held in memory whole. A FileReader or FileWriter can also be 
+ * opened on a memory buffer, which lets the coders run on buffers through
+ * the same code paths they use for files. A reader can read ahead, and a
+ * writer write behind, on a thread of their own (see ChunkQueue.h), so
+ * the coder never waits on the disk while there is work to do.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#ifndef FILEIO_H
+#define FILEIO_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+class ChunkQueue;
+
+/* The file name that stands for stdin or stdout. */
+extern const std::string STDIO_NAME;
+
+bool sameFile(const std::string &first, const std::string &second);
+
+// chunks that may wait between a coder and the thread doing its I/O,
+// besides the one each of them holds
+static const size_t PIPELINE_DEPTH = 2;
+
+class MappedFile {
+public:
+    explicit MappedFile(const std::string &filename);
+    ~MappedFile();
+
+    const unsigned char *data() const;
+    size_t size() const;
+
+private:
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    void readAll(int fd, const std::string &filename);
+
+    // the mapping, or nullptr when the bytes are in fallback instead
+    void *mapping;
+    size_t length;
+    // holds the bytes of files that cannot be mapped, such as pipes
+    std::string fallback;
+};
+
+class FileReader {
+public:
+    static const size_t BUFFER_SIZE = 1 << 16;
+    // the most a read-ahead thread reads at once
+    static const size_t AHEAD_SIZE = 1 << 20;
+
+    explicit FileReader(const std::string &filename);
+    FileReader(const unsigned char *data, size_t size);
+    ~FileReader();
+
+    void readAhead();
+
+    size_t read(char *bytes, size_t count);
+    size_t readSome(char *bytes, size_t count);
+    bool readByte(unsigned char &byte);
+    void readRest(std::string &bytes);
+    bool readExactly(std::string &bytes, uint64_t count);
+
+    uint64_t bytesRead() const;
+
+private:
+    FileReader(const FileReader &) = delete;
+    FileReader &operator=(const FileReader &) = delete;
+
+    size_t readDirect(char *bytes, size_t count);
+    bool nextChunk();
+    void readAheadLoop();
+
+    std::string filename;
+    int fd;
+    bool owns_fd;
+    // bytes read from the file but not yet handed out, from buffer_pos on
+    std::string buffer;
+    size_t buffer_pos;
+    uint64_t total_read;
+    // the buffer being read when there is no file, or nullptr
+    const unsigned char *memory;
+    size_t memory_size;
+    // the chunks read ahead and the thread reading them, once readAhead()
+    // is called
+    std::unique_ptr<ChunkQueue> ahead;
+    std::thread io_thread;
+};
+
+class FileWriter {
+public:
+    static const size_t CHUNK_SIZE = 1 << 20;
+
+    explicit FileWriter(const std::string &filename);
+    explicit FileWriter(std::vector<unsigned char> &memory);
+    ~FileWriter();
+
+    void writeBehind();
+
+    void write(const char *bytes, size_t count);
+    void write(const std::string &bytes);
+    void writeRepeated(char byte, uint64_t count);
+    void flush();
+    void close();
+
+    uint64_t bytesWritten() const;
+
+    void setWindow(uint64_t start, uint64_t length);
+
+private:
+    FileWriter(const FileWriter &) = delete;
+    FileWriter &operator=(const FileWriter &) = delete;
+
+    void writeDirect(const char *bytes, size_t count);
+    uint64_t clip(uint64_t &count);
+    void writeBehindLoop();
+
+    std::string filename;
+    int fd;
+    bool owns_fd;
+    // output waiting to be written, never more than CHUNK_SIZE bytes
+    std::string buffer;
+    // the buffer output is appended to when there is no file, or nullptr
+    std::vector<unsigned char> *memory;
+    // bytes that have reached the output, and bytes handed to write() and
+    // writeRepeated(), which differ only outside the window
+    uint64_t total_written;
+    uint64_t position;
+    // the positions of the part of the output kept; see setWindow
+    uint64_t window_start;
+    uint64_t window_end;
+    // the chunks waiting to be written and the thread writing them, once
+    // writeBehind() is called
+    std::unique_ptr<ChunkQueue> behind;
+    std::thread io_thread;
+};
+
+#endif
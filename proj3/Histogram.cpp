@@ -0,0 +1,242 @@
+/**
+ * File: Histogram.cpp
+ * Description: Implements the byte histogram kernels. Counts go to four
+ * 32-bit tables, flushed into the 64-bit FrequencyTable after each chunk,
+ * so consecutive equal bytes update different counters and the tables
+ * stay small enough for L1 cache.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#include "Histogram.h"
+#include <cstdint>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define ZAP_HISTOGRAM_AVX2 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define ZAP_HISTOGRAM_NEON 1
+#endif
+
+static const int TABLES = 4;
+// small enough that no 32-bit counter can overflow within one chunk
+static const size_t CHUNK_SIZE = size_t(1) << 30;
+
+typedef uint32_t CountTables[TABLES][256];
+
+/**
+ * name:       countWords
+ * purpose:    Counts bytes eight at a time, spreading them over the tables.
+ * arguments:  data - the bytes to count.
+ *             size - the number of bytes.
+ *             tables - the interleaved count tables to add to.
+ * returns:    void
+ * effects:    Modifies ++tables++.
+ */
+static void countWords(const unsigned char *data, size_t size,
+                       CountTables tables) {
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, 8);
+        tables[0][word & 0xff]++;
+        tables[1][(word >> 8) & 0xff]++;
+        tables[2][(word >> 16) & 0xff]++;
+        tables[3][(word >> 24) & 0xff]++;
+        tables[0][(word >> 32) & 0xff]++;
+        tables[1][(word >> 40) & 0xff]++;
+        tables[2][(word >> 48) & 0xff]++;
+        tables[3][word >> 56]++;
+    }
+    for (; i < size; i++) {
+        tables[i % TABLES][data[i]]++;
+    }
+}
+
+#if ZAP_HISTOGRAM_AVX2
+/**
+ * name:       countBlocksSimd
+ * purpose:    Counts bytes 32 at a time with AVX2. A block that is one
+ *             byte repeated is counted with a single add.
+ * arguments:  data - the bytes to count.
+ *             size - the number of bytes.
+ *             tables - the interleaved count tables to add to.
+ * returns:    void
+ * effects:    Modifies ++tables++. Must only run on CPUs with AVX2.
+ */
+__attribute__((target("avx2")))
+static void countBlocksSimd(const unsigned char *data, size_t size,
+                            CountTables tables) {
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i block = _mm256_loadu_si256(
+                            reinterpret_cast<const __m256i *>(data + i));
+        __m256i first = _mm256_set1_epi8(static_cast<char>(data[i]));
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, first)) == -1) {
+            tables[0][data[i]] += 32;
+        } else {
+            countWords(data + i, 32, tables);
+        }
+    }
+    countWords(data + i, size - i, tables);
+}
+#elif ZAP_HISTOGRAM_NEON
+/**
+ * name:       countBlocksSimd
+ * purpose:    Counts bytes 16 at a time with NEON. A block that is one
+ *             byte repeated is counted with a single add.
+ * arguments:  data - the bytes to count.
+ *             size - the number of bytes.
+ *             tables - the interleaved count tables to add to.
+ * returns:    void
+ * effects:    Modifies ++tables++.
+ */
+static void countBlocksSimd(const unsigned char *data, size_t size,
+                            CountTables tables) {
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        uint8x16_t block = vld1q_u8(data + i);
+        uint8x16_t same = vceqq_u8(block, vdupq_n_u8(data[i]));
+        if (vminvq_u8(same) == 0xff) {
+            tables[0][data[i]] += 16;
+        } else {
+            countWords(data + i, 16, tables);
+        }
+    }
+    countWords(data + i, size - i, tables);
+}
+#endif
+
+/**
+ * name:       haveSimd
+ * purpose:    Checks whether the running CPU supports the SIMD kernel.
+ * arguments:  none
+ * returns:    true if countBlocksSimd may be used.
+ * effects:    None. The CPU is only queried once.
+ */
+static bool haveSimd() {
+#if ZAP_HISTOGRAM_AVX2
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+#elif ZAP_HISTOGRAM_NEON
+    return true; // NEON is part of every AArch64 CPU
+#else
+    return false;
+#endif
+}
+
+/**
+ * name:       mergeTables
+ * purpose:    Adds the interleaved tables into a frequency table.
+ * arguments:  tables - the interleaved count tables.
+ *             counts - the frequency table to add to.
+ * returns:    void
+ * effects:    Modifies ++counts++.
+ */
+static void mergeTables(CountTables tables, FrequencyTable &counts) {
+    for (int symbol = 0; symbol < 256; symbol++) {
+        uint64_t total = 0;
+        for (int t = 0; t < TABLES; t++) {
+            total += tables[t][symbol];
+        }
+        counts[symbol] += total;
+    }
+}
+
+/**
+ * name:       countChunks
+ * purpose:    Runs a kernel chunk by chunk and merges its counts.
+ * arguments:  data - the bytes to count.
+ *             size - the number of bytes.
+ *             counts - the frequency table to add to.
+ *             simd - whether to use the SIMD kernel.
+ * returns:    void
+ * effects:    Modifies ++counts++.
+ */
+static void countChunks(const unsigned char *data, size_t size,
+                        FrequencyTable &counts, bool simd) {
+    while (size > 0) {
+        size_t chunk = size < CHUNK_SIZE ? size : CHUNK_SIZE;
+        CountTables tables = {};
+#if ZAP_HISTOGRAM_AVX2 || ZAP_HISTOGRAM_NEON
+        if (simd) {
+            countBlocksSimd(data, chunk, tables);
+        } else {
+            countWords(data, chunk, tables);
+        }
+#else
+        (void)simd;
+        countWords(data, chunk, tables);
+#endif
+        mergeTables(tables, counts);
+        data += chunk;
+        size -= chunk;
+    }
+}
+
+/**
+ * name:       countBytes
+ * purpose:    Counts how many times each byte value occurs, using the
+ *             fastest kernel the CPU supports.
+ * arguments:  data - the bytes to count.
+ *             size - the number of bytes.
+ *             counts - the frequency table to add to.
+ * returns:    void
+ * effects:    Adds to ++counts++; it is not cleared first.
+ */
+void countBytes(const unsigned char *data, size_t size,
+                FrequencyTable &counts) {
+    countChunks(data, size, counts, haveSimd());
+}
+
+/**
+ * name:       countBytesScalar
+ * purpose:    Counts how many times each byte value occurs without SIMD,
+ *             for comparison with countBytes.
+ * arguments:  data - the bytes to count.
+ *             size - the number of bytes.
+ *             counts - the frequency table to add to.
+ * returns:    void
+ * effects:    Adds to ++counts++; it is not cleared first.
+ */
+void countBytesScalar(const unsigned char *data, size_t size,
+                      FrequencyTable &counts) {
+    countChunks(data, size, counts, false);
+}
+
+/**
+ * name:       histogramKernel
+ * purpose:    Names the kernel countBytes uses on this CPU.
+ * arguments:  none
+ * returns:    "avx2", "neon", or "scalar".
+ * effects:    None.
+ */
+const char *histogramKernel() {
+    if (not haveSimd()) {
+        return "scalar";
+    }
+#if ZAP_HISTOGRAM_AVX2
+    return "avx2";
+#else
+    return "neon";
+#endif
+}
+
+/**
+ * name:       distinctBytes
+ * purpose:    Counts the byte values that occur in a histogram.
+ * arguments:  counts - the frequency of each byte value.
+ * returns:    The number of entries of ++counts++ that are not 0.
+ * effects:    None.
+ */
+int distinctBytes(const FrequencyTable &counts) {
+    int distinct = 0;
+    for (uint64_t count : counts) {
+        if (count > 0) {
+            distinct++;
+        }
+    }
+    return distinct;
+}
@@ -0,0 +1,29 @@
+/**
+ * File: Histogram.h
+ * Description: Declares the byte histogram kernels used to count character
+ * frequencies. The scalar kernel spreads its counts over several
+ * interleaved tables so repeated bytes do not stall on a store followed by
+ * a load of the same counter; the SIMD kernel (AVX2 on x86, NEON on ARM)
+ * additionally counts a whole vector of one repeated byte in one step.
+ * The best kernel for the running CPU is picked at runtime.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <cstddef>
+#include "HuffmanCode.h"
+
+void countBytes(const unsigned char *data, size_t size, 
+                FrequencyTable &counts);
+
+void countBytesScalar(const unsigned char *data, size_t size, 
+                      FrequencyTable &counts);
+
+const char *histogramKernel();
+
+int distinctBytes(const FrequencyTable &counts);
+
+#endif
@@ -0,0 +1,33 @@
+/**
+ * File: HuffmanCode.h
+ * Description: Defines HuffmanCode, a single code word stored as packed
+ * bits, CodeTable, the 256-entry array of code words indexed by byte
+ * value that the table-driven coding paths are built from, and
+ * CodeLengths, the code length of each byte, which is all a canonical
+ * code needs, and FrequencyTable, the number of times each byte occurs.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#ifndef HUFFMANCODE_H
+#define HUFFMANCODE_H
+
+#include <array>
+#include <cstdint>
+
+/* A code word: the low ++length++ bits of ++bits++, most significant bit
+ * first. A length of 0 means the byte does not occur. */
+struct HuffmanCode {
+    uint64_t bits;
+    int length;
+};
+
+typedef std::array<HuffmanCode, 256> CodeTable;
+
+/* The code length of each byte value; 0 means the byte does not occur. */
+typedef std::array<uint8_t, 256> CodeLengths;
+
+/* The number of times each byte value occurs. */
+typedef std::array<uint64_t, 256> FrequencyTable;
+
+#endif
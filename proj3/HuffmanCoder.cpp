@@ -7,12 +7,84 @@
  */
 
 #include "HuffmanCoder.h"
-#include "BinaryIO.h"
-#include <fstream>
-#include <queue>
+#include "PackedBinaryIO.h"
+#include "HuffmanDecodeTable.h"
+#include "CanonicalCode.h"
+#include "ZapFormat.h"
+#include "LengthLimit.h"
+#include "Histogram.h"
+#include "FileIO.h"
+#include "BlockFormat.h"
+#include "ThreadPool.h"
+#include "Dictionary.h"
+#include "BlockSplit.h"
+#include "ContextModel.h"
+#include "AdaptiveModel.h"
+#include "Checksum.h"
+#include <algorithm>
+#include <array>
+#include <climits>
 #include <stdexcept>
-#include <sstream>
 #include <iostream> 
+#include <utility>
+
+// longest input piece encoded between writes to the output file
+static const size_t ENCODE_CHUNK_SIZE = 1 << 20;
+// every zapped-file header is shorter than this (a canonical header is at
+// most 527 bytes), so decoder copies no more than this out of the mapping
+static const size_t MAX_HEADER_SIZE = 1024;
+// deepest a serialized tree may nest internal nodes, so no leaf is deeper
+// than the 64-bit codes the decode tables hold
+static const int MAX_TREE_DEPTH = 64;
+
+/**
+ * name:       HuffmanCoder
+ * purpose:    Constructs a HuffmanCoder with the default options, which
+ *             write the original "ZAP" layout.
+ * arguments:  none
+ * returns:    n/a
+ * effects:    None.
+ */
+HuffmanCoder::HuffmanCoder() : bytes_read(0), messages(&std::cout) {}
+
+/**
+ * name:       HuffmanCoder
+ * purpose:    Constructs a HuffmanCoder with the given options.
+ * arguments:  options_in - the settings encoder uses.
+ * returns:    n/a
+ * effects:    None.
+ */
+HuffmanCoder::HuffmanCoder(const CoderOptions& options_in)
+    : options(options_in), bytes_read(0),
+      messages(options_in.messages_to_stderr ? &std::cerr : &std::cout) {}
+
+/**
+ * name:       bytesRead
+ * purpose:    Reports how many bytes of input this coder has read.
+ * arguments:  none
+ * returns:    The total size of every file read by encoder and decoder 
+ *             since the coder was constructed. After one encoder or 
+ *             decoder call it equals the input file size, since each 
+ *             input is read exactly once.
+ * effects:    None.
+ */
+uint64_t HuffmanCoder::bytesRead() const {
+    return bytes_read;
+}
+
+/**
+ * name:       statistics
+ * purpose:    Reports where the last call spent its time, and how well
+ *             its codes did.
+ * arguments:  none
+ * returns:    The stage times and counters of the last encoder, decoder,
+ *             compress or decompress call. Code lengths and entropy are
+ *             only counted while zapping.
+ * effects:    None.
+ */
+const CoderStats& HuffmanCoder::statistics() const {
+    return stats;
+}
 
 /**
  * name:       encoder
@@ -33,37 +105,125 @@
  * serialized Huffman 
  *             tree followed by the encoded content. Prints a message to 
  * stdout on success 
- *             or if the input file is empty.
+ *             or if the input file is empty. Throws a runtime_error if 
+ *             ++output_file++ is the input file.
  */
 void HuffmanCoder::encoder(const std::string& input_file, 
                             const std::string& output_file) {
-        // Read input file contents
-        std::string input_text = readFileContents(input_file);
+        // keep stdout clean when it carries the zapped data or a report
+        messages = (output_file == STDIO_NAME or options.messages_to_stderr)
+                        ? &std::cerr : &std::cout;
+        // the output is truncated before the input has been read
+        if (sameFile(input_file, output_file)) {
+            throw std::runtime_error("Cannot zap " + input_file + 
+                                     " onto itself.");
+        }
+        stats = CoderStats();
+        StageTimer total(stats.total_seconds);
+        if (options.dictionary) {
+            // messages are small, so the whole input is read at once
+            StageTimer read(stats, READ_STAGE);
+            MappedFile input(input_file);
+            read.stop();
+            bytes_read += input.size();
+            stats.input_bytes = input.size();
+            FileWriter output(output_file);
+            uint64_t num_bits = encodeMessage(input.data(), input.size(), 
+                                              output);
+            output.close();
+            stats.output_bytes = output.bytesWritten();
+            *messages << "Success! Encoded given text using " << num_bits
+                                                    << " bits." << std::endl;
+            return;
+        }
+        // stdin can only be read once, front to back, and only blocks can
+        // be coded in parallel or split, so all go through the block stream
+        // unless the adaptive stream is asked for
+        if (options.block_size > 0 or options.interleave or 
+                    options.split_blocks or options.context_model or 
+                    not options.transforms.empty() or 
+                    options.adaptive_interval > 0 or
+                    input_file == STDIO_NAME or workerThreads() > 0) {
+            FileReader input(input_file);
+            FileWriter output(output_file);
+            startFileThreads(&input, output);
+            uint64_t num_bits = (options.adaptive_interval > 0) 
+                                    ? encodeAdaptive(input, output)
+                                    : encodeStream(input, output);
+            output.close();
+            bytes_read += input.bytesRead();
+            stats.input_bytes = input.bytesRead();
+            stats.output_bytes = output.bytesWritten();
+            *messages << "Success! Encoded given text using " << num_bits
+                                                    << " bits." << std::endl;
+            return;
+        }
+        // map the input once; counting and encoding both read it in place
+        StageTimer read(stats, READ_STAGE);
+        MappedFile input(input_file);
+        read.stop();
+        bytes_read += input.size(); // lets callers confirm a single pass
+        stats.input_bytes = input.size();
         // Check if the input file is empty
-        if (input_text.empty()) {
-            std::cout << input_file << " is empty and cannot be compressed." 
+        if (input.size() == 0) {
+            *messages << input_file << " is empty and cannot be compressed." 
                                                                 << std::endl;
             return;
         }
-        // Count character frequencies
-        std::unordered_map<char, int> char_frequencies = 
-                                countCharFrequencies(input_file);
+        // Count character frequencies from the mapped text
+        StageTimer histogram(stats, HISTOGRAM_STAGE);
+        FrequencyTable char_frequencies = 
+                        countCharFrequencies(input.data(), input.size());
+        histogram.stop();
+        if (distinctBytes(char_frequencies) == 1) {
+            // a single run codes in a few bytes as a RUN_BLOCK
+            encodeMappedStream(input, output_file);
+            return;
+        }
         // Build Huffman tree
-        HuffmanTreeNode* root = buildHuffmanTree(char_frequencies);
-        // Generate character codes
-        std::unordered_map<char, std::string> char_codes;
-        generateCharCodes(root, char_codes);
-        // Encode text
-        std::string encoded_text = encodeText(input_text, char_codes);
-        // Serialize Huffman tree
-        std::string serialized_tree = serializeHuffmanTree(root);
-        // Write to file
-        BinaryIO binary_io;
-        binary_io.writeFile(output_file, serialized_tree, encoded_text);
-        // Clean up
-        deleteHuffmanTree(root);
-        std::cout << "Success! Encoded given text using " 
-                                                    << encoded_text.size() 
+        StageTimer build(stats, BUILD_STAGE);
+        TreeArena arena;
+        HuffmanTreeNode* root = buildHuffmanTree(char_frequencies, arena);
+        if (options.max_code_length > 0) {
+            root = limitCodeLengths(root, char_frequencies, arena);
+        }
+        // the exact bit count is known up front, so the header can be 
+        // written first and the bits streamed out behind it
+        CodeLengths lengths = codeLengthsFromTree(root);
+        uint64_t expected_bits = encodedBitCount(char_frequencies, lengths);
+        build.stop();
+        StageTimer codegen(stats, CODEGEN_STAGE);
+        CodeTable char_codes = {};
+        std::string header;
+        if (options.canonical) {
+            // only the code lengths are stored, not the tree
+            char_codes = canonicalCodes(lengths);
+            header = canonicalHeader(lengths, input.size());
+        } else {
+            // Generate character codes
+            generateCharCodes(root, char_codes);
+            // Serialize Huffman tree
+            PackedBinaryIO binary_io;
+            header = binary_io.fileHeader(serializeHuffmanTree(root), 
+                                          expected_bits, output_file);
+        }
+        codegen.stop();
+        if (header.size() + (expected_bits + 7) / 8 >= input.size()) {
+            // the code would not shrink the text, so store it raw
+            encodeMappedStream(input, output_file);
+            return;
+        }
+        FileWriter output(output_file);
+        startFileThreads(nullptr, output);
+        uint64_t num_bits = encodeToFile(input.data(), input.size(), 
+                                         char_codes, header, output);
+        output.close();
+        if (num_bits != expected_bits) {
+            throw std::runtime_error("Encoded bit count does not match.");
+        }
+        stats.output_bytes = output.bytesWritten();
+        stats.countBlock(char_frequencies, num_bits, maxCodeLength(lengths));
+        *messages << "Success! Encoded given text using " << num_bits
                                                     << " bits." << std::endl;
 }
 
@@ -85,162 +245,493 @@ void HuffmanCoder::encoder(const std::string& input_file,
  * decodes the 
  *             data, and writes the decoded text to an output file. 
  * Modifies the output 
- *             file and reads from the input file.
+ *             file and reads from the input file. Throws a runtime_error
+ *             if ++output_file++ is the input file.
  */
 void HuffmanCoder::decoder(const std::string& input_file, 
                             const std::string& output_file) {
-    BinaryIO binary_io;
-    std::pair<std::string, std::string> file_data = 
-                                        binary_io.readFile(input_file);
-    std::string serialized_tree = file_data.first;
-    std::string encoded_text = file_data.second;
-    HuffmanTreeNode* root = deserializeHuffmanTree(serialized_tree);
-    std::string decoded_text;
-    if (root->isLeaf()) {
-        bool allZeros = true;
-        // instead of breaking, use allZeros flag to exit the loop early
-        int length = encoded_text.length();
-        for (int i = 0; i < length and allZeros; i++) {
-            if (encoded_text[i] != '0') {
-                allZeros = false;
-            }
-        }
-        if (allZeros) {
-            decoded_text = std::string(encoded_text.size(), root->get_val());
-        } else {
-            decoded_text = decodeText(encoded_text, root);
-        }
+    // the magic number tells the layouts apart; block streams are decoded
+    // as they are read, the other layouts need the whole file
+    if (sameFile(input_file, output_file)) {
+        throw std::runtime_error("Cannot unzap " + input_file + 
+                                 " onto itself.");
+    }
+    stats = CoderStats();
+    StageTimer total(stats.total_seconds);
+    StageTimer read(stats, READ_STAGE);
+    FileReader input(input_file);
+    std::string magic(BLOCK_MAGIC.size(), '\0');
+    magic.resize(input.read(&magic[0], magic.size()));
+    read.stop();
+    FileWriter output(output_file);
+    bool stream = (magic == BLOCK_MAGIC or magic == TRANSFORM_MAGIC or
+                   magic == ADAPTIVE_MAGIC);
+    // only a stream goes on through the reader; the rest are mapped
+    startFileThreads(stream ? &input : nullptr, output);
+    if (magic == ADAPTIVE_MAGIC) {
+        decodeAdaptive(input, output);
+        bytes_read += input.bytesRead();
+        stats.input_bytes = input.bytesRead();
+    } else if (stream) {
+        decodeStream(input, output, magic == TRANSFORM_MAGIC);
+        bytes_read += input.bytesRead();
+        stats.input_bytes = input.bytesRead();
+    } else if (input_file == STDIO_NAME) {
+        std::string zapped = magic;
+        StageTimer read_rest(stats, READ_STAGE);
+        input.readRest(zapped);
+        read_rest.stop();
+        bytes_read += zapped.size();
+        stats.input_bytes = zapped.size();
+        decodeWhole(reinterpret_cast<const unsigned char *>(zapped.data()),
+                    zapped.size(), input_file, output);
+    } else {
+        // map the file once and decode its bits in place
+        StageTimer map(stats, READ_STAGE);
+        MappedFile zapped(input_file);
+        map.stop();
+        bytes_read += zapped.size();
+        stats.input_bytes = zapped.size();
+        decodeWhole(zapped.data(), zapped.size(), input_file, output);
+    }
+    StageTimer write(stats, WRITE_STAGE);
+    output.close();
+    write.stop();
+    stats.output_bytes = output.bytesWritten();
+}
+
+/**
+ * name:       compress
+ * purpose:    Zaps a memory buffer into another, without files.
+ * arguments:  text - the bytes to encode.
+ *             size - the number of bytes at ++text++.
+ *             zapped - replaced by the "ZBLK" stream of ++text++, or by a
+ *             "ZMSG" message if options.dictionary is set.
+ * returns:    void
+ * effects:    Uses options for the block size, interleaving, code length
+ *             limit and jobs; blocks always store canonical code lengths.
+ *             Block buffers and worker threads are kept for the next call,
+ *             and ++zapped++ keeps its capacity, so repeated calls on 
+ *             similar inputs do not allocate. Prints nothing.
+ */
+void HuffmanCoder::compress(const unsigned char* text, size_t size,
+                            std::vector<unsigned char>& zapped) {
+    zapped.clear();
+    stats = CoderStats();
+    StageTimer total(stats.total_seconds);
+    FileWriter output(zapped);
+    FileReader input(text, size);
+    if (options.dictionary) {
+        encodeMessage(text, size, output);
+    } else if (options.adaptive_interval > 0) {
+        encodeAdaptive(input, output);
+    } else {
+        encodeStream(input, output);
+    }
+    output.close();
+    stats.input_bytes = size;
+    stats.output_bytes = output.bytesWritten();
+}
+
+/**
+ * name:       decompress
+ * purpose:    Unzaps a memory buffer into another, without files.
+ * arguments:  zapped - the zapped bytes, in any layout decoder reads.
+ *             size - the number of bytes at ++zapped++.
+ *             text - replaced by the decoded bytes.
+ * returns:    void
+ * effects:    Keeps block buffers, worker threads and the capacity of 
+ *             ++text++ for the next call. Throws a runtime_error if 
+ *             ++zapped++ is malformed.
+ */
+void HuffmanCoder::decompress(const unsigned char* zapped, size_t size,
+                              std::vector<unsigned char>& text) {
+    text.clear();
+    stats = CoderStats();
+    StageTimer total(stats.total_seconds);
+    FileWriter output(text);
+    decodeBuffer(zapped, size, "memory buffer", output);
+    output.close();
+    stats.input_bytes = size;
+    stats.output_bytes = output.bytesWritten();
+}
+
+/**
+ * name:       decodeRange
+ * purpose:    Unzaps only part of a zapped file.
+ * arguments:  input_file - the zapped file, in any layout decoder reads.
+ *             output_file - the file the bytes are written to.
+ *             start - the offset in the unzapped text of the first byte.
+ *             length - the most bytes to write; fewer if the text ends
+ *             first.
+ * returns:    void
+ * effects:    Writes the bytes to ++output_file++. A block stream with an
+ *             index has only the blocks holding the range read and 
+ *             decoded; any other file is decoded from the start. Throws a
+ *             runtime_error if the file is malformed or is 
+ *             ++output_file++ itself.
+ */
+void HuffmanCoder::decodeRange(const std::string& input_file,
+                    const std::string& output_file, uint64_t start,
+                    uint64_t length) {
+    if (sameFile(input_file, output_file)) {
+        throw std::runtime_error("Cannot unzap " + input_file + 
+                                 " onto itself.");
+    }
+    stats = CoderStats();
+    StageTimer total(stats.total_seconds);
+    // the mapping lets the blocks before the range go unread
+    StageTimer read(stats, READ_STAGE);
+    MappedFile zapped(input_file);
+    read.stop();
+    bytes_read += zapped.size();
+    stats.input_bytes = zapped.size();
+    FileWriter output(output_file);
+    startFileThreads(nullptr, output);
+    decodeBufferRange(zapped.data(), zapped.size(), input_file, start, 
+                      length, output);
+    StageTimer write(stats, WRITE_STAGE);
+    output.close();
+    write.stop();
+    stats.output_bytes = output.bytesWritten();
+}
+
+/**
+ * name:       decompressRange
+ * purpose:    Unzaps part of a memory buffer into another.
+ * arguments:  zapped - the zapped bytes, in any layout decoder reads.
+ *             size - the number of bytes at ++zapped++.
+ *             start - the offset in the unzapped text of the first byte.
+ *             length - the most bytes to decode; fewer if the text ends
+ *             first.
+ *             text - replaced by the bytes.
+ * returns:    void
+ * effects:    As decodeRange.
+ */
+void HuffmanCoder::decompressRange(const unsigned char* zapped, size_t size,
+                    uint64_t start, uint64_t length,
+                    std::vector<unsigned char>& text) {
+    text.clear();
+    stats = CoderStats();
+    StageTimer total(stats.total_seconds);
+    FileWriter output(text);
+    decodeBufferRange(zapped, size, "memory buffer", start, length, output);
+    output.close();
+    stats.input_bytes = size;
+    stats.output_bytes = output.bytesWritten();
+}
+
+/**
+ * name:       decodeBuffer
+ * purpose:    Decodes a zapped file held in memory, in any layout.
+ * arguments:  zapped - the contents of the zapped file.
+ *             size - the number of bytes at ++zapped++.
+ *             input_file - the name of the file, for error messages.
+ *             output - the file the decoded text is written to.
+ * returns:    void
+ * effects:    Writes the decoded text to ++output++. Throws a runtime_error
+ *             if the file is malformed.
+ */
+void HuffmanCoder::decodeBuffer(const unsigned char* zapped, size_t size,
+                    const std::string& input_file, FileWriter& output) {
+    size_t magic_size = BLOCK_MAGIC.size();
+    std::string magic(reinterpret_cast<const char *>(zapped), 
+                      std::min(size, magic_size));
+    // the readers start past the magic, so only once it has matched
+    if (magic == BLOCK_MAGIC or magic == TRANSFORM_MAGIC) {
+        FileReader input(zapped + magic_size, size - magic_size);
+        decodeStream(input, output, magic == TRANSFORM_MAGIC);
+    } else if (magic == ADAPTIVE_MAGIC) {
+        FileReader input(zapped + magic_size, size - magic_size);
+        decodeAdaptive(input, output);
+    } else {
+        decodeWhole(zapped, size, input_file, output);
+    }
+}
+
+/**
+ * name:       decodeBufferRange
+ * purpose:    Decodes part of a zapped file held in memory.
+ * arguments:  zapped - the contents of the zapped file.
+ *             size - the number of bytes at ++zapped++.
+ *             input_file - the name of the file, for error messages.
+ *             start - the offset in the unzapped text of the first byte.
+ *             length - the most bytes to write.
+ *             output - the file the bytes are written to.
+ * returns:    void
+ * effects:    Writes the bytes to ++output++, using the block index if the
+ *             file has one to decode only the blocks holding the range.
+ *             Throws a runtime_error if the file is malformed or its index
+ *             does not match its blocks.
+ */
+void HuffmanCoder::decodeBufferRange(const unsigned char* zapped,
+                    size_t size, const std::string& input_file,
+                    uint64_t start, uint64_t length, FileWriter& output) {
+    size_t magic_size = BLOCK_MAGIC.size();
+    std::string magic(reinterpret_cast<const char *>(zapped), 
+                      std::min(size, magic_size));
+    if (magic != BLOCK_MAGIC and magic != TRANSFORM_MAGIC) {
+        output.setWindow(start, length);
+        decodeBuffer(zapped, size, input_file, output);
+        return;
+    }
+    // a block magic matched, so there are at least magic_size bytes
+    FileReader header(zapped + magic_size, size - magic_size);
+    TransformPipeline transforms;
+    if (magic == TRANSFORM_MAGIC) {
+        transforms = readStreamTransforms(header);
+    }
+    uint64_t block_size = readStreamHeader(header);
+    uint64_t first_block = magic_size + header.bytesRead();
+    BlockIndex index;
+    if (not readBlockIndex(zapped, size, first_block, block_size, index)) {
+        // an older stream: decode it all, keeping only the range
+        output.setWindow(start, length);
+        FileReader input(zapped + magic_size, size - magic_size);
+        decodeStream(input, output, magic == TRANSFORM_MAGIC);
+        return;
+    }
+    // skip the blocks that end before the range starts...
+    size_t first = 0;
+    uint64_t text_offset = 0, coded_offset = first_block;
+    while (first < index.size() and 
+                        index[first].text_size <= start - text_offset) {
+        text_offset += index[first].text_size;
+        coded_offset += index[first].coded_size;
+        first++;
+    }
+    // ...and take those that start before it ends
+    size_t count = 0;
+    uint64_t text_bytes = 0, coded_bytes = 0;
+    while (first + count < index.size() and length > 0 and
+                (text_offset + text_bytes <= start or 
+                 text_offset + text_bytes - start < length)) {
+        text_bytes += index[first + count].text_size;
+        coded_bytes += index[first + count].coded_size;
+        count++;
+    }
+    output.setWindow(start - std::min(start, text_offset), length);
+    uint64_t written = output.bytesWritten();
+    FileReader blocks(zapped + coded_offset, coded_bytes);
+    decodeBlocks(blocks, output, transforms, block_size, first, count);
+    // the blocks must be where the index says, and hold what it says
+    uint64_t range_end = std::min(text_offset + text_bytes, 
+                start + std::min(length, UINT64_MAX - start));
+    uint64_t expected = (count > 0 and range_end > start) 
+                            ? range_end - start : 0;
+    if (blocks.bytesRead() != coded_bytes or 
+                        output.bytesWritten() - written != expected) {
+        throw std::runtime_error("Zapped block index does not match the "
+                                 "stream.");
+    }
+}
+
+/**
+ * name:       decodeWhole
+ * purpose:    Decodes a zapped file in the "ZAP", "ZCAN" or "ZMSG" 
+ *             layout, which has to be in memory as a whole.
+ * arguments:  zapped - the contents of the zapped file.
+ *             size - the number of bytes at ++zapped++.
+ *             input_file - the name of the file, for error messages.
+ *             output - the file the decoded text is written to.
+ * returns:    void
+ * effects:    Writes the decoded text to ++output++. Throws a runtime_error
+ *             if the file is malformed.
+ */
+void HuffmanCoder::decodeWhole(const unsigned char* zapped, size_t size,
+                    const std::string& input_file, FileWriter& output) {
+    // headers are parsed from a short copy; the bits are decoded in place
+    std::string header(reinterpret_cast<const char *>(zapped),
+                       std::min(size, MAX_HEADER_SIZE));
+    if (hasMagic(header, CANONICAL_MAGIC)) {
+        decodeCanonical(zapped, size, header, output);
+    } else if (hasMagic(header, MESSAGE_MAGIC)) {
+        decodeMessage(zapped, size, header, output);
     } else {
-        decoded_text = decodeText(encoded_text, root);
+        decodeLegacy(zapped, size, input_file, output);
     }
-    std::ofstream output_file_stream(output_file); // write to file
-    output_file_stream << decoded_text;
-    output_file_stream.close();
-    deleteHuffmanTree(root); // clean up
 }
 
 /**
  * name:       countCharFrequencies
- * purpose:    Counts the frequency of each character in the input file 
- * and returns a map 
- *             of characters to their frequencies.
- * arguments:  input_file - a string representing the path to the input 
- * file whose contents 
- *             are to be analyzed for character frequencies.
- * returns:    A std::unordered_map<char, int> mapping each character to 
- * its frequency in 
- *             the input file.
- * effects:    Reads from the input file. Throws a runtime_error if the 
- * file cannot be 
- *             opened.
- */
-std::unordered_map<char, int> 
-HuffmanCoder::countCharFrequencies(const std::string& input_file) {
-    // create map to hold frequencys, key = chars, values = ints
-    std::unordered_map<char, int> char_frequencies;
-    std::ifstream file(input_file);
-    if (not file) {
-        throw std::runtime_error("Unable to open file " + input_file);
-    } // throw error if can't open file
-
-    char c;
-    while (file.get(c)) {
-        char_frequencies[c]++;
-    } // code to count frequencies in frequency map
-    file.close();
-    return char_frequencies; // return the filled in map
+ * purpose:    Counts the frequency of each character in the input text 
+ *             and returns a table of characters to their frequencies.
+ * arguments:  input_text - the text whose characters are to be counted, 
+ *             mapped into memory by encoder.
+ *             size - the number of bytes at ++input_text++.
+ * returns:    A FrequencyTable holding, for each byte value, its frequency
+ *             in the input text.
+ * effects:    None. Counting from the mapped text means the input file is 
+ *             only read once per run.
+ */
+FrequencyTable HuffmanCoder::countCharFrequencies(
+                        const unsigned char* input_text, size_t size) {
+    // one counter per byte value, indexed directly by the byte
+    FrequencyTable char_frequencies = {};
+    countBytes(input_text, size, char_frequencies);
+    return char_frequencies; // return the filled in table
 }
 
 /**
  * name:       buildHuffmanTree
  * purpose:    Builds a Huffman tree based on the frequencies of 
- * characters and returns 
- *             the root of the tree.
- * arguments:  char_frequencies - a map of characters to their frequencies.
+ *             characters and returns the root of the tree.
+ * arguments:  char_frequencies - the frequency of each byte value.
+ *             arena - the arena the nodes are created in.
  * returns:    A pointer to the root of the constructed Huffman tree.
- * effects:    Constructs a Huffman tree in dynamic memory. The caller 
- * is responsible 
- *             for deallocating the tree.
- */
-HuffmanTreeNode* HuffmanCoder::buildHuffmanTree(const std::unordered_map<char, 
-                                                    int>& char_frequencies) {
-    // create a priority queue of HuffmanTreeNodes
-    std::priority_queue<HuffmanTreeNode*, std::vector<HuffmanTreeNode*>, 
-                                                        NodeComparator> pq;
-
-    // add leaf nodes to the priority queue
-    for (const auto& pair : char_frequencies) {
-        pq.push(new HuffmanTreeNode(pair.first, pair.second));
-    }
-    // build the Huffman tree
-    while (pq.size() > 1) {
-        HuffmanTreeNode* left = pq.top();
-        pq.pop();
-        HuffmanTreeNode* right = pq.top();
-        pq.pop();
-        int combined_freq = left->get_freq() + right->get_freq();
-        HuffmanTreeNode* parent = new HuffmanTreeNode('\0', combined_freq, 
-                                                                left, right);
-        pq.push(parent);
+ * effects:    Constructs a Huffman tree in ++arena++, which owns it. 
+ *             Throws a runtime_error if no byte occurs.
+ */
+HuffmanTreeNode* HuffmanCoder::buildHuffmanTree(
+                const FrequencyTable& char_frequencies, TreeArena& arena) {
+    // sort the leaves once; ties go to the smaller byte
+    std::array<std::pair<uint64_t, int>, 256> leaves;
+    int leaf_count = 0;
+    for (int symbol = 0; symbol < 256; symbol++) {
+        if (char_frequencies[symbol] > 0) {
+            leaves[leaf_count++] = {char_frequencies[symbol], symbol};
+        }
+    }
+    if (leaf_count == 0) {
+        throw std::runtime_error("Huffman tree is empty.");
+    }
+    std::sort(leaves.begin(), leaves.begin() + leaf_count);
+
+    // two queues in one array: the sorted leaves, then the internal nodes
+    // in the order they are made, which is also by weight, so the two
+    // lightest nodes are always at the front of one queue or the other.
+    // Weights are tracked here as 64 bits; a node's int frequency 
+    // saturates instead of wrapping on inputs over 2 GB
+    HuffmanTreeNode* nodes[TreeArena::MAX_NODES];
+    uint64_t weights[TreeArena::MAX_NODES];
+    auto frequency = [](uint64_t weight) {
+        return static_cast<int>(std::min<uint64_t>(weight, INT_MAX));
+    };
+    for (int i = 0; i < leaf_count; i++) {
+        weights[i] = leaves[i].first;
+        nodes[i] = arena.create(static_cast<char>(leaves[i].second),
+                                frequency(weights[i]));
+    }
+    int next_leaf = 0, next_internal = leaf_count, end = leaf_count;
+    auto takeLightest = [&]() {
+        if (next_leaf < leaf_count and (next_internal == end or 
+                            weights[next_leaf] <= weights[next_internal])) {
+            return next_leaf++;
+        }
+        return next_internal++;
+    };
+    while ((leaf_count - next_leaf) + (end - next_internal) > 1) {
+        int left = takeLightest();
+        int right = takeLightest();
+        weights[end] = weights[left] + weights[right];
+        nodes[end] = arena.create('\0', frequency(weights[end]), 
+                                  nodes[left], nodes[right]);
+        end++;
     }
     // return the root of the Huffman tree
-    return pq.top();
+    return nodes[end - 1];
 }
 
 /**
  * name:       generateCharCodes
  * purpose:    Generates Huffman codes for characters based on the 
- * provided Huffman tree 
- *             and stores them in a map.
+ *             provided Huffman tree and stores them in a code table.
  * arguments:  root - a pointer to the root of the Huffman tree.
- *             char_codes - a reference to a map where the generated 
- * Huffman codes will 
- *             be stored, mapping characters to their Huffman codes.
- *             code - a string representing the current Huffman code 
- * in the recursive 
- *             traversal (initially empty).
+ *             char_codes - the table that receives each byte's code word.
+ *             bits - the code of ++root++ in the recursive traversal 
+ *             (initially 0).
+ *             length - the depth of ++root++ (initially 0).
  * returns:    void
- * effects:    Modifies the char_codes map to include Huffman codes for 
- * characters.
+ * effects:    Modifies char_codes to include Huffman codes for characters.
+ *             A tree that is a single leaf gives that character the code 
+ *             "0", so every character costs at least one bit.
  */
 void HuffmanCoder::generateCharCodes(const HuffmanTreeNode* root, 
-        std::unordered_map<char, std::string>& char_codes, std::string code) {
+        CodeTable& char_codes, uint64_t bits, int length) {
     if (not root) {
         return;
     }
     if (root->isLeaf()) {
-        char_codes[root->get_val()] = code;
+        HuffmanCode& code = char_codes[static_cast<unsigned char>(
+                                                        root->get_val())];
+        code.bits = bits;
+        code.length = (length == 0) ? 1 : length;
         return;
     } 
     // left = 0, right = 1 - need to reflect this in recursive calls
-    generateCharCodes(root->get_left(), char_codes, code + "0");
-    generateCharCodes(root->get_right(), char_codes, code + "1");
+    generateCharCodes(root->get_left(), char_codes, bits << 1, length + 1);
+    generateCharCodes(root->get_right(), char_codes, (bits << 1) | 1, 
+                                                                length + 1);
 }
 
 /**
  * name:       encodeText
- * purpose:    Encodes a given text using provided Huffman codes and 
- * returns the encoded 
- *             string.
+ * purpose:    Encodes a given text using a table of packed code words,
+ *             writing the code bits to a BitWriter.
  * arguments:  input_text - the text to be encoded.
- *             char_codes - a map of characters to their Huffman codes.
- * returns:    A string representing the encoded text.
- * effects:    None.
+ *             codes - the code word of each byte.
+ *             writer - the BitWriter that receives the encoded bits.
+ * returns:    void
+ * effects:    Appends to ++writer++. Every byte of the text must have a 
+ *             code; the table is indexed directly, with no lookup misses 
+ *             to check.
  */
-std::string HuffmanCoder::encodeText(const std::string& input_text, 
-                    const std::unordered_map<char, std::string>& char_codes) {
-    std::string encoded_text;
-    // Check if input text contains only a single unique character
-    if (char_codes.size() == 1) {
-        // Assign character code "0" to the unique character
-        encoded_text = std::string(input_text.size(), '0');
-    } else {
-        // encode text using the character codes
-        for (char c : input_text) { // iterate through input_text
-            encoded_text += char_codes.at(c);
-        } // add from map of char_codes to encoded_text using key char c
+void HuffmanCoder::encodeText(const std::string& input_text, 
+                    const CodeTable& codes, BitWriter& writer) {
+    encodeText(reinterpret_cast<const unsigned char *>(input_text.data()),
+               input_text.size(), codes, writer);
+}
+
+/**
+ * name:       encodeText
+ * purpose:    Encodes bytes in memory using a table of packed code words,
+ *             writing the code bits to a BitWriter.
+ * arguments:  input_text - the bytes to be encoded.
+ *             size - the number of bytes at ++input_text++.
+ *             codes - the code word of each byte.
+ *             writer - the BitWriter that receives the encoded bits.
+ * returns:    void
+ * effects:    As encodeText(const std::string&, ...). The codes are
+ *             written several at a time by BitWriter::writeCodes.
+ */
+void HuffmanCoder::encodeText(const unsigned char* input_text, size_t size,
+                    const CodeTable& codes, BitWriter& writer) {
+    writer.writeCodes(input_text, size, codes);
+}
+
+/**
+ * name:       encodeToFile
+ * purpose:    Writes a header and then the encoded text to a file, a 
+ *             piece at a time, so the encoding is never held whole.
+ * arguments:  input_text - the bytes to be encoded.
+ *             size - the number of bytes at ++input_text++.
+ *             codes - the code word of each byte.
+ *             header - everything the file holds before the packed bits.
+ *             output - the file to write; not closed.
+ * returns:    The number of encoded bits, excluding padding.
+ * effects:    Writes to ++output++. Throws a runtime_error if the file 
+ *             cannot be written.
+ */
+uint64_t HuffmanCoder::encodeToFile(const unsigned char* input_text,
+                    size_t size, const CodeTable& codes,
+                    const std::string& header, FileWriter& output) {
+    StageTimer write_header(stats, WRITE_STAGE);
+    output.write(header);
+    write_header.stop();
+    BitWriter encoded_bits;
+    for (size_t pos = 0; pos < size; pos += ENCODE_CHUNK_SIZE) {
+        size_t chunk = std::min(size - pos, ENCODE_CHUNK_SIZE);
+        StageTimer encode(stats, ENCODE_STAGE);
+        encodeText(input_text + pos, chunk, codes, encoded_bits);
+        encode.stop();
+        StageTimer write(stats, WRITE_STAGE);
+        output.write(encoded_bits.bytes());
+        encoded_bits.discardBytes(); // pending bits carry into the next one
     }
-    return encoded_text;
+    encoded_bits.flush();
+    StageTimer write(stats, WRITE_STAGE);
+    output.write(encoded_bits.bytes());
+    return encoded_bits.bitCount();
 }
 
 /**
@@ -270,141 +761,1163 @@ std::string HuffmanCoder::serializeHuffmanTree(const HuffmanTreeNode* root) {
  * representation.
  * arguments:  serialized_tree - a string representing the serialized 
  * Huffman tree.
- * returns:    A pointer to the root of the deserialized Huffman tree.
- * effects:    Allocates memory for a new Huffman tree. The caller is 
- * responsible for 
- *             deallocating the tree.
+ *             arena - the arena the nodes are created in.
+ * returns:    A pointer to the root of the deserialized Huffman tree, or
+ *             nullptr if ++serialized_tree++ is empty.
+ * effects:    Creates the tree in ++arena++, which owns it. The string may
+ *             come from anyone, so it is parsed with an explicit stack of
+ *             bounded depth rather than by recursion. Throws a 
+ *             runtime_error if it is not exactly one tree, if a leaf is 
+ *             deeper than a code may be long, or if a byte has two leaves
+ *             (which also keeps the tree within the arena).
  */
 HuffmanTreeNode* HuffmanCoder::deserializeHuffmanTree(
-                                const std::string& serialized_tree) {
+                const std::string& serialized_tree, TreeArena& arena) {
     if (serialized_tree.empty()) {
         return nullptr;
     }
-    int index = 0;
-    // call recursive helper
-    return deserializeHuffmanTreeHelper(serialized_tree, index);
-}
-
-/**
- * name:       deserializeHuffmanTreeHelper
- * purpose:    Recursively rebuilds a Huffman tree from its serialized 
- * representation.
- * arguments:  serialized_tree - the serialized tree as a string.
- *             index - reference to the current position within the 
- * serialized string.
- * returns:    A pointer to a HuffmanTreeNode, either a newly constructed 
- * node or nullptr 
- *             if the end of the string is reached or an invalid structure is 
- * detected.
- * effects:    Allocates memory for HuffmanTreeNode(s) as it reconstructs the 
- * tree from 
- *             the serialized data. Adjusts the index to track progress through 
- * the string. 
- *             Caller is responsible for freeing the allocated memory.
- */
-HuffmanTreeNode* HuffmanCoder::deserializeHuffmanTreeHelper(
-                        const std::string& serialized_tree, int& index) {
-    int size = serialized_tree.size();
-    if (index >= size) {
-        return nullptr;
-    } // base case: index > size of tree meaning index is out of range
-    char type = serialized_tree[index++];
-
-    if (type == 'L') { // if at leaf, val = char at index+1
+    // the left child of each internal node still being read, or nullptr
+    // until it has one
+    HuffmanTreeNode* pending[MAX_TREE_DEPTH];
+    int depth = 0;
+    bool seen[256] = {};
+    size_t size = serialized_tree.size();
+    size_t index = 0;
+    while (index < size) {
+        char type = serialized_tree[index++];
+        if (type == 'I') {
+            if (depth == MAX_TREE_DEPTH) {
+                throw std::runtime_error("Huffman tree is malformed.");
+            }
+            pending[depth++] = nullptr;
+            continue;
+        }
+        if (type != 'L' or index == size) {
+            throw std::runtime_error("Huffman tree is malformed.");
+        }
         char val = serialized_tree[index++];
-        return new HuffmanTreeNode(val, 0); // return a new node with new char
-    } else { // use recursive preorder to deserialize
-        HuffmanTreeNode* left = deserializeHuffmanTreeHelper(serialized_tree, 
-                                                                        index);
-        HuffmanTreeNode* right = deserializeHuffmanTreeHelper(serialized_tree, 
-                                                                        index);
-        return new HuffmanTreeNode('\0', 0, left, right);
+        unsigned char symbol = static_cast<unsigned char>(val);
+        if (seen[symbol]) {
+            throw std::runtime_error("Huffman tree is malformed.");
+        }
+        seen[symbol] = true;
+        HuffmanTreeNode* node = arena.create(val, 0);
+        // close every internal node this leaf completes
+        while (depth > 0 and pending[depth - 1]) {
+            node = arena.create('\0', 0, pending[--depth], node);
+        }
+        if (depth == 0) {
+            if (index != size) { // the tree ends before the string does
+                throw std::runtime_error("Huffman tree is malformed.");
+            }
+            return node;
+        }
+        pending[depth - 1] = node;
     }
+    throw std::runtime_error("Huffman tree is malformed."); // cut short
 }
 
 /**
  * name:       decodeText
- * purpose:    Decodes a string of encoded text using a Huffman tree and 
- * returns the 
- *             original text.
- * arguments:  encoded_text - the encoded text to be decoded.
+ * purpose:    Decodes packed encoded bits using a Huffman tree and 
+ *             returns the original text.
+ * arguments:  reader - a BitReader positioned at the encoded bits.
  *             root - a pointer to the root of the Huffman tree used for 
- * decoding.
+ *             decoding.
  * returns:    A string representing the decoded original text.
- * effects:    Throws a runtime_error if the encoding does not match the 
- * Huffman tree.
+ * effects:    Consumes every remaining bit of ++reader++. Throws a 
+ *             runtime_error if the encoding does not match the Huffman tree.
  */
-std::string HuffmanCoder::decodeText(const std::string& encoded_text, 
+std::string HuffmanCoder::decodeText(BitReader& reader, 
                                                 const HuffmanTreeNode* root) {
+    // flatten the tree into lookup tables so each step resolves a whole
+    // code word instead of following one pointer per bit
+    HuffmanDecodeTable table;
+    table.build(root);
+    std::string decoded_text;
+    table.decode(reader, decoded_text);
+    return decoded_text;
+}
+
+/**
+ * name:       limitCodeLengths
+ * purpose:    Replaces a Huffman tree whose codes are longer than 
+ *             options.max_code_length with the optimal one that respects 
+ *             the limit (found by package-merge), and reports what the 
+ *             limit costs.
+ * arguments:  root - a pointer to the root of the unconstrained Huffman 
+ *             tree, in ++arena++.
+ *             frequencies - the frequencies the tree was built from.
+ *             arena - the arena holding the tree; it is cleared and the 
+ *             new tree built in it if the tree is replaced.
+ * returns:    A pointer to the root of a tree with no code longer than the 
+ *             limit.
+ * effects:    Prints the bit counts with and without the limit to the 
+ *             coder's message stream, which is stderr when stdout carries
+ *             the zapped data or a JSON report. Throws a runtime_error if the limit is too short for the 
+ *             number of distinct characters.
+ */
+HuffmanTreeNode* HuffmanCoder::limitCodeLengths(HuffmanTreeNode* root,
+                const FrequencyTable& frequencies, TreeArena& arena) {
+    CodeLengths optimal = codeLengthsFromTree(root);
+    uint64_t optimal_bits = encodedBitCount(frequencies, optimal);
+    uint64_t limited_bits = optimal_bits;
+    if (maxCodeLength(optimal) > options.max_code_length) {
+        CodeLengths limited = lengthLimitedCodeLengths(frequencies, 
+                                                options.max_code_length);
+        limited_bits = encodedBitCount(frequencies, limited);
+        arena.clear();
+        root = treeFromCodes(canonicalCodes(limited), arena);
+    }
+    double loss = optimal_bits == 0 ? 0.0 :
+            100.0 * (limited_bits - optimal_bits) / optimal_bits;
+    *messages << "Code lengths limited to " << options.max_code_length
+              << " bits: " << limited_bits << " bits vs " << optimal_bits
+              << " unconstrained (+" << loss << "%)." << std::endl;
+    return root;
+}
+
+/**
+ * name:       canonicalHeader
+ * purpose:    Lays out everything in a "ZCAN" zapped file that comes 
+ *             before the packed bits.
+ * arguments:  lengths - the code length of each byte.
+ *             text_length - the number of bytes being encoded.
+ * returns:    The magic, the code-length header and the text length.
+ * effects:    Throws a runtime_error if no byte has a code.
+ */
+std::string HuffmanCoder::canonicalHeader(const CodeLengths& lengths,
+                                          uint64_t text_length) {
+    std::string header = CANONICAL_MAGIC;
+    header += serializeCodeLengths(lengths);
+    putVarint(header, text_length);
+    return header;
+}
+
+/**
+ * name:       decodeCanonical
+ * purpose:    Decodes a "ZCAN" zapped file. The lookup tables are built 
+ *             directly from the code lengths; no tree is allocated.
+ * arguments:  zapped - the contents of the zapped file.
+ *             size - the number of bytes at ++zapped++.
+ *             header - a copy of the start of the file, holding at least 
+ *             the whole header.
+ *             output - the file the decoded text is written to.
+ * returns:    void
+ * effects:    Writes the decoded text to ++output++. Throws a runtime_error
+ *             if the header is malformed or the bits do not decode to the 
+ *             stored text length.
+ */
+void HuffmanCoder::decodeCanonical(const unsigned char* zapped, size_t size,
+                    const std::string& header, FileWriter& output) {
+    size_t pos = CANONICAL_MAGIC.size();
+    CodeLengths lengths = deserializeCodeLengths(header, pos);
+    uint64_t text_length = getVarint(header, pos);
+    StageTimer build(stats, BUILD_STAGE);
+    HuffmanDecodeTable table;
+    table.build(canonicalCodes(lengths));
+    build.stop();
+    stats.blocks = 1;
+    stats.max_code_length = table.maxCodeLength();
+    decodeBits(table, zapped + pos, size - pos, text_length, output);
+}
+
+/**
+ * name:       decodeBits
+ * purpose:    Decodes packed bits of known text length, writing the text
+ *             out a chunk at a time.
+ * arguments:  table - the lookup tables for the code.
+ *             bits - the packed bits.
+ *             size - the number of bytes at ++bits++.
+ *             text_length - the number of bytes to decode.
+ *             output - the file the decoded text is written to.
+ * returns:    void
+ * effects:    Writes ++text_length++ bytes to ++output++. Throws a 
+ *             runtime_error if the bits run out or do not match the code.
+ */
+void HuffmanCoder::decodeBits(const HuffmanDecodeTable& table,
+                    const unsigned char* bits, size_t size, 
+                    uint64_t text_length, FileWriter& output) {
+    uint64_t available_bits = size * uint64_t(8);
+    if (text_length > available_bits) { // every code is at least one bit
+        throw std::runtime_error("Encoding did not match Huffman tree.");
+    }
+    BitReader reader(bits, size, available_bits);
+    std::string decoded_text;
+    decoded_text.reserve(std::min<uint64_t>(text_length, 
+                                            FileWriter::CHUNK_SIZE));
+    while (text_length > 0) {
+        uint64_t chunk = std::min<uint64_t>(text_length, 
+                                            FileWriter::CHUNK_SIZE);
+        decoded_text.clear();
+        StageTimer decode(stats, DECODE_STAGE);
+        table.decode(reader, chunk, decoded_text);
+        decode.stop();
+        StageTimer write(stats, WRITE_STAGE);
+        output.write(decoded_text);
+        text_length -= chunk;
+    }
+}
+
+/**
+ * name:       messageHeader
+ * purpose:    Lays out everything in a "ZMSG" zapped message that comes 
+ *             before the packed bits.
+ * arguments:  text_length - the number of bytes being encoded.
+ * returns:    The magic, the dictionary's id (4 bytes, least significant
+ *             first) and the text length.
+ * effects:    None.
+ */
+std::string HuffmanCoder::messageHeader(uint64_t text_length) const {
+    std::string header = MESSAGE_MAGIC;
+    uint32_t id = options.dictionary->id();
+    for (int shift = 0; shift < 32; shift += 8) {
+        header.push_back(static_cast<char>((id >> shift) & 0xff));
+    }
+    putVarint(header, text_length);
+    return header;
+}
+
+/**
+ * name:       encodeMessage
+ * purpose:    Encodes text as a "ZMSG" message with options.dictionary.
+ * arguments:  input_text - the bytes to be encoded.
+ *             size - the number of bytes at ++input_text++.
+ *             output - the file to write; not closed.
+ * returns:    The number of encoded bits, excluding padding.
+ * effects:    Writes the message to ++output++. The dictionary's codes are
+ *             used as they are, so nothing is built per message.
+ */
+uint64_t HuffmanCoder::encodeMessage(const unsigned char* input_text,
+                    size_t size, FileWriter& output) {
+    return encodeToFile(input_text, size, options.dictionary->codes(),
+                        messageHeader(size), output);
+}
+
+/**
+ * name:       decodeMessage
+ * purpose:    Decodes a "ZMSG" message with options.dictionary.
+ * arguments:  zapped - the contents of the zapped message.
+ *             size - the number of bytes at ++zapped++.
+ *             header - a copy of the start of the message, holding at 
+ *             least the whole header.
+ *             output - the file the decoded text is written to.
+ * returns:    void
+ * effects:    Writes the decoded text to ++output++. Throws a runtime_error
+ *             if no dictionary was given, the message names a different 
+ *             one, or the bits do not decode to the stored text length.
+ */
+void HuffmanCoder::decodeMessage(const unsigned char* zapped, size_t size,
+                    const std::string& header, FileWriter& output) {
+    size_t pos = MESSAGE_MAGIC.size();
+    if (header.size() < pos + 4) {
+        throw std::runtime_error("Zapped file header is truncated.");
+    }
+    uint32_t id = 0;
+    for (int i = 0; i < 4; i++) {
+        id |= static_cast<uint32_t>(
+                    static_cast<unsigned char>(header[pos++])) << (8 * i);
+    }
+    if (not options.dictionary) {
+        throw std::runtime_error("Zapped message needs a dictionary "
+                                 "(--dictionary=FILE).");
+    }
+    if (id != options.dictionary->id()) {
+        throw std::runtime_error("Zapped message was made with a different "
+                                 "dictionary.");
+    }
+    uint64_t text_length = getVarint(header, pos);
+    stats.blocks = 1;
+    stats.max_code_length = options.dictionary->table().maxCodeLength();
+    decodeBits(options.dictionary->table(), zapped + pos, size - pos, 
+               text_length, output);
+}
+
+/**
+ * name:       decodeLegacy
+ * purpose:    Decodes a "ZAP" zapped file, which stores a serialized tree.
+ * arguments:  zapped - the contents of the zapped file.
+ *             size - the number of bytes at ++zapped++.
+ *             input_file - the name of the file, for error messages.
+ *             output - the file the decoded text is written to.
+ * returns:    void
+ * effects:    Writes the decoded text to ++output++. Throws a runtime_error
+ *             if the file is not a zapped file, is truncated, or the bits 
+ *             do not match the tree.
+ */
+void HuffmanCoder::decodeLegacy(const unsigned char* zapped, size_t size,
+                    const std::string& input_file, FileWriter& output) {
+    PackedBinaryIO binary_io;
+    PackedZapView file_data = binary_io.parseFile(zapped, size, input_file);
+    StageTimer build(stats, BUILD_STAGE);
+    TreeArena arena;
+    HuffmanTreeNode* root = deserializeHuffmanTree(file_data.serial_tree, 
+                                                   arena);
     if (not root) throw std::runtime_error("Huffman tree is empty.");
+    stats.blocks = 1;
+    if (root->isLeaf()) {
+        // padding bits are zero, so every byte is zero iff every bit is
+        const unsigned char* end = file_data.packed_bits + 
+                                                    file_data.packed_size;
+        bool allZeros = std::find_if(file_data.packed_bits, end,
+                            [](unsigned char b) { return b != 0; }) == end;
+        if (allZeros) {
+            build.stop();
+            StageTimer write(stats, WRITE_STAGE);
+            output.writeRepeated(root->get_val(), file_data.num_bits);
+            return;
+        }
+    }
+    HuffmanDecodeTable table;
+    table.build(root);
+    build.stop();
+    stats.max_code_length = table.maxCodeLength();
+    BitReader encoded_bits(file_data.packed_bits, file_data.packed_size,
+                           file_data.num_bits);
     std::string decoded_text;
-    const HuffmanTreeNode* curr = root;
-    for (char bit : encoded_text) { // iterate through encoded text
-        if (bit == '0') { // 0 = left, so get left here
-            curr = curr->get_left();
-        } else if (bit == '1') { // 1 = right, so get right here
-            curr = curr->get_right();
-        }
-        if (curr == nullptr) {
+    decoded_text.reserve(FileWriter::CHUNK_SIZE);
+    do {
+        decoded_text.clear();
+        StageTimer decode(stats, DECODE_STAGE);
+        table.decodeAtMost(encoded_bits, FileWriter::CHUNK_SIZE, 
+                           decoded_text);
+        decode.stop();
+        StageTimer write(stats, WRITE_STAGE);
+        output.write(decoded_text); // write to file
+    } while (encoded_bits.bitsRemaining() > 0);
+}
+
+/**
+ * name:       encodeMappedStream
+ * purpose:    Encodes a mapped file as a block stream, for the files the
+ *             whole-file formats would store badly: a single repeated byte
+ *             or text the code would not shrink.
+ * arguments:  input - the mapped text, already counted in bytes_read.
+ *             output_file - the path of the file to write.
+ * returns:    void
+ * effects:    Writes ++output_file++ and prints the bit count.
+ */
+void HuffmanCoder::encodeMappedStream(const MappedFile& input,
+                                      const std::string& output_file) {
+    FileReader text(input.data(), input.size());
+    FileWriter output(output_file);
+    startFileThreads(nullptr, output);
+    uint64_t num_bits = encodeStream(text, output);
+    output.close();
+    stats.output_bytes = output.bytesWritten();
+    *messages << "Success! Encoded given text using " << num_bits
+                                            << " bits." << std::endl;
+}
+
+/**
+ * name:       encodeStream
+ * purpose:    Encodes a file, or stdin, as a "ZBLK" block stream: the 
+ *             input is read one block at a time and each block is written
+ *             out with its own code before the next one is read.
+ * arguments:  input - the text to encode.
+ *             output - where the stream is written; not closed.
+ * returns:    The total number of encoded bits.
+ * effects:    Writes the stream to ++output++. Memory use is a few blocks,
+ *             whatever the input size. An empty input gives a stream with
+ *             no blocks.
+ */
+uint64_t HuffmanCoder::encodeStream(FileReader& input, FileWriter& output) {
+    uint64_t block_size = streamBlockSize();
+    block_index.clear();
+    writeStreamHeader(output, block_size, options.transforms);
+    uint64_t num_bits = encodeBlocks(input, output, block_size);
+    writeStreamEnd(output);
+    return num_bits;
+}
+
+/**
+ * name:       writeStreamEnd
+ * purpose:    Closes a block stream: the end block, then the index of the
+ *             blocks written since block_index was cleared.
+ * arguments:  output - the file the stream is written to.
+ * returns:    void
+ * effects:    Writes to ++output++.
+ */
+void HuffmanCoder::writeStreamEnd(FileWriter& output) {
+    BlockHeader end = {END_BLOCK, 0, 0, false, 0};
+    writeBlockHeader(output, end);
+    writeBlockIndex(output, block_index);
+}
+
+/**
+ * name:       encodeAdaptive
+ * purpose:    Encodes text as a "ZADP" adaptive stream (see 
+ *             AdaptiveModel.h): each segment is coded as soon as it is 
+ *             read, with the code the segments before it built, so no
+ *             count of the whole input is needed first.
+ * arguments:  input - the text to encode.
+ *             output - where the stream is written; not closed.
+ * returns:    The total number of encoded bits.
+ * effects:    Writes the stream to ++output++. A segment is whatever text
+ *             is waiting, up to options.adaptive_interval bytes; when less
+ *             than that was waiting, the input is slow, so the output is
+ *             flushed for whoever reads it. Throws a runtime_error if 
+ *             options.max_code_length is below MIN_ADAPTIVE_CODE_LENGTH.
+ */
+uint64_t HuffmanCoder::encodeAdaptive(FileReader& input, FileWriter& output) {
+    uint64_t interval = std::min(options.adaptive_interval, MAX_BLOCK_SIZE);
+    int max_length = (options.max_code_length > 0) 
+                        ? options.max_code_length 
+                        : DEFAULT_ADAPTIVE_CODE_LENGTH;
+    AdaptiveModel model(max_length);
+    writeAdaptiveHeader(output, interval, max_length);
+    // a block's buffers hold the segment, and are kept with the others
+    std::unique_ptr<StreamBlock> segment = takeBlock();
+    std::string& text = segment->text;
+    BitWriter& writer = segment->encoded_bits[0];
+    text.resize(interval);
+    uint64_t num_bits = 0;
+    while (true) {
+        StageTimer read(stats, READ_STAGE);
+        size_t size = input.readSome(&text[0], interval);
+        read.stop();
+        if (size == 0) {
+            break;
+        }
+        const unsigned char* bytes = 
+                    reinterpret_cast<const unsigned char *>(text.data());
+        StageTimer encode(stats, ENCODE_STAGE);
+        writer.clear();
+        encodeText(bytes, size, model.codes(), writer);
+        writer.flush();
+        encode.stop();
+        StageTimer histogram(stats, HISTOGRAM_STAGE);
+        FrequencyTable frequencies = countCharFrequencies(bytes, size);
+        histogram.stop();
+        stats.countBlock(frequencies, writer.bitCount(), 
+                         maxCodeLength(model.lengths()));
+        num_bits += writer.bitCount();
+        StageTimer write(stats, WRITE_STAGE);
+        writeSegmentHeader(output, size, writer.bytes().size());
+        output.write(writer.bytes());
+        if (size < interval) {
+            output.flush();
+        }
+        write.stop();
+        StageTimer build(stats, BUILD_STAGE);
+        model.update(frequencies);
+    }
+    writeSegmentHeader(output, 0, 0);
+    spare_blocks.push_back(std::move(segment));
+    return num_bits;
+}
+
+/**
+ * name:       decodeAdaptive
+ * purpose:    Decodes a "ZADP" adaptive stream a segment at a time.
+ * arguments:  input - the stream, positioned just past its magic.
+ *             output - the file the decoded text is written to.
+ * returns:    void
+ * effects:    Writes the decoded text to ++output++, flushing it after 
+ *             each short segment, where the encoder found its input slow.
+ *             Throws a runtime_error if the stream is truncated or 
+ *             malformed.
+ */
+void HuffmanCoder::decodeAdaptive(FileReader& input, FileWriter& output) {
+    uint64_t interval = 0;
+    int max_length = 0;
+    readAdaptiveHeader(input, interval, max_length);
+    AdaptiveModel model(max_length);
+    std::unique_ptr<StreamBlock> segment = takeBlock();
+    std::string& payload = segment->payload;
+    std::string& text = segment->text;
+    uint64_t text_size = 0, payload_size = 0;
+    while (true) {
+        StageTimer read(stats, READ_STAGE);
+        if (not readSegmentHeader(input, interval, max_length, text_size,
+                                  payload_size)) {
+            break;
+        }
+        if (not input.readExactly(payload, payload_size)) {
+            throw std::runtime_error("Zapped adaptive stream is truncated.");
+        }
+        read.stop();
+        if (text_size > payload_size * 8) { // every code is at least a bit
             throw std::runtime_error("Encoding did not match Huffman tree.");
-        } // throw but don't catch like demo
-        if (curr->isLeaf()) { // if we're at a leaf, leaf value should be added
-            decoded_text += curr->get_val();
-            curr = root; // Reset to root for next character
         }
+        StageTimer build(stats, BUILD_STAGE);
+        const HuffmanDecodeTable& table = model.decodeTable();
+        build.stop();
+        stats.max_code_length = std::max(stats.max_code_length,
+                                         table.maxCodeLength());
+        StageTimer decode(stats, DECODE_STAGE);
+        BitReader reader(reinterpret_cast<const unsigned char *>(
+                            payload.data()), payload_size, payload_size * 8);
+        text.clear();
+        table.decode(reader, text_size, text);
+        decode.stop();
+        stats.blocks++;
+        StageTimer write(stats, WRITE_STAGE);
+        output.write(text);
+        if (text_size < interval) {
+            output.flush();
+        }
+        write.stop();
+        StageTimer histogram(stats, HISTOGRAM_STAGE);
+        FrequencyTable frequencies = countCharFrequencies(
+            reinterpret_cast<const unsigned char *>(text.data()), text_size);
+        histogram.stop();
+        StageTimer rebuild(stats, BUILD_STAGE);
+        model.update(frequencies);
+    }
+    spare_blocks.push_back(std::move(segment));
+}
+
+/**
+ * name:       encodeBlocks
+ * purpose:    Encodes text as a run of stream blocks, without the stream
+ *             header or end block.
+ * arguments:  input - the text to encode.
+ *             output - where the blocks are written.
+ *             block_size - the most text a block holds; every block but 
+ *             the last is full.
+ * returns:    The number of encoded bits in the blocks.
+ * effects:    Writes the blocks to ++output++. Rethrows anything encoding
+ *             a block threw, once no block is still being coded.
+ */
+uint64_t HuffmanCoder::encodeBlocks(FileReader& input, FileWriter& output,
+                                    uint64_t block_size) {
+    // blocks are coded in the pool and written in order as they finish;
+    // their buffers are reused from block to block and call to call
+    ThreadPool& workers = workerPool();
+    stats.threads = std::max(stats.threads, static_cast<int>(workers.size()));
+    size_t max_pending = std::max<size_t>(1, 2 * workers.size());
+    uint64_t num_bits = 0;
+    std::vector<size_t> pieces;
+    try {
+        while (true) {
+            std::unique_ptr<StreamBlock> block = takeBlock();
+            StageTimer read(stats, READ_STAGE);
+            block->text.resize(block_size);
+            block->text_size = input.read(&block->text[0], block_size);
+            read.stop();
+            if (block->text_size == 0) {
+                spare_blocks.push_back(std::move(block));
+                break;
+            }
+            if (options.split_blocks) {
+                // the split points come from the histograms of segments
+                StageTimer histogram(stats, HISTOGRAM_STAGE);
+                splitBlock(reinterpret_cast<const unsigned char *>(
+                                block->text.data()), block->text_size, pieces);
+            } else {
+                pieces.assign(1, block->text_size);
+            }
+            // the first piece stays in the block that was read; the rest
+            // are copied out before it is handed to a worker
+            std::vector<std::unique_ptr<StreamBlock>> split;
+            split.push_back(std::move(block));
+            size_t start = pieces[0];
+            for (size_t k = 1; k < pieces.size(); k++) {
+                std::unique_ptr<StreamBlock> piece = takeBlock();
+                piece->text.assign(split[0]->text, start, pieces[k]);
+                piece->text_size = pieces[k];
+                start += pieces[k];
+                split.push_back(std::move(piece));
+            }
+            split[0]->text_size = pieces[0];
+            for (std::unique_ptr<StreamBlock>& piece : split) {
+                if (pending_blocks.size() == max_pending) {
+                    num_bits += writeEncodedBlock(output);
+                }
+                StreamBlock* job = piece.get();
+                pending_blocks.push_back(std::move(piece));
+                job->done = workers.submit([this, job]() { 
+                    encodeBlock(*job); 
+                });
+            }
+        }
+        while (not pending_blocks.empty()) {
+            num_bits += writeEncodedBlock(output);
+        }
+    } catch (...) {
+        abandonBlocks();
+        throw;
+    }
+    return num_bits;
+}
+
+/**
+ * name:       streamBlockSize
+ * purpose:    Picks the block size for a new stream.
+ * arguments:  none
+ * returns:    options.block_size, or DEFAULT_BLOCK_SIZE if it is 0.
+ * effects:    None.
+ */
+uint64_t HuffmanCoder::streamBlockSize() const {
+    return options.block_size > 0 ? options.block_size : DEFAULT_BLOCK_SIZE;
+}
+
+/**
+ * name:       writeEncodedBlock
+ * purpose:    Waits for the oldest block being encoded and writes it out.
+ * arguments:  output - the file to write the block to.
+ * returns:    The number of encoded bits in the block.
+ * effects:    Moves the oldest block from pending_blocks to spare_blocks
+ *             and adds it to block_index. Rethrows anything its encoding
+ *             threw.
+ */
+uint64_t HuffmanCoder::writeEncodedBlock(FileWriter& output) {
+    std::unique_ptr<StreamBlock> block = std::move(pending_blocks.front());
+    pending_blocks.pop_front();
+    spare_blocks.push_back(std::move(block));
+    StreamBlock& finished = *spare_blocks.back();
+    finished.done.get();
+    stats.add(finished.stats);
+    StageTimer write(stats, WRITE_STAGE);
+    BlockHeader header = {finished.type, finished.text_size, 
+                          finished.payload.size(), finished.checked,
+                          finished.checksum};
+    uint64_t start = output.bytesWritten();
+    writeBlockHeader(output, header);
+    output.write(finished.payload);
+    block_index.push_back({finished.source_size, 
+                           output.bytesWritten() - start});
+    return finished.num_bits;
+}
+
+/**
+ * name:       takeBlock
+ * purpose:    Gets a block whose buffers can be filled.
+ * arguments:  none
+ * returns:    A block from spare_blocks, or a new one if there is none.
+ * effects:    Modifies spare_blocks.
+ */
+std::unique_ptr<HuffmanCoder::StreamBlock> HuffmanCoder::takeBlock() {
+    if (spare_blocks.empty()) {
+        return std::unique_ptr<StreamBlock>(new StreamBlock());
+    }
+    std::unique_ptr<StreamBlock> block = std::move(spare_blocks.back());
+    spare_blocks.pop_back();
+    return block;
+}
+
+/**
+ * name:       abandonBlocks
+ * purpose:    Gives up on the blocks of a stream that failed part way.
+ * arguments:  none
+ * returns:    void
+ * effects:    Waits for the task of every pending block, since the pool 
+ *             outlives the call, then keeps the blocks in spare_blocks.
+ */
+void HuffmanCoder::abandonBlocks() {
+    for (std::unique_ptr<StreamBlock>& block : pending_blocks) {
+        if (block->done.valid()) {
+            block->done.wait();
+        }
+        spare_blocks.push_back(std::move(block));
+    }
+    pending_blocks.clear();
+}
+
+/**
+ * name:       workerThreads
+ * purpose:    Picks the size of the thread pool for options.jobs.
+ * arguments:  none
+ * returns:    0 to code blocks on the calling thread (one job), otherwise
+ *             the number of workers; a jobs value of 0 uses every 
+ *             hardware thread.
+ * effects:    None.
+ */
+size_t HuffmanCoder::workerThreads() const {
+    size_t jobs = options.jobs > 0 ? options.jobs 
+                                   : ThreadPool::hardwareThreads();
+    return jobs > 1 ? jobs : 0;
+}
+
+/**
+ * name:       startFileThreads
+ * purpose:    Moves a file coding's I/O onto threads of its own, when 
+ *             options.pipelined_io is set.
+ * arguments:  input - the reader to read ahead, or nullptr if the input is
+ *             mapped.
+ *             output - the writer to write behind.
+ * returns:    void
+ * effects:    Starts up to two threads; see FileReader::readAhead and 
+ *             FileWriter::writeBehind.
+ */
+void HuffmanCoder::startFileThreads(FileReader* input, 
+                                    FileWriter& output) const {
+    if (not options.pipelined_io) {
+        return;
+    }
+    if (input) {
+        input->readAhead();
+    }
+    output.writeBehind();
+}
+
+/**
+ * name:       workerPool
+ * purpose:    Gives access to the threads blocks are coded on.
+ * arguments:  none
+ * returns:    The pool, with workerThreads() workers.
+ * effects:    Starts the pool on the first call.
+ */
+ThreadPool& HuffmanCoder::workerPool() {
+    if (not pool) {
+        pool.reset(new ThreadPool(workerThreads()));
+    }
+    return *pool;
+}
+
+/**
+ * name:       blockCodeLengths
+ * purpose:    Finds the code lengths for one block, respecting 
+ *             options.max_code_length when it is set.
+ * arguments:  frequencies - the frequency of each byte in the block.
+ * returns:    The code length of each byte.
+ * effects:    Throws a runtime_error if the limit is too short for the 
+ *             number of distinct bytes.
+ */
+CodeLengths HuffmanCoder::blockCodeLengths(const FrequencyTable& frequencies) {
+    // no tree is needed for a block, only the lengths
+    CodeLengths lengths = huffmanCodeLengths(frequencies);
+    if (options.max_code_length > 0 and 
+                    maxCodeLength(lengths) > options.max_code_length) {
+        lengths = lengthLimitedCodeLengths(frequencies, 
+                                           options.max_code_length);
+    }
+    return lengths;
+}
+
+/**
+ * name:       encodeBlock
+ * purpose:    Encodes one block of text into a block payload. A block of
+ *             one repeated byte becomes a RUN_BLOCK, and a block the code
+ *             would not shrink a RAW_BLOCK; otherwise options.interleave
+ *             picks the type.
+ * arguments:  block - a block whose text and text_size are filled in; 
+ *             text_size is at least 1.
+ * returns:    void
+ * effects:    Sets the block's type, payload and num_bits, reusing its 
+ *             BitWriters.
+ */
+void HuffmanCoder::encodeBlock(StreamBlock& block) {
+    block.stats = CoderStats();
+    block.source_size = block.text_size;
+    block.checked = options.block_checksums;
+    if (block.checked) {
+        StageTimer checksum(block.stats, CHECKSUM_STAGE);
+        block.checksum = crc32c(reinterpret_cast<const unsigned char *>(
+                                    block.text.data()), block.text_size);
+    }
+    if (not options.transforms.empty()) {
+        StageTimer transform(block.stats, TRANSFORM_STAGE);
+        forwardTransforms(options.transforms, block.text, block.text_size,
+                          block.scratch);
+    }
+    const unsigned char* text = 
+                reinterpret_cast<const unsigned char *>(block.text.data());
+    StageTimer histogram(block.stats, HISTOGRAM_STAGE);
+    FrequencyTable frequencies = countCharFrequencies(text, block.text_size);
+    histogram.stop();
+    block.payload.clear(); // keeps its capacity
+    if (distinctBytes(frequencies) == 1) {
+        block.type = RUN_BLOCK;
+        block.payload += block.text[0];
+        block.num_bits = 8;
+        block.stats.countBlock(frequencies, block.num_bits, 0);
+        return;
+    }
+    StageTimer build(block.stats, BUILD_STAGE);
+    CodeLengths lengths = blockCodeLengths(frequencies);
+    build.stop();
+    StageTimer codegen(block.stats, CODEGEN_STAGE);
+    block.payload += serializeCodeLengths(lengths);
+    codegen.stop();
+    // the coded size is known from the histogram before anything is coded;
+    // interleaving adds up to a byte of padding and a size per stream
+    uint64_t coded_bytes = block.payload.size() + 
+                            (encodedBitCount(frequencies, lengths) + 7) / 8;
+    if (options.interleave) {
+        coded_bytes += 4 * INTERLEAVED_STREAMS;
+    }
+    if (options.context_model and encodeContextBlock(block, coded_bytes)) {
+        // the context tables' longest code is already in block.stats
+        block.stats.countBlock(frequencies, block.num_bits, 0);
+        return;
+    }
+    if (coded_bytes >= block.text_size) {
+        block.type = RAW_BLOCK;
+        block.payload.assign(block.text, 0, block.text_size);
+        block.num_bits = 8 * block.text_size;
+        block.stats.countBlock(frequencies, block.num_bits, 0);
+        return;
+    }
+    StageTimer generate(block.stats, CODEGEN_STAGE);
+    CodeTable codes = canonicalCodes(lengths);
+    generate.stop();
+    StageTimer encode(block.stats, ENCODE_STAGE);
+    block.num_bits = 0;
+    if (not options.interleave) {
+        block.type = HUFFMAN_BLOCK;
+        BitWriter& encoded_bits = block.encoded_bits[0];
+        encoded_bits.clear();
+        encodeText(text, block.text_size, codes, encoded_bits);
+        encoded_bits.flush();
+        block.payload += encoded_bits.bytes();
+        block.num_bits = encoded_bits.bitCount();
+        encode.stop();
+        block.stats.countBlock(frequencies, block.num_bits, 
+                               maxCodeLength(lengths));
+        return;
+    }
+    block.type = INTERLEAVED_BLOCK;
+    encodeInterleaved(text, block.text_size, codes, block.encoded_bits);
+    for (int k = 0; k < INTERLEAVED_STREAMS; k++) {
+        block.encoded_bits[k].flush();
+        block.num_bits += block.encoded_bits[k].bitCount();
+        if (k < INTERLEAVED_STREAMS - 1) { // the last size is what is left
+            putVarint(block.payload, block.encoded_bits[k].bytes().size());
+        }
+    }
+    for (int k = 0; k < INTERLEAVED_STREAMS; k++) {
+        block.payload += block.encoded_bits[k].bytes();
+    }
+    encode.stop();
+    block.stats.countBlock(frequencies, block.num_bits, 
+                           maxCodeLength(lengths));
+}
+
+/**
+ * name:       encodeContextBlock
+ * purpose:    Encodes a block as a CONTEXT_BLOCK if that is smaller than
+ *             both the order-0 code and the raw text.
+ * arguments:  block - a block whose text and text_size are filled in.
+ *             order0_bytes - the payload size of the order-0 block.
+ * returns:    true if the block was encoded; false leaves its payload
+ *             alone.
+ * effects:    Sets the block's type, payload and num_bits on success.
+ */
+bool HuffmanCoder::encodeContextBlock(StreamBlock& block, 
+                                      uint64_t order0_bytes) {
+    const unsigned char* text = 
+                reinterpret_cast<const unsigned char *>(block.text.data());
+    StageTimer histogram(block.stats, HISTOGRAM_STAGE);
+    countContextFrequencies(text, block.text_size, block.context_counts);
+    histogram.stop();
+    StageTimer build(block.stats, BUILD_STAGE);
+    ContextMap cluster_of;
+    std::vector<FrequencyTable> cluster_counts;
+    int clusters = clusterContexts(block.context_counts, cluster_of,
+                                   cluster_counts);
+    std::vector<CodeLengths> lengths(clusters);
+    uint64_t num_bits = 0;
+    int longest = 0;
+    for (int k = 0; k < clusters; k++) {
+        lengths[k] = blockCodeLengths(cluster_counts[k]);
+        num_bits += encodedBitCount(cluster_counts[k], lengths[k]);
+        longest = std::max(longest, maxCodeLength(lengths[k]));
+    }
+    build.stop();
+    StageTimer codegen(block.stats, CODEGEN_STAGE);
+    std::string header = serializeContextMap(cluster_of, clusters);
+    for (int k = 0; k < clusters; k++) {
+        header += serializeCodeLengths(lengths[k]);
+    }
+    codegen.stop();
+    uint64_t coded_bytes = header.size() + (num_bits + 7) / 8;
+    if (coded_bytes >= std::min(order0_bytes, block.text_size)) {
+        return false;
+    }
+    StageTimer generate(block.stats, CODEGEN_STAGE);
+    std::vector<CodeTable> codes(clusters);
+    for (int k = 0; k < clusters; k++) {
+        codes[k] = canonicalCodes(lengths[k]);
+    }
+    const HuffmanCode* codes_by_context[256];
+    for (int context = 0; context < 256; context++) {
+        codes_by_context[context] = codes[cluster_of[context]].data();
+    }
+    generate.stop();
+    StageTimer encode(block.stats, ENCODE_STAGE);
+    BitWriter& encoded_bits = block.encoded_bits[0];
+    encoded_bits.clear();
+    encodeWithContexts(text, block.text_size, codes_by_context, 
+                       encoded_bits);
+    encoded_bits.flush();
+    block.type = CONTEXT_BLOCK;
+    block.payload = header;
+    block.payload += encoded_bits.bytes();
+    block.num_bits = encoded_bits.bitCount();
+    block.stats.max_code_length = longest;
+    return true;
+}
+
+/**
+ * name:       encodeInterleaved
+ * purpose:    Encodes text dealt round-robin over INTERLEAVED_STREAMS bit
+ *             streams: byte i goes to stream i % INTERLEAVED_STREAMS.
+ * arguments:  input_text - the bytes to be encoded.
+ *             size - the number of bytes at ++input_text++.
+ *             codes - the code word of each byte.
+ *             writers - one BitWriter per stream; cleared first.
+ * returns:    void
+ * effects:    Modifies ++writers++. The streams are not flushed.
+ */
+void HuffmanCoder::encodeInterleaved(const unsigned char* input_text,
+                    size_t size, const CodeTable& codes, BitWriter* writers) {
+    for (int k = 0; k < INTERLEAVED_STREAMS; k++) {
+        writers[k].clear();
+    }
+    for (size_t i = 0; i < size; i++) {
+        const HuffmanCode& code = codes[input_text[i]];
+        writers[i % INTERLEAVED_STREAMS].write(code.bits, code.length);
     }
-    if (curr != root) {
-        throw std::runtime_error("Encoding did not match Huffman tree.");
-    } // throw but don't catch error 
-    return decoded_text;
 }
 
 /**
- * name:       readFileContents
- * purpose:    Reads the entire content of a file into a string and returns it.
- * arguments:  input_file - a string representing the path to the file to be 
- * read.
- * returns:    A string containing the content of the file.
- * effects:    Reads from the input file. Throws a runtime_error if the 
- * file cannot be 
- *             opened.
+ * name:       decodeStream
+ * purpose:    Decodes a "ZBLK" or "ZBLT" block stream one block at a time.
+ * arguments:  input - the stream, positioned just past its magic.
+ *             output - the file the decoded text is written to.
+ *             transformed - true for TRANSFORM_MAGIC, whose pipeline
+ *             comes next.
+ * returns:    void
+ * effects:    Writes the decoded text to ++output++. Throws a runtime_error
+ *             if the stream is truncated or malformed, or is followed by
+ *             bytes that are not its index.
  */
-std::string HuffmanCoder::readFileContents(const std::string& input_file) {
-    // Open the file in binary mode. This ensures that the file is read
-    // byte-for-byte
-    std::ifstream file(input_file, std::ios::binary);
+void HuffmanCoder::decodeStream(FileReader& input, FileWriter& output,
+                                bool transformed) {
+    TransformPipeline transforms;
+    if (transformed) {
+        transforms = readStreamTransforms(input);
+    }
+    uint64_t block_size = readStreamHeader(input);
+    decodeBlocks(input, output, transforms, block_size, 0, UINT64_MAX);
+    // the index is for readers that seek; this one only reads past it
+    StageTimer read(stats, READ_STAGE);
+    skipBlockIndex(input);
+}
 
-    if (not file) {
-        throw std::runtime_error("Unable to open file " + input_file);
+/**
+ * name:       decodeBlocks
+ * purpose:    Decodes the blocks of a block stream, after its header.
+ * arguments:  input - the stream, positioned at a block header.
+ *             output - the file the decoded text is written to.
+ *             transforms - the stream's transform pipeline.
+ *             block_size - the block size the stream declared.
+ *             first_block - the number of the first block in its stream,
+ *             for error messages.
+ *             max_blocks - the most blocks to decode; decoding stops 
+ *             sooner at an end block.
+ * returns:    void
+ * effects:    Writes the decoded text to ++output++. Throws a runtime_error
+ *             if the stream is truncated or malformed, or a block does not
+ *             match its checksum; the blocks before a bad one are still
+ *             written.
+ */
+void HuffmanCoder::decodeBlocks(FileReader& input, FileWriter& output,
+                    const TransformPipeline& transforms, uint64_t block_size,
+                    uint64_t first_block, uint64_t max_blocks) {
+    // transforms can leave a block a little longer than the text it holds
+    uint64_t coded_size = transformedSizeBound(transforms, block_size);
+    // blocks are decoded in the pool and written in order as they finish;
+    // their buffers are reused from block to block and call to call
+    ThreadPool& workers = workerPool();
+    stats.threads = std::max(stats.threads, static_cast<int>(workers.size()));
+    size_t max_pending = std::max<size_t>(1, 2 * workers.size());
+    try {
+        for (uint64_t decoded = 0; decoded < max_blocks; decoded++) {
+            if (pending_blocks.size() == max_pending) {
+                writeDecodedBlock(output);
+            }
+            StageTimer read(stats, READ_STAGE);
+            BlockHeader header = readBlockHeader(input, coded_size);
+            if (header.type == END_BLOCK) {
+                break;
+            }
+            std::unique_ptr<StreamBlock> block = takeBlock();
+            block->text_size = header.text_size;
+            block->type = header.type;
+            block->checked = header.checked;
+            block->checksum = header.checksum;
+            block->number = first_block + decoded;
+            StreamBlock* job = block.get();
+            pending_blocks.push_back(std::move(block));
+            // the payload grows only as its bytes arrive, so a header
+            // claiming more than the stream holds costs no more memory 
+            // than the stream does, however many blocks are pending
+            if (not input.readExactly(job->payload, header.payload_size)) {
+                throw std::runtime_error("Zapped block stream is truncated.");
+            }
+            read.stop();
+            job->done = workers.submit(
+                            [this, job, &transforms, block_size]() { 
+                decodeBlock(*job);
+                if (not transforms.empty()) {
+                    StageTimer transform(job->stats, TRANSFORM_STAGE);
+                    inverseTransforms(transforms, job->text, job->text_size,
+                                      block_size, job->scratch);
+                }
+                if (job->checked) {
+                    checkBlock(*job);
+                }
+            });
+        }
+        while (not pending_blocks.empty()) {
+            writeDecodedBlock(output);
+        }
+    } catch (...) {
+        abandonBlocks();
+        throw;
     }
+}
 
-    // Create an output string stream. This stream will hold the 
-    //contents of the file
-    // in memory, allowing us to convert it to a string later.
-    std::ostringstream buffer;
-    // Use the stream buffer's member function .rdbuf() to obtain a pointer to 
-    // file's buffer. Then, use the << operator to read the entire buffer into
-    // the ostringstream buffer. This efficiently transfers the file's content
-    // into the string stream.
-    buffer << file.rdbuf(); 
-    file.close();
+/**
+ * name:       checkBlock
+ * purpose:    Checks a decoded block against the checksum it was stored
+ *             with.
+ * arguments:  block - a block decoded by decodeBlock, with any transforms
+ *             undone.
+ * returns:    void
+ * effects:    Throws a runtime_error naming the block if its text does not
+ *             match.
+ */
+void HuffmanCoder::checkBlock(StreamBlock& block) {
+    StageTimer checksum(block.stats, CHECKSUM_STAGE);
+    if (crc32c(reinterpret_cast<const unsigned char *>(block.text.data()),
+               block.text.size()) != block.checksum) {
+        throw std::runtime_error("Zapped block " + 
+                                 std::to_string(block.number) + 
+                                 " does not match its checksum.");
+    }
+}
 
-    return buffer.str();
+/**
+ * name:       writeDecodedBlock
+ * purpose:    Waits for the oldest block being decoded and writes it out.
+ * arguments:  output - the file to write the decoded text to.
+ * returns:    void
+ * effects:    Moves the oldest block from pending_blocks to spare_blocks.
+ *             Rethrows anything its decoding threw.
+ */
+void HuffmanCoder::writeDecodedBlock(FileWriter& output) {
+    std::unique_ptr<StreamBlock> block = std::move(pending_blocks.front());
+    pending_blocks.pop_front();
+    spare_blocks.push_back(std::move(block));
+    StreamBlock& finished = *spare_blocks.back();
+    finished.done.get();
+    stats.add(finished.stats);
+    StageTimer write(stats, WRITE_STAGE);
+    output.write(finished.text);
 }
 
 /**
- * name:       deleteHuffmanTree
- * purpose:    Recursively deletes a Huffman tree to free allocated memory.
- * arguments:  root - a pointer to the root of the Huffman tree to be deleted.
+ * name:       decodeBlock
+ * purpose:    Decodes one block payload written by encodeBlock.
+ * arguments:  block - a block whose type, payload and text_size are 
+ *             filled in.
  * returns:    void
- * effects:    Recursively frees the memory allocated for the Huffman tree.
+ * effects:    Sets the block's text to the decoded bytes. Throws a 
+ *             runtime_error if the payload is malformed or its bits do not
+ *             decode to text_size bytes.
  */
-void HuffmanCoder::deleteHuffmanTree(HuffmanTreeNode* root) {
-    if (not root) { // if current node = nullptr
-        return; 
+void HuffmanCoder::decodeBlock(StreamBlock& block) {
+    block.stats = CoderStats();
+    block.stats.blocks = 1;
+    if (block.type == RAW_BLOCK or block.type == RUN_BLOCK) {
+        StageTimer decode(block.stats, DECODE_STAGE);
+        uint64_t payload_size = (block.type == RAW_BLOCK) ? block.text_size 
+                                                          : 1;
+        if (block.payload.size() != payload_size) {
+            throw std::runtime_error("Zapped block stream is malformed.");
+        }
+        if (block.type == RAW_BLOCK) {
+            block.text.swap(block.payload); // both buffers are kept
+        } else {
+            block.text.assign(block.text_size, block.payload[0]);
+        }
+        return;
+    }
+    if (block.type == CONTEXT_BLOCK) {
+        decodeContextBlock(block);
+        return;
+    }
+    const std::string& payload = block.payload;
+    size_t pos = 0;
+    StageTimer build(block.stats, BUILD_STAGE);
+    CodeLengths lengths = deserializeCodeLengths(payload, pos);
+    int streams = (block.type == INTERLEAVED_BLOCK) ? INTERLEAVED_STREAMS : 1;
+    // the sizes of all but the last stream follow the code lengths
+    uint64_t sizes[INTERLEAVED_STREAMS] = {0};
+    for (int k = 0; k < streams - 1; k++) {
+        sizes[k] = getVarint(payload, pos);
+    }
+    HuffmanDecodeTable& table = block.table;
+    table.build(canonicalCodes(lengths));
+    build.stop();
+    block.stats.max_code_length = table.maxCodeLength();
+    const unsigned char* bytes = 
+                reinterpret_cast<const unsigned char *>(payload.data());
+    std::vector<BitReader>& readers = block.readers;
+    readers.clear();
+    for (int k = 0; k < streams; k++) {
+        uint64_t left = payload.size() - pos;
+        uint64_t stream_bytes = (k < streams - 1) ? sizes[k] : left;
+        // stream k holds bytes k, k + streams, k + 2 * streams, ...
+        uint64_t stream_text = (block.text_size + streams - 1 - k) / streams;
+        if (stream_bytes > left) {
+            throw std::runtime_error("Zapped block stream is malformed.");
+        }
+        if (stream_text > stream_bytes * 8) { // every code is at least a bit
+            throw std::runtime_error("Encoding did not match Huffman tree.");
+        }
+        readers.emplace_back(bytes + pos, stream_bytes, stream_bytes * 8);
+        pos += stream_bytes;
+    }
+    StageTimer decode(block.stats, DECODE_STAGE);
+    block.text.clear();
+    if (streams == 1) {
+        table.decode(readers[0], block.text_size, block.text);
+    } else {
+        table.decodeInterleaved(readers.data(), streams, block.text_size, 
+                                block.text);
+    }
+}
+
+/**
+ * name:       decodeContextBlock
+ * purpose:    Decodes the payload of a CONTEXT_BLOCK.
+ * arguments:  block - a block whose payload and text_size are filled in.
+ * returns:    void
+ * effects:    Sets the block's text to the decoded bytes, rebuilding its
+ *             context tables. Throws a runtime_error if the payload is 
+ *             malformed or its bits do not decode to text_size bytes.
+ */
+void HuffmanCoder::decodeContextBlock(StreamBlock& block) {
+    const std::string& payload = block.payload;
+    size_t pos = 0;
+    int clusters = 0;
+    StageTimer build(block.stats, BUILD_STAGE);
+    ContextMap cluster_of = deserializeContextMap(payload, pos, clusters);
+    block.context_tables.resize(clusters);
+    for (int k = 0; k < clusters; k++) {
+        CodeLengths lengths = deserializeCodeLengths(payload, pos);
+        block.context_tables[k].build(canonicalCodes(lengths));
+        block.stats.max_code_length = std::max(block.stats.max_code_length,
+                                    block.context_tables[k].maxCodeLength());
+    }
+    build.stop();
+    const HuffmanDecodeTable* tables_by_context[256];
+    for (int context = 0; context < 256; context++) {
+        tables_by_context[context] = &block.context_tables[cluster_of[context]];
+    }
+    uint64_t stream_bytes = payload.size() - pos;
+    if (block.text_size > stream_bytes * 8) { // every code is at least a bit
+        throw std::runtime_error("Encoding did not match Huffman tree.");
     }
-    // recursively delete the tree w/ preorder traversal
-    deleteHuffmanTree(root->get_left());
-    deleteHuffmanTree(root->get_right());
-    delete root;
+    BitReader reader(reinterpret_cast<const unsigned char *>(payload.data())
+                                    + pos, stream_bytes, stream_bytes * 8);
+    StageTimer decode(block.stats, DECODE_STAGE);
+    block.text.clear();
+    HuffmanDecodeTable::decodeWithContexts(reader, tables_by_context, 
+                                           block.text_size, block.text);
 }
@@ -3,7 +3,10 @@
  * Description: Defines the HuffmanCoder class for encoding and decoding text 
  * files using Huffman coding. This class is responsible for building Huffman 
  * trees, generating codes for each character, and handling the serialization 
- * and deserialization of Huffman trees.
+ * and deserialization of Huffman trees. It can also code memory buffers, 
+ * and StreamEncoder zaps text that arrives a piece at a time; both keep 
+ * their buffers from call to call, so a long-lived coder stops allocating
+ * once it has warmed up. A coder handles one call at a time.
  * Author: Weston Starbird
  * Date: 2024-04-03
  */
@@ -11,43 +14,260 @@
 #ifndef HUFFMANCODER_H
 #define HUFFMANCODER_H
 
+#include <cstddef>
+#include <deque>
+#include <future>
+#include <memory>
+#include <ostream>
 #include <string>
-#include <unordered_map>
+#include <vector>
 #include "HuffmanTreeNode.h"
+#include "TreeArena.h"
+#include "BitIO.h"
+#include "HuffmanCode.h"
+#include "FileIO.h"
+#include "BlockFormat.h"
+#include "BlockTransform.h"
+#include "Dictionary.h"
+#include "HuffmanDecodeTable.h"
+#include "ThreadPool.h"
+#include "CoderStats.h"
+
+/* Settings that choose how encoder writes its output. The defaults write
+ * the original "ZAP" layout; decoder recognizes every layout on its own. */
+struct CoderOptions {
+    // write canonical codes with a code-length header instead of the
+    // serialized tree
+    bool canonical = false;
+    // longest code word allowed, 1 to 63; 0 leaves codes unconstrained
+    int max_code_length = 0;
+    // write a "ZBLK" stream of blocks of this many bytes; 0 keeps the 
+    // single-block layouts, except that stdin is always read as a stream
+    uint64_t block_size = 0;
+    // blocks coded at once; more than 1 selects the "ZBLK" stream, and 0
+    // uses every hardware thread
+    int jobs = 1;
+    // split each block's bits into INTERLEAVED_STREAMS streams that decode
+    // side by side; selects the "ZBLK" stream
+    bool interleave = false;
+    // cut blocks where the byte distribution changes, so each part gets
+    // its own code; selects the "ZBLK" stream
+    bool split_blocks = false;
+    // also try an order-1 model, coding each byte with a table picked by
+    // the byte before it, and keep it for blocks it makes smaller; 
+    // selects the "ZBLK" stream
+    bool context_model = false;
+    // run every block through these transforms before coding it, for a
+    // "ZBLT" stream; empty codes the text as it is
+    TransformPipeline transforms;
+    // write an adaptive "ZADP" stream instead, coding each segment of at
+    // most this many bytes as soon as it is read, with a code rebuilt from
+    // the segments before it, so output starts before the input ends; 0
+    // leaves it off. Overrides the layout options above except 
+    // max_code_length (not used by StreamEncoder)
+    uint64_t adaptive_interval = 0;
+    // code with this trained dictionary and write a "ZMSG" message, which
+    // stores no code of its own; overrides the layout options above (not
+    // used by StreamEncoder). Needed to decode such messages. Not owned, 
+    // so it must outlive the coder
+    const Dictionary* dictionary = nullptr;
+    // store a CRC-32C of each block's text in a block stream, which the
+    // decoder checks; false writes blocks older decoders can read
+    bool block_checksums = true;
+    // read and write files on threads of their own, so reading, coding
+    // and writing overlap instead of taking turns; false does all I/O on
+    // the calling thread
+    bool pipelined_io = true;
+    // print progress messages ("Success! ...") to stderr even when stdout
+    // carries no data, so stdout holds only a machine-read report such as
+    // --stats=json
+    bool messages_to_stderr = false;
+};
 
 class HuffmanCoder {
 public:
+    HuffmanCoder();
+    explicit HuffmanCoder(const CoderOptions& options);
+
     void encoder(const std::string& input_file, const std::string& output_file);
     void decoder(const std::string& input_file, const std::string& output_file);
 
+    void compress(const unsigned char* text, size_t size,
+        std::vector<unsigned char>& zapped);
+    void decompress(const unsigned char* zapped, size_t size,
+        std::vector<unsigned char>& text);
+
+    void decodeRange(const std::string& input_file,
+        const std::string& output_file, uint64_t start, uint64_t length);
+    void decompressRange(const unsigned char* zapped, size_t size,
+        uint64_t start, uint64_t length, std::vector<unsigned char>& text);
+
+    uint64_t bytesRead() const;
+
+    const CoderStats& statistics() const;
+
 private:
-    std::unordered_map<char, int> countCharFrequencies(
-        const std::string& input_file);
+    friend class StreamEncoder;
+    // the benchmark suite times the tree-based build and code walk
+    friend class CoderKernels;
+
+    FrequencyTable countCharFrequencies(const unsigned char* input_text,
+        size_t size);
     
-    HuffmanTreeNode* buildHuffmanTree(const std::unordered_map<char,
-        int>& char_frequencies);
+    HuffmanTreeNode* buildHuffmanTree(const FrequencyTable& char_frequencies,
+        TreeArena& arena);
     
-    void generateCharCodes(
-        const HuffmanTreeNode* root, std::unordered_map<char, 
-        std::string>& char_codes, std::string code = "");
+    void generateCharCodes(const HuffmanTreeNode* root, CodeTable& char_codes,
+        uint64_t bits = 0, int length = 0);
     
-    std::string encodeText(const std::string& input_text, 
-        const std::unordered_map<char, std::string>& char_codes);
+    void encodeText(const std::string& input_text, const CodeTable& codes,
+        BitWriter& writer);
+
+    void encodeText(const unsigned char* input_text, size_t size,
+        const CodeTable& codes, BitWriter& writer);
+
+    uint64_t encodeToFile(const unsigned char* input_text, size_t size,
+        const CodeTable& codes, const std::string& header,
+        FileWriter& output);
 
     std::string serializeHuffmanTree(const HuffmanTreeNode* root);
 
-    HuffmanTreeNode* deserializeHuffmanTree(const std::string& serialized_tree);
+    HuffmanTreeNode* deserializeHuffmanTree(const std::string& serialized_tree,
+        TreeArena& arena);
+
+    std::string decodeText(BitReader &reader, const HuffmanTreeNode *root);
+
+    HuffmanTreeNode* limitCodeLengths(HuffmanTreeNode* root,
+        const FrequencyTable& frequencies, TreeArena& arena);
+
+    std::string canonicalHeader(const CodeLengths& lengths,
+        uint64_t text_length);
+
+    void decodeWhole(const unsigned char* zapped, size_t size,
+        const std::string& input_file, FileWriter& output);
+
+    void decodeBuffer(const unsigned char* zapped, size_t size,
+        const std::string& input_file, FileWriter& output);
+
+    void decodeBufferRange(const unsigned char* zapped, size_t size,
+        const std::string& input_file, uint64_t start, uint64_t length,
+        FileWriter& output);
+
+    void decodeCanonical(const unsigned char* zapped, size_t size,
+        const std::string& header, FileWriter& output);
+
+    void decodeBits(const HuffmanDecodeTable& table, const unsigned char* bits,
+        size_t size, uint64_t text_length, FileWriter& output);
+
+    std::string messageHeader(uint64_t text_length) const;
+
+    uint64_t encodeMessage(const unsigned char* input_text, size_t size,
+        FileWriter& output);
+
+    void decodeMessage(const unsigned char* zapped, size_t size,
+        const std::string& header, FileWriter& output);
+
+    void decodeLegacy(const unsigned char* zapped, size_t size,
+        const std::string& input_file, FileWriter& output);
+
+    void encodeMappedStream(const MappedFile& input, 
+        const std::string& output_file);
+
+    uint64_t encodeStream(FileReader& input, FileWriter& output);
+
+    uint64_t encodeAdaptive(FileReader& input, FileWriter& output);
+
+    void decodeAdaptive(FileReader& input, FileWriter& output);
+
+    void writeStreamEnd(FileWriter& output);
+
+    uint64_t encodeBlocks(FileReader& input, FileWriter& output,
+        uint64_t block_size);
+
+    uint64_t streamBlockSize() const;
+
+    CodeLengths blockCodeLengths(const FrequencyTable& frequencies);
+
+    /* One block of a stream and its buffers, while it is being coded. */
+    struct StreamBlock {
+        std::string text;
+        uint64_t text_size = 0;
+        // text_size before the transforms, for the index
+        uint64_t source_size = 0;
+        BlockType type = HUFFMAN_BLOCK;
+        // the CRC-32C of the text before the transforms, and whether the
+        // block has one
+        uint32_t checksum = 0;
+        bool checked = false;
+        // where the block is in its stream, for error messages
+        uint64_t number = 0;
+        std::string payload;
+        // one writer per stream; only the first is used unless interleaved
+        BitWriter encoded_bits[INTERLEAVED_STREAMS];
+        uint64_t num_bits = 0;
+        // decoding state, rebuilt for each block in the same memory
+        HuffmanDecodeTable table;
+        std::vector<BitReader> readers;
+        // order-1 statistics and tables, for CONTEXT_BLOCK blocks
+        std::vector<FrequencyTable> context_counts;
+        std::vector<HuffmanDecodeTable> context_tables;
+        // the buffer the transforms swap with text
+        std::string scratch;
+        // the block's stage times and counters, added to stats when it is
+        // written
+        CoderStats stats;
+        std::future<void> done;
+    };
+
+    void encodeBlock(StreamBlock& block);
+
+    bool encodeContextBlock(StreamBlock& block, uint64_t order0_bytes);
+
+    void encodeInterleaved(const unsigned char* input_text, size_t size,
+        const CodeTable& codes, BitWriter* writers);
+
+    uint64_t writeEncodedBlock(FileWriter& output);
+
+    std::unique_ptr<StreamBlock> takeBlock();
+
+    void abandonBlocks();
+
+    size_t workerThreads() const;
+
+    void startFileThreads(FileReader* input, FileWriter& output) const;
+
+    ThreadPool& workerPool();
+
+    void decodeStream(FileReader& input, FileWriter& output, 
+        bool transformed);
+
+    void decodeBlocks(FileReader& input, FileWriter& output,
+        const TransformPipeline& transforms, uint64_t block_size,
+        uint64_t first_block, uint64_t max_blocks);
 
-    HuffmanTreeNode* deserializeHuffmanTreeHelper(
-        const std::string &serialized_tree, int &index);
+    void decodeContextBlock(StreamBlock& block);
 
-    std::string decodeText(const std::string &encoded_text, 
-        const HuffmanTreeNode *root);
+    void checkBlock(StreamBlock& block);
 
-    std::string readFileContents(const std::string &input_file);
+    void writeDecodedBlock(FileWriter& output);
 
-    void deleteHuffmanTree(HuffmanTreeNode *root);
+    void decodeBlock(StreamBlock& block);
 
+    CoderOptions options;
+    uint64_t bytes_read;
+    // timings and counters of the last encoder, decoder, compress or 
+    // decompress call
+    CoderStats stats;
+    // where progress messages go; stderr when stdout carries output
+    std::ostream* messages;
+    // blocks being coded, oldest first, and blocks whose buffers are kept
+    // for reuse; pending_blocks is empty between calls
+    std::deque<std::unique_ptr<StreamBlock>> pending_blocks;
+    std::vector<std::unique_ptr<StreamBlock>> spare_blocks;
+    // the blocks written so far to the stream being encoded
+    BlockIndex block_index;
+    // made on first use and kept, so later calls start no threads
+    std::unique_ptr<ThreadPool> pool;
 };
 
 #endif
\ No newline at end of file
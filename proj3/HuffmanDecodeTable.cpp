@@ -0,0 +1,443 @@
+/**
+ * File: HuffmanDecodeTable.cpp
+ * Description: Implements the HuffmanDecodeTable class. Each code shorter
+ * than a level's width is replicated into every slot that starts with it,
+ * so one lookup on the next bits finds the code and its length.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#include "HuffmanDecodeTable.h"
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+
+/**
+ * name:       collectTreeCodes
+ * purpose:    Records the code word of every leaf below ++node++.
+ * arguments:  node - the subtree to walk.
+ *             bits - the code of ++node++ so far.
+ *             length - the depth of ++node++.
+ *             codes - the table that receives the codes.
+ * returns:    void
+ * effects:    Throws a runtime_error on an internal node that is missing a
+ *             child.
+ */
+static void collectTreeCodes(const HuffmanTreeNode* node, uint64_t bits,
+                             int length, CodeTable& codes) {
+    if (node->isLeaf()) {
+        unsigned char symbol = static_cast<unsigned char>(node->get_val());
+        codes[symbol].bits = bits;
+        codes[symbol].length = length;
+        return;
+    }
+    if (not node->get_left() or not node->get_right() or length >= 64) {
+        throw std::runtime_error("Huffman tree is malformed.");
+    }
+    // left = 0, right = 1
+    collectTreeCodes(node->get_left(), bits << 1, length + 1, codes);
+    collectTreeCodes(node->get_right(), (bits << 1) | 1, length + 1, codes);
+}
+
+// the fewest bits a refill leaves buffered, which bounds how many codes
+// the specialized loops decode per refill
+static const int REFILL_BITS = 56;
+
+/**
+ * name:       HuffmanDecodeTable
+ * purpose:    Constructs an empty table.
+ * arguments:  none
+ * returns:    n/a
+ * effects:    None; build() must be called before decode().
+ */
+HuffmanDecodeTable::HuffmanDecodeTable() : primary_width(0), max_length(0) {}
+
+/**
+ * name:       build
+ * purpose:    Builds the lookup tables for a set of code words.
+ * arguments:  codes - the code word of each byte; length 0 for unused
+ *             bytes. The codes must be prefix free.
+ * returns:    void
+ * effects:    Replaces any previous tables. Throws a runtime_error if no
+ *             code is given or if two codes collide.
+ */
+void HuffmanDecodeTable::build(const CodeTable& codes) {
+    std::vector<PendingCode> pending;
+    max_length = 0;
+    for (int symbol = 0; symbol < 256; symbol++) {
+        if (codes[symbol].length > 0) {
+            pending.push_back({codes[symbol].bits, codes[symbol].length,
+                               static_cast<unsigned char>(symbol)});
+            max_length = std::max(max_length, codes[symbol].length);
+        }
+    }
+    if (pending.empty()) {
+        throw std::runtime_error("Huffman tree is empty.");
+    }
+    entries.clear();
+    primary_width = std::min(max_length, PRIMARY_BITS);
+    buildLevel(pending, primary_width);
+}
+
+/**
+ * name:       build
+ * purpose:    Builds the lookup tables for the codes of a Huffman tree.
+ * arguments:  root - a pointer to the root of the Huffman tree.
+ * returns:    void
+ * effects:    Replaces any previous tables. A tree that is a single leaf
+ *             gets the one-bit code "0", matching encodeText. Throws a
+ *             runtime_error if the tree is empty or malformed.
+ */
+void HuffmanDecodeTable::build(const HuffmanTreeNode* root) {
+    if (not root) throw std::runtime_error("Huffman tree is empty.");
+    CodeTable codes = {};
+    if (root->isLeaf()) {
+        codes[static_cast<unsigned char>(root->get_val())] = {0, 1};
+    } else {
+        collectTreeCodes(root, 0, 0, codes);
+    }
+    build(codes);
+}
+
+/**
+ * name:       decode
+ * purpose:    Decodes every remaining bit of a reader.
+ * arguments:  reader - a BitReader positioned at the encoded bits.
+ *             decoded_text - the string the decoded bytes are appended to.
+ * returns:    void
+ * effects:    Consumes the reader. Throws a runtime_error if the bits do
+ *             not match the codes or end in the middle of a code.
+ */
+void HuffmanDecodeTable::decode(BitReader& reader,
+                                std::string& decoded_text) const {
+    // every code is at least one bit, so the limit is never reached
+    decodeAtMost(reader, reader.bitsRemaining(), decoded_text);
+}
+
+/**
+ * name:       decode
+ * purpose:    Decodes a known number of bytes from a reader.
+ * arguments:  reader - a BitReader positioned at the encoded bits.
+ *             count - the number of bytes to decode.
+ *             decoded_text - the string the decoded bytes are appended to.
+ * returns:    void
+ * effects:    Leaves any bits after the last code (padding) unconsumed.
+ *             Throws a runtime_error if the bits do not match the codes or
+ *             run out before ++count++ bytes are decoded.
+ */
+void HuffmanDecodeTable::decode(BitReader& reader, uint64_t count,
+                                std::string& decoded_text) const {
+    size_t start = decoded_text.size();
+    decoded_text.resize(start + count);
+    char* out = &decoded_text[start];
+    switch (kernelLength()) {
+    case 11: decodeKernel<11>(reader, count, out); return;
+    case 12: decodeKernel<12>(reader, count, out); return;
+    case 15: decodeKernel<15>(reader, count, out); return;
+    }
+    BitReader local = reader; // kept in registers; see decodeInterleaved
+    for (uint64_t i = 0; i < count; i++) {
+        out[i] = static_cast<char>(decodeSymbol(local));
+    }
+    reader = local;
+}
+
+/**
+ * name:       decodeAtMost
+ * purpose:    Decodes from a reader until it runs out of bits or ++limit++
+ *             bytes have been decoded, so long inputs can be decoded in
+ *             pieces of bounded size.
+ * arguments:  reader - a BitReader positioned at the encoded bits.
+ *             limit - the most bytes to decode.
+ *             decoded_text - the string the decoded bytes are appended to.
+ * returns:    The number of bytes decoded; less than ++limit++ only when
+ *             the reader is exhausted.
+ * effects:    Decodes in runs short enough that the bits cannot run out
+ *             part way, each through decode() into space sized up front,
+ *             and only the last few codes one at a time. Throws a 
+ *             runtime_error if the bits do not match the codes or end in 
+ *             the middle of a code.
+ */
+uint64_t HuffmanDecodeTable::decodeAtMost(BitReader& reader, uint64_t limit,
+                                          std::string& decoded_text) const {
+    uint64_t decoded = 0;
+    while (decoded < limit and reader.bitsRemaining() > 0) {
+        // no code is longer than max_length, so this many codes are all
+        // there, however short they turn out to be
+        uint64_t run = std::min(limit - decoded,
+                                reader.bitsRemaining() / max_length);
+        if (run == 0) {
+            decoded_text += static_cast<char>(decodeSymbol(reader));
+            decoded++;
+            continue;
+        }
+        decode(reader, run, decoded_text);
+        decoded += run;
+    }
+    return decoded;
+}
+
+/**
+ * name:       decodeInterleaved
+ * purpose:    Decodes bytes that were dealt round-robin over several 
+ *             streams: byte i comes from stream i % ++streams++.
+ * arguments:  readers - one BitReader per stream.
+ *             streams - the number of readers; 4 takes the fast path.
+ *             count - the total number of bytes to decode.
+ *             decoded_text - the string the decoded bytes are appended to.
+ * returns:    void
+ * effects:    The four-stream loop decodes one byte from each reader per 
+ *             iteration; the readers do not depend on each other, so the
+ *             CPU can work on all four lookups at once. Throws a 
+ *             runtime_error if the bits do not match the codes or a 
+ *             stream runs out early.
+ */
+void HuffmanDecodeTable::decodeInterleaved(BitReader* readers, int streams,
+                    uint64_t count, std::string& decoded_text) const {
+    size_t start = decoded_text.size();
+    decoded_text.resize(start + count);
+    char* out = &decoded_text[start];
+    uint64_t i = 0;
+    if (streams == 4) {
+        switch (kernelLength()) {
+        case 11: i = decodeKernel4<11>(readers, count, out); break;
+        case 12: i = decodeKernel4<12>(readers, count, out); break;
+        case 15: i = decodeKernel4<15>(readers, count, out); break;
+        }
+        // local copies can live in registers; stores through out (a char
+        // pointer, which may alias anything) would otherwise force the
+        // readers to be reloaded from memory after every byte
+        BitReader r0 = readers[0], r1 = readers[1];
+        BitReader r2 = readers[2], r3 = readers[3];
+        for (; i + 4 <= count; i += 4) {
+            unsigned char s0 = decodeSymbol(r0);
+            unsigned char s1 = decodeSymbol(r1);
+            unsigned char s2 = decodeSymbol(r2);
+            unsigned char s3 = decodeSymbol(r3);
+            out[i] = static_cast<char>(s0);
+            out[i + 1] = static_cast<char>(s1);
+            out[i + 2] = static_cast<char>(s2);
+            out[i + 3] = static_cast<char>(s3);
+        }
+        readers[0] = r0;
+        readers[1] = r1;
+        readers[2] = r2;
+        readers[3] = r3;
+    }
+    for (; i < count; i++) {
+        out[i] = static_cast<char>(decodeSymbol(readers[i % streams]));
+    }
+}
+
+/**
+ * name:       maxCodeLength
+ * purpose:    Reports the length of the longest code in the table.
+ * arguments:  none
+ * returns:    The longest code length, or 0 before build().
+ * effects:    None.
+ */
+int HuffmanDecodeTable::maxCodeLength() const {
+    return max_length;
+}
+
+/**
+ * name:       kernelLength
+ * purpose:    Reports which specialized loop decode() and
+ *             decodeInterleaved() use for this table.
+ * arguments:  none
+ * returns:    The code length limit the loop was compiled for: 11, 12 or
+ *             15, the smallest that holds maxCodeLength(); 0 if the codes
+ *             are longer than 15 bits and the generic loop is used.
+ * effects:    None.
+ */
+int HuffmanDecodeTable::kernelLength() const {
+    if (max_length == 0 or max_length > 15) {
+        return 0;
+    }
+    return max_length <= 11 ? 11 : (max_length <= 12 ? 12 : 15);
+}
+
+/**
+ * name:       decodeSymbolFast
+ * purpose:    Decodes one code word whose bits are already buffered.
+ * arguments:  reader - a BitReader holding at least MAX_LENGTH buffered,
+ *             meaningful bits.
+ * returns:    The decoded byte.
+ * effects:    Consumes the code word. With MAX_LENGTH at most PRIMARY_BITS
+ *             every code is in the primary table, so the check for a link
+ *             is compiled out. Throws a runtime_error if the bits match no
+ *             code.
+ */
+template <int MAX_LENGTH>
+ZAP_ALWAYS_INLINE unsigned char
+HuffmanDecodeTable::decodeSymbolFast(BitReader& reader) const {
+    int width = primary_width;
+    const Entry* entry = &entries[reader.peekFast(width)];
+    if (MAX_LENGTH > PRIMARY_BITS) {
+        while (entry->is_link) { // the widths add up to at most the code
+            reader.consumeFast(width);
+            width = entry->length;
+            entry = &entries[entry->value + reader.peekFast(width)];
+        }
+    }
+    if (entry->length == 0) {
+        throw std::runtime_error("Encoding did not match Huffman tree.");
+    }
+    reader.consumeFast(entry->length);
+    return static_cast<unsigned char>(entry->value);
+}
+
+/**
+ * name:       decodeKernel
+ * purpose:    Decodes a known number of bytes from a table whose codes are
+ *             at most MAX_LENGTH bits long.
+ * arguments:  reader - a BitReader positioned at the encoded bits.
+ *             count - the number of bytes to decode.
+ *             out - where the ++count++ bytes go.
+ * returns:    void
+ * effects:    As decode(BitReader&, uint64_t, std::string&). While enough
+ *             bits remain, refills once per REFILL_BITS / MAX_LENGTH codes
+ *             and decodes them with no other checks, in a loop the
+ *             compiler unrolls; the last few bytes take the checked path.
+ */
+template <int MAX_LENGTH>
+void HuffmanDecodeTable::decodeKernel(BitReader& reader, uint64_t count,
+                                      char* out) const {
+    const int group = REFILL_BITS / MAX_LENGTH;
+    BitReader local = reader; // kept in registers; see decodeInterleaved
+    uint64_t i = 0;
+    for (; i + group <= count and local.canTakeFast(group * MAX_LENGTH);
+         i += group) {
+        local.refillFast();
+        for (int k = 0; k < group; k++) {
+            out[i + k] = static_cast<char>(decodeSymbolFast<MAX_LENGTH>(local));
+        }
+    }
+    for (; i < count; i++) {
+        out[i] = static_cast<char>(decodeSymbol(local));
+    }
+    reader = local;
+}
+
+/**
+ * name:       decodeKernel4
+ * purpose:    Decodes four interleaved streams, as decodeInterleaved does,
+ *             from a table whose codes are at most MAX_LENGTH bits long.
+ * arguments:  readers - the four BitReaders.
+ *             count - the total number of bytes to decode.
+ *             out - where the bytes go.
+ * returns:    The number of bytes decoded, a multiple of 4; the caller
+ *             decodes the rest.
+ * effects:    Refills each reader once per REFILL_BITS / MAX_LENGTH of its
+ *             codes. Throws a runtime_error if the bits match no code.
+ */
+template <int MAX_LENGTH>
+uint64_t HuffmanDecodeTable::decodeKernel4(BitReader* readers,
+                                           uint64_t count, char* out) const {
+    const int group = REFILL_BITS / MAX_LENGTH;
+    const uint64_t group_bits = group * MAX_LENGTH;
+    BitReader r0 = readers[0], r1 = readers[1];
+    BitReader r2 = readers[2], r3 = readers[3];
+    uint64_t i = 0;
+    for (; i + 4 * group <= count and r0.canTakeFast(group_bits) and
+           r1.canTakeFast(group_bits) and r2.canTakeFast(group_bits) and
+           r3.canTakeFast(group_bits); i += 4 * group) {
+        r0.refillFast();
+        r1.refillFast();
+        r2.refillFast();
+        r3.refillFast();
+        for (int k = 0; k < group; k++) {
+            unsigned char s0 = decodeSymbolFast<MAX_LENGTH>(r0);
+            unsigned char s1 = decodeSymbolFast<MAX_LENGTH>(r1);
+            unsigned char s2 = decodeSymbolFast<MAX_LENGTH>(r2);
+            unsigned char s3 = decodeSymbolFast<MAX_LENGTH>(r3);
+            out[i + 4 * k] = static_cast<char>(s0);
+            out[i + 4 * k + 1] = static_cast<char>(s1);
+            out[i + 4 * k + 2] = static_cast<char>(s2);
+            out[i + 4 * k + 3] = static_cast<char>(s3);
+        }
+    }
+    readers[0] = r0;
+    readers[1] = r1;
+    readers[2] = r2;
+    readers[3] = r3;
+    return i;
+}
+
+/**
+ * name:       buildLevel
+ * purpose:    Builds one table level and, recursively, the secondary
+ *             tables below it.
+ * arguments:  codes - the codes for this level, with the bits consumed by
+ *             earlier levels already removed.
+ *             width - the number of bits this level is indexed by.
+ * returns:    The index of the first slot of the new table.
+ * effects:    Appends to entries. Throws a runtime_error if two codes
+ *             collide.
+ */
+uint32_t HuffmanDecodeTable::buildLevel(const std::vector<PendingCode>& codes,
+                                        int width) {
+    uint32_t base = entries.size();
+    entries.resize(base + (size_t(1) << width), Entry{0, 0, false});
+    std::map<uint64_t, std::vector<PendingCode>> long_codes;
+    for (const PendingCode& code : codes) {
+        if (code.length <= width) {
+            uint64_t first = code.bits << (width - code.length);
+            uint64_t count = uint64_t(1) << (width - code.length);
+            for (uint64_t i = first; i < first + count; i++) {
+                if (entries[base + i].length != 0) {
+                    throw std::runtime_error("Huffman codes collide.");
+                }
+                entries[base + i] = Entry{code.symbol,
+                        static_cast<uint8_t>(code.length), false};
+            }
+        } else { // group long codes by the prefix this level consumes
+            int rest = code.length - width;
+            uint64_t prefix = code.bits >> rest;
+            uint64_t rest_bits = code.bits & ((uint64_t(1) << rest) - 1);
+            long_codes[prefix].push_back({rest_bits, rest, code.symbol});
+        }
+    }
+    for (const auto& group : long_codes) {
+        if (entries[base + group.first].length != 0) {
+            throw std::runtime_error("Huffman codes collide.");
+        }
+        int sub_width = 0;
+        for (const PendingCode& code : group.second) {
+            sub_width = std::max(sub_width, code.length);
+        }
+        sub_width = std::min(sub_width, SECONDARY_BITS);
+        uint32_t sub_base = buildLevel(group.second, sub_width);
+        entries[base + group.first] = Entry{sub_base,
+                        static_cast<uint8_t>(sub_width), true};
+    }
+    return base;
+}
+
+/**
+ * name:       decodeWithContexts
+ * purpose:    Decodes bytes each coded with the table of the byte before
+ *             it, as written by encodeWithContexts.
+ * arguments:  reader - a BitReader positioned at the encoded bits.
+ *             tables_by_context - the table for each previous byte.
+ *             count - the number of bytes to decode.
+ *             decoded_text - the string the decoded bytes are appended to.
+ * returns:    void
+ * effects:    Switching tables is one pointer load per byte; the first 
+ *             byte is decoded after a 0. Throws a runtime_error if the 
+ *             bits do not match the codes or run out early.
+ */
+void HuffmanDecodeTable::decodeWithContexts(BitReader& reader, 
+                    const HuffmanDecodeTable* const* tables_by_context,
+                    uint64_t count, std::string& decoded_text) {
+    size_t start = decoded_text.size();
+    decoded_text.resize(start + count);
+    char* out = &decoded_text[start];
+    BitReader local = reader; // kept in registers; see decodeInterleaved
+    unsigned char previous = 0;
+    for (uint64_t i = 0; i < count; i++) {
+        previous = tables_by_context[previous]->decodeSymbol(local);
+        out[i] = static_cast<char>(previous);
+    }
+    reader = local;
+}
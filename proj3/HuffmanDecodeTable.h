@@ -0,0 +1,108 @@
+/**
+ * File: HuffmanDecodeTable.h
+ * Description: Defines the HuffmanDecodeTable class, a multi-level lookup
+ * table that decodes a whole code word per lookup instead of walking a
+ * Huffman tree one bit at a time. The primary table is indexed by the next
+ * PRIMARY_BITS bits; longer codes continue in secondary tables. Tables
+ * whose codes are at most 11, 12 or 15 bits long decode through loops
+ * specialized for that limit, which refill the bit buffer once for as
+ * many codes as are sure to fit in it instead of checking before each.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#ifndef HUFFMANDECODETABLE_H
+#define HUFFMANDECODETABLE_H
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "BitIO.h"
+#include "HuffmanCode.h"
+#include "HuffmanTreeNode.h"
+
+class HuffmanDecodeTable {
+public:
+    static const int PRIMARY_BITS = 11;
+    static const int SECONDARY_BITS = 11;
+
+    HuffmanDecodeTable();
+
+    void build(const CodeTable& codes);
+    void build(const HuffmanTreeNode* root);
+
+    void decode(BitReader& reader, std::string& decoded_text) const;
+    void decode(BitReader& reader, uint64_t count,
+                std::string& decoded_text) const;
+    uint64_t decodeAtMost(BitReader& reader, uint64_t limit,
+                          std::string& decoded_text) const;
+    void decodeInterleaved(BitReader* readers, int streams, uint64_t count,
+                           std::string& decoded_text) const;
+    static void decodeWithContexts(BitReader& reader, 
+                    const HuffmanDecodeTable* const* tables_by_context,
+                    uint64_t count, std::string& decoded_text);
+
+    int maxCodeLength() const;
+    int kernelLength() const;
+
+private:
+    /* One table slot. A leaf holds a byte and how many of this level's
+     * bits its code uses; a link points at the secondary table for this
+     * prefix. A length of 0 marks a slot no valid code reaches. */
+    struct Entry {
+        uint32_t value;
+        uint8_t length;
+        bool is_link;
+    };
+
+    struct PendingCode {
+        uint64_t bits;
+        int length;
+        unsigned char symbol;
+    };
+
+    unsigned char decodeSymbol(BitReader& reader) const;
+    template <int MAX_LENGTH>
+    unsigned char decodeSymbolFast(BitReader& reader) const;
+    template <int MAX_LENGTH>
+    void decodeKernel(BitReader& reader, uint64_t count, char* out) const;
+    template <int MAX_LENGTH>
+    uint64_t decodeKernel4(BitReader* readers, uint64_t count,
+                           char* out) const;
+
+    uint32_t buildLevel(const std::vector<PendingCode>& codes, int width);
+
+    std::vector<Entry> entries;
+    int primary_width;
+    int max_length;
+};
+
+// decodeSymbol runs once per byte, so it is defined here to be inlined
+// into the decoding loops.
+
+/**
+ * name:       decodeSymbol
+ * purpose:    Decodes one code word.
+ * arguments:  reader - a BitReader positioned at the code word.
+ * returns:    The decoded byte.
+ * effects:    Consumes the code word. Throws a runtime_error if the bits
+ *             match no code or end in the middle of one.
+ */
+ZAP_ALWAYS_INLINE unsigned char
+HuffmanDecodeTable::decodeSymbol(BitReader& reader) const {
+    int width = primary_width;
+    const Entry* entry = &entries[reader.peek(width)];
+    while (entry->is_link) { // long code, continue in a secondary table
+        reader.consume(width);
+        width = entry->length;
+        entry = &entries[entry->value + reader.peek(width)];
+    }
+    if (entry->length == 0) {
+        throw std::runtime_error("Encoding did not match Huffman tree.");
+    }
+    reader.consume(entry->length);
+    return static_cast<unsigned char>(entry->value);
+}
+
+#endif
@@ -0,0 +1,224 @@
+/**
+ * File: LengthLimit.cpp
+ * Description: Implements length-limited code lengths with the
+ * package-merge (coin collector) algorithm. The leaves are listed once per
+ * allowed length; at each level adjacent items are paired into packages
+ * and merged back in with the leaves. Taking the 2n - 2 cheapest items of
+ * the last list gives an optimal set of lengths: each byte's code length
+ * is the number of selected items it appears in. huffmanCodeLengths uses
+ * Moffat and Katajainen's in-place method on the sorted weights instead.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#include "LengthLimit.h"
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <vector>
+
+/* A leaf (symbol >= 0) or a package of two items from the previous list. */
+struct MergeItem {
+    uint64_t weight;
+    int symbol;
+    int left;
+    int right;
+};
+
+/**
+ * name:       countSelected
+ * purpose:    Adds one to the code length of every leaf inside an item.
+ * arguments:  lists - every package-merge list, deepest level first.
+ *             level - the list holding the item.
+ *             index - the position of the item in its list.
+ *             lengths - the code lengths being counted.
+ * returns:    void
+ * effects:    Modifies ++lengths++.
+ */
+static void countSelected(const std::vector<std::vector<MergeItem>> &lists,
+                          int level, int index, CodeLengths &lengths) {
+    const MergeItem &item = lists[level][index];
+    if (item.symbol >= 0) {
+        lengths[item.symbol]++;
+        return;
+    }
+    countSelected(lists, level - 1, item.left, lengths);
+    countSelected(lists, level - 1, item.right, lengths);
+}
+
+/**
+ * name:       huffmanCodeLengths
+ * purpose:    Finds optimal (unconstrained) prefix code lengths, the same
+ *             lengths a Huffman tree would give, with no tree and no heap
+ *             memory.
+ * arguments:  frequencies - the number of times each byte occurs.
+ * returns:    The code length of each byte that occurs; 0 for the rest. A
+ *             single distinct byte gets length 1, matching encodeText.
+ * effects:    Throws a runtime_error if no byte occurs.
+ */
+CodeLengths huffmanCodeLengths(const FrequencyTable &frequencies) {
+    std::array<std::pair<uint64_t, int>, 256> leaves;
+    int n = 0;
+    for (int symbol = 0; symbol < 256; symbol++) {
+        if (frequencies[symbol] > 0) {
+            leaves[n++] = {frequencies[symbol], symbol};
+        }
+    }
+    CodeLengths lengths = {};
+    if (n == 0) throw std::runtime_error("Huffman tree is empty.");
+    if (n == 1) {
+        lengths[leaves[0].second] = 1;
+        return lengths;
+    }
+    std::sort(leaves.begin(), leaves.begin() + n);
+    uint64_t a[256];
+    for (int i = 0; i < n; i++) {
+        a[i] = leaves[i].first;
+    }
+
+    // first pass, left to right: a[0..next) become internal nodes, each
+    // holding its weight until it is paired and then its parent's index;
+    // leaves are taken from a[leaf..n) and internal nodes from a[root..)
+    int root = 0, leaf = 2;
+    a[0] += a[1];
+    for (int next = 1; next < n - 1; next++) {
+        if (leaf >= n or a[root] < a[leaf]) {
+            a[next] = a[root];
+            a[root++] = next;
+        } else {
+            a[next] = a[leaf++];
+        }
+        if (leaf >= n or (root < next and a[root] < a[leaf])) {
+            a[next] += a[root];
+            a[root++] = next;
+        } else {
+            a[next] += a[leaf++];
+        }
+    }
+    // second pass, right to left: parent indices become internal depths
+    a[n - 2] = 0;
+    for (int next = n - 3; next >= 0; next--) {
+        a[next] = a[a[next]] + 1;
+    }
+    // third pass, right to left: the nodes free at each depth that are
+    // not internal are leaves, which get that depth as their length
+    int available = 1, used = 0, next = n - 1;
+    uint64_t depth = 0;
+    root = n - 2;
+    while (available > 0) {
+        while (root >= 0 and a[root] == depth) {
+            used++;
+            root--;
+        }
+        while (available > used) {
+            a[next--] = depth;
+            available--;
+        }
+        available = 2 * used;
+        depth++;
+        used = 0;
+    }
+    // the lightest leaf is first, so it gets the longest code
+    for (int i = 0; i < n; i++) {
+        lengths[leaves[i].second] = static_cast<uint8_t>(a[i]);
+    }
+    return lengths;
+}
+
+/**
+ * name:       lengthLimitedCodeLengths
+ * purpose:    Finds the optimal prefix code lengths no longer than a limit.
+ * arguments:  frequencies - the number of times each byte occurs.
+ *             max_length - the longest code allowed, from 1 to 63.
+ * returns:    The code length of each byte that occurs; 0 for the rest. A
+ *             single distinct byte gets length 1, matching encodeText.
+ * effects:    Throws a runtime_error if no byte occurs, if ++max_length++
+ *             is out of range, or if 2^max_length codes are too few for
+ *             the number of distinct bytes.
+ */
+CodeLengths lengthLimitedCodeLengths(const FrequencyTable &frequencies,
+                                     int max_length) {
+    if (max_length < 1 or max_length > 63) {
+        throw std::runtime_error("Maximum code length must be 1 to 63.");
+    }
+    std::vector<MergeItem> leaves;
+    for (int symbol = 0; symbol < 256; symbol++) {
+        if (frequencies[symbol] > 0) {
+            leaves.push_back({frequencies[symbol], symbol, -1, -1});
+        }
+    }
+    CodeLengths lengths = {};
+    if (leaves.empty()) throw std::runtime_error("Huffman tree is empty.");
+    if (leaves.size() == 1) {
+        lengths[leaves[0].symbol] = 1;
+        return lengths;
+    }
+    if (max_length < 63 and (uint64_t(1) << max_length) < leaves.size()) {
+        throw std::runtime_error("Maximum code length is too short for "
+                                        "the number of distinct bytes.");
+    }
+    std::stable_sort(leaves.begin(), leaves.end(),
+                     [](const MergeItem &a, const MergeItem &b) {
+                         return a.weight < b.weight;
+                     });
+
+    // lists[0] is the deepest level; each later list packages the one
+    // before it and merges the packages with the leaves again
+    std::vector<std::vector<MergeItem>> lists(max_length);
+    lists[0] = leaves;
+    for (int level = 1; level < max_length; level++) {
+        const std::vector<MergeItem> &previous = lists[level - 1];
+        std::vector<MergeItem> packages;
+        for (size_t i = 0; i + 1 < previous.size(); i += 2) {
+            packages.push_back({previous[i].weight + previous[i + 1].weight,
+                                -1, static_cast<int>(i),
+                                static_cast<int>(i + 1)});
+        }
+        std::vector<MergeItem> &merged = lists[level];
+        merged.reserve(leaves.size() + packages.size());
+        size_t l = 0, p = 0;
+        while (l < leaves.size() or p < packages.size()) {
+            // leaves win ties so shallower packages are preferred
+            if (p == packages.size() or (l < leaves.size() and
+                                leaves[l].weight <= packages[p].weight)) {
+                merged.push_back(leaves[l++]);
+            } else {
+                merged.push_back(packages[p++]);
+            }
+        }
+    }
+
+    int selected = 2 * static_cast<int>(leaves.size()) - 2;
+    for (int i = 0; i < selected; i++) {
+        countSelected(lists, max_length - 1, i, lengths);
+    }
+    return lengths;
+}
+
+/**
+ * name:       encodedBitCount
+ * purpose:    Computes how many bits a text takes under given code lengths.
+ * arguments:  frequencies - the number of times each byte occurs.
+ *             lengths - the code length of each byte.
+ * returns:    The sum of frequency times length over all bytes.
+ * effects:    None.
+ */
+uint64_t encodedBitCount(const FrequencyTable &frequencies,
+                         const CodeLengths &lengths) {
+    uint64_t bits = 0;
+    for (int symbol = 0; symbol < 256; symbol++) {
+        bits += frequencies[symbol] * lengths[symbol];
+    }
+    return bits;
+}
+
+/**
+ * name:       maxCodeLength
+ * purpose:    Finds the longest code length.
+ * arguments:  lengths - the code length of each byte.
+ * returns:    The largest entry of ++lengths++.
+ * effects:    None.
+ */
+int maxCodeLength(const CodeLengths &lengths) {
+    return *std::max_element(lengths.begin(), lengths.end());
+}
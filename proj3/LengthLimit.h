@@ -0,0 +1,29 @@
+/**
+ * File: LengthLimit.h
+ * Description: Declares the package-merge construction of length-limited
+ * Huffman codes. Unconstrained Huffman codes on skewed inputs can grow
+ * past 32 bits; limiting them lets every code word fit in a register for
+ * the packed writer and the lookup-table decoder, at a small cost in
+ * compression. Also declares huffmanCodeLengths, which finds unconstrained
+ * lengths straight from the frequencies without building a tree.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#ifndef LENGTHLIMIT_H
+#define LENGTHLIMIT_H
+
+#include <cstdint>
+#include "HuffmanCode.h"
+
+CodeLengths huffmanCodeLengths(const FrequencyTable &frequencies);
+
+CodeLengths lengthLimitedCodeLengths(const FrequencyTable &frequencies,
+                                     int max_length);
+
+uint64_t encodedBitCount(const FrequencyTable &frequencies,
+                         const CodeLengths &lengths);
+
+int maxCodeLength(const CodeLengths &lengths);
+
+#endif
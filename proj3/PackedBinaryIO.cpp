@@ -0,0 +1,196 @@
+/**
+ * File: PackedBinaryIO.cpp
+ * Description: Implements the PackedBinaryIO class. Files written here can
+ * be read by BinaryIO::readFile and vice versa.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#include "PackedBinaryIO.h"
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+static const std::string ZAP_MAGIC = "ZAP";
+
+/**
+ * name:       writeLength
+ * purpose:    Writes a 32-bit length field, least significant byte first.
+ * arguments:  out - the stream to write to.
+ *             value - the length to write.
+ * returns:    void
+ * effects:    Writes 4 bytes to ++out++.
+ */
+static void writeLength(std::ostream &out, uint32_t value) {
+    char bytes[4];
+    for (int i = 0; i < 4; i++) {
+        bytes[i] = static_cast<char>((value >> (8 * i)) & 0xff);
+    }
+    out.write(bytes, 4);
+}
+
+/**
+ * name:       readLength
+ * purpose:    Reads a 32-bit length field written by writeLength.
+ * arguments:  zapped - the bytes of the zapped file.
+ *             size - the number of bytes at ++zapped++.
+ *             pos - the position of the field; moved past it.
+ *             filename - the name of the file, for error messages.
+ * returns:    The length read.
+ * effects:    Throws a runtime_error if the file ends early.
+ */
+static uint32_t readLength(const unsigned char *zapped, size_t size,
+                           size_t &pos, const std::string &filename) {
+    if (size - pos < 4) {
+        throw std::runtime_error("Unexpected end of zap file " + filename);
+    }
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) {
+        value |= static_cast<uint32_t>(zapped[pos++]) << (8 * i);
+    }
+    return value;
+}
+
+/**
+ * name:       writeFile
+ * purpose:    Writes a zapped file from a serialized tree and packed bits.
+ * arguments:  filename - the path of the file to write.
+ *             serial_tree - the serialized Huffman tree.
+ *             bits - the encoded text. Must have been flushed.
+ * returns:    void
+ * effects:    Creates or overwrites ++filename++. Throws a runtime_error if
+ *             the file cannot be opened or if the tree or the bit count do
+ *             not fit the 32-bit length fields.
+ */
+void PackedBinaryIO::writeFile(const std::string &filename,
+                               const std::string &serial_tree,
+                               const BitWriter &bits) {
+    std::string header = fileHeader(serial_tree, bits.bitCount(), filename);
+    std::ofstream out;
+    open_or_die(out, filename);
+    out << header;
+    const std::string &packed = bits.bytes();
+    out.write(packed.data(), packed.size());
+    out.close();
+}
+
+/**
+ * name:       fileHeader
+ * purpose:    Lays out everything in a zapped file that comes before the
+ *             packed bits, so callers can stream the bits after it.
+ * arguments:  serial_tree - the serialized Huffman tree.
+ *             num_bits - the number of encoded bits that will follow.
+ *             filename - the name of the file, for error messages.
+ * returns:    The magic, the tree length, the tree and the bit count.
+ * effects:    Throws a runtime_error if the tree or the bit count do not
+ *             fit the 32-bit length fields.
+ */
+std::string PackedBinaryIO::fileHeader(const std::string &serial_tree,
+                                       uint64_t num_bits,
+                                       const std::string &filename) {
+    if (serial_tree.size() > UINT32_MAX or num_bits > UINT32_MAX) {
+        throw std::runtime_error("Encoding too large to write to " + filename);
+    }
+    std::ostringstream header;
+    header << ZAP_MAGIC;
+    writeLength(header, static_cast<uint32_t>(serial_tree.size()));
+    header << serial_tree;
+    writeLength(header, static_cast<uint32_t>(num_bits));
+    return header.str();
+}
+
+/**
+ * name:       readFile
+ * purpose:    Reads a zapped file without unpacking its bits.
+ * arguments:  filename - the path of the file to read.
+ * returns:    The serialized tree, the packed bits and the bit count.
+ * effects:    Throws a runtime_error if the file cannot be opened, is not a
+ *             zapped file, or is truncated.
+ */
+PackedZapFile PackedBinaryIO::readFile(const std::string &filename) {
+    std::ifstream in;
+    open_or_die(in, filename);
+    std::ostringstream contents;
+    contents << in.rdbuf();
+    return parseFile(contents.str(), filename);
+}
+
+/**
+ * name:       parseFile
+ * purpose:    Splits the bytes of a zapped file that is already in memory.
+ * arguments:  zapped - the contents of the zapped file.
+ *             filename - the name of the file, for error messages.
+ * returns:    The serialized tree, the packed bits and the bit count.
+ * effects:    Throws a runtime_error if ++zapped++ is not a zapped file or
+ *             is truncated.
+ */
+PackedZapFile PackedBinaryIO::parseFile(const std::string &zapped,
+                                        const std::string &filename) {
+    PackedZapView view = parseFile(
+        reinterpret_cast<const unsigned char *>(zapped.data()), zapped.size(),
+        filename);
+    PackedZapFile file;
+    file.serial_tree = view.serial_tree;
+    file.packed_bits.assign(reinterpret_cast<const char *>(view.packed_bits),
+                            view.packed_size);
+    file.num_bits = view.num_bits;
+    return file;
+}
+
+/**
+ * name:       parseFile
+ * purpose:    Splits the bytes of a zapped file without copying its bits.
+ * arguments:  zapped - the contents of the zapped file.
+ *             size - the number of bytes at ++zapped++.
+ *             filename - the name of the file, for error messages.
+ * returns:    The serialized tree and the bit count, with packed_bits
+ *             pointing into ++zapped++.
+ * effects:    Throws a runtime_error if ++zapped++ is not a zapped file or
+ *             is truncated.
+ */
+PackedZapView PackedBinaryIO::parseFile(const unsigned char *zapped,
+                                        size_t size,
+                                        const std::string &filename) {
+    if (size < ZAP_MAGIC.size() or
+        ZAP_MAGIC.compare(0, ZAP_MAGIC.size(),
+                          reinterpret_cast<const char *>(zapped),
+                          ZAP_MAGIC.size()) != 0) {
+        throw std::runtime_error(
+                    "PackedBinaryIO::readFile() expected zap file. Given: "
+                                                                + filename);
+    }
+    size_t pos = ZAP_MAGIC.size();
+    PackedZapView file;
+    uint32_t tree_size = readLength(zapped, size, pos, filename);
+    if (size - pos < tree_size) {
+        throw std::runtime_error("Unexpected end of zap file " + filename);
+    }
+    file.serial_tree.assign(reinterpret_cast<const char *>(zapped + pos),
+                            tree_size);
+    pos += tree_size;
+    file.num_bits = readLength(zapped, size, pos, filename);
+    uint64_t packed_size = (file.num_bits + 7) / 8;
+    if (size - pos < packed_size) {
+        throw std::runtime_error("Unexpected end of zap file " + filename);
+    }
+    file.packed_bits = zapped + pos;
+    file.packed_size = static_cast<size_t>(packed_size);
+    return file;
+}
+
+/**
+ * name:       open_or_die
+ * purpose:    Opens a file stream in binary mode.
+ * arguments:  stream - the stream to open.
+ *             filename - the path of the file.
+ * returns:    void
+ * effects:    Throws a runtime_error if the file cannot be opened.
+ */
+template <typename streamtype>
+void PackedBinaryIO::open_or_die(streamtype &stream,
+                                 const std::string &filename) {
+    stream.open(filename, std::ios::binary);
+    if (not stream.is_open()) {
+        throw std::runtime_error("Unable to open file " + filename);
+    }
+}
@@ -0,0 +1,56 @@
+/**
+ * File: PackedBinaryIO.h
+ * Description: Defines the PackedBinaryIO class, which reads and writes
+ * zapped files in exactly the layout BinaryIO uses ("ZAP", the serialized
+ * tree, the bit count and the packed bits) but exchanges already packed
+ * bytes with the caller instead of a string of '0' and '1' characters.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#ifndef PACKEDBINARYIO_H
+#define PACKEDBINARYIO_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "BitIO.h"
+
+/* The contents of a zapped file as read by PackedBinaryIO::readFile. */
+struct PackedZapFile {
+    std::string serial_tree;
+    std::string packed_bits;
+    uint64_t num_bits;
+};
+
+/* The same pieces as PackedZapFile, with the packed bits left in place
+ * in the caller's buffer instead of copied out. */
+struct PackedZapView {
+    std::string serial_tree;
+    const unsigned char *packed_bits;
+    size_t packed_size;
+    uint64_t num_bits;
+};
+
+class PackedBinaryIO {
+public:
+    void writeFile(const std::string &filename, const std::string &serial_tree,
+                   const BitWriter &bits);
+
+    PackedZapFile readFile(const std::string &filename);
+
+    PackedZapFile parseFile(const std::string &zapped,
+                            const std::string &filename);
+
+    PackedZapView parseFile(const unsigned char *zapped, size_t size,
+                            const std::string &filename);
+
+    std::string fileHeader(const std::string &serial_tree, uint64_t num_bits,
+                           const std::string &filename);
+
+private:
+    template <typename streamtype>
+    void open_or_die(streamtype &stream, const std::string &filename);
+};
+
+#endif
@@ -0,0 +1,101 @@
+/**
+ * File: StreamEncoder.cpp
+ * Description: Implements StreamEncoder on top of HuffmanCoder's block
+ * pipeline. Pushed text is coded straight from the caller's buffer; only
+ * the tail that does not fill a block is copied, to wait for more text.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#include "StreamEncoder.h"
+#include <algorithm>
+
+/**
+ * name:       StreamEncoder
+ * purpose:    Creates an encoder with the default options.
+ * arguments:  none
+ * returns:    n/a
+ * effects:    None.
+ */
+StreamEncoder::StreamEncoder() : StreamEncoder(CoderOptions()) {}
+
+/**
+ * name:       StreamEncoder
+ * purpose:    Creates an encoder with the given options.
+ * arguments:  options - the block size, interleaving, code length limit
+ *             and jobs to encode with.
+ * returns:    n/a
+ * effects:    None.
+ */
+StreamEncoder::StreamEncoder(const CoderOptions& options)
+    : coder(options), block_size(coder.streamBlockSize()), started(false) {}
+
+/**
+ * name:       push
+ * purpose:    Adds text to the stream.
+ * arguments:  text - the next bytes of the text.
+ *             size - the number of bytes at ++text++.
+ *             zapped - the buffer the stream is appended to.
+ * returns:    void
+ * effects:    Appends the stream header on the first push, then every 
+ *             block the text completes. Text that does not fill a block is
+ *             held until the next push or finish.
+ */
+void StreamEncoder::push(const unsigned char* text, size_t size,
+                         std::vector<unsigned char>& zapped) {
+    FileWriter output(zapped);
+    start(output);
+    if (not partial.empty()) {
+        size_t part = std::min<uint64_t>(size, block_size - partial.size());
+        partial.append(reinterpret_cast<const char *>(text), part);
+        text += part;
+        size -= part;
+        if (partial.size() < block_size) {
+            return;
+        }
+        FileReader block(reinterpret_cast<const unsigned char *>(
+                                partial.data()), partial.size());
+        coder.encodeBlocks(block, output, block_size);
+        partial.clear();
+    }
+    size_t whole = size - size % block_size;
+    FileReader blocks(text, whole);
+    coder.encodeBlocks(blocks, output, block_size);
+    partial.append(reinterpret_cast<const char *>(text) + whole, 
+                   size - whole);
+}
+
+/**
+ * name:       finish
+ * purpose:    Ends the stream.
+ * arguments:  zapped - the buffer the stream is appended to.
+ * returns:    void
+ * effects:    Appends the held text as a last, short block, the end 
+ *             block and the block index. The next push starts a new 
+ *             stream.
+ */
+void StreamEncoder::finish(std::vector<unsigned char>& zapped) {
+    FileWriter output(zapped);
+    start(output);
+    FileReader block(reinterpret_cast<const unsigned char *>(
+                            partial.data()), partial.size());
+    coder.encodeBlocks(block, output, block_size);
+    partial.clear();
+    coder.writeStreamEnd(output);
+    started = false;
+}
+
+/**
+ * name:       start
+ * purpose:    Writes the stream header if this stream has none yet.
+ * arguments:  output - where the stream is written.
+ * returns:    void
+ * effects:    Sets started.
+ */
+void StreamEncoder::start(FileWriter& output) {
+    if (not started) {
+        coder.block_index.clear();
+        writeStreamHeader(output, block_size, coder.options.transforms);
+        started = true;
+    }
+}
@@ -0,0 +1,45 @@
+/**
+ * File: StreamEncoder.h
+ * Description: Defines StreamEncoder, which zaps text that arrives a piece
+ * at a time, such as a network payload, into a "ZBLK" block stream. push()
+ * encodes every block its text completes and finish() codes the rest and
+ * closes the stream, after which the encoder can start the next one. The
+ * output is the same stream HuffmanCoder::compress would write for all
+ * the pieces at once, and unzap reads it like any other.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#ifndef STREAMENCODER_H
+#define STREAMENCODER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "HuffmanCoder.h"
+
+class StreamEncoder {
+public:
+    StreamEncoder();
+    explicit StreamEncoder(const CoderOptions& options);
+
+    void push(const unsigned char* text, size_t size,
+              std::vector<unsigned char>& zapped);
+    void finish(std::vector<unsigned char>& zapped);
+
+private:
+    StreamEncoder(const StreamEncoder &) = delete;
+    StreamEncoder &operator=(const StreamEncoder &) = delete;
+
+    void start(FileWriter& output);
+
+    HuffmanCoder coder;
+    uint64_t block_size;
+    // whether the stream header has been written
+    bool started;
+    // text pushed since the last full block, always shorter than a block
+    std::string partial;
+};
+
+#endif
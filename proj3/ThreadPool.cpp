@@ -0,0 +1,115 @@
+/**
+ * File: ThreadPool.cpp
+ * Description: Implements ThreadPool. Each task is wrapped in a
+ * packaged_task, so an exception thrown by a task is handed to whoever
+ * waits on its future instead of ending the worker.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#include "ThreadPool.h"
+
+/**
+ * name:       ThreadPool
+ * purpose:    Starts the worker threads.
+ * arguments:  threads - the number of workers. With 0 workers, submit()
+ *             runs each task on the calling thread before returning.
+ * returns:    n/a
+ * effects:    Starts ++threads++ threads.
+ */
+ThreadPool::ThreadPool(size_t threads) : stopping(false) {
+    for (size_t i = 0; i < threads; i++) {
+        workers.emplace_back(&ThreadPool::work, this);
+    }
+}
+
+/**
+ * name:       ~ThreadPool
+ * purpose:    Stops the worker threads.
+ * arguments:  none
+ * returns:    n/a
+ * effects:    Waits for the tasks that are running to finish. Tasks that
+ *             have not started are dropped, and their futures report a
+ *             broken promise.
+ */
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    ready.notify_all();
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
+
+/**
+ * name:       submit
+ * purpose:    Queues a task for the next free worker.
+ * arguments:  task - the work to run.
+ * returns:    A future that becomes ready when the task has run, and that
+ *             rethrows anything the task threw.
+ * effects:    Runs ++task++ right away when the pool has no workers.
+ */
+std::future<void> ThreadPool::submit(std::function<void()> task) {
+    std::packaged_task<void()> job(std::move(task));
+    std::future<void> done = job.get_future();
+    if (workers.empty()) {
+        job();
+        return done;
+    }
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        tasks.push(std::move(job));
+    }
+    ready.notify_one();
+    return done;
+}
+
+/**
+ * name:       size
+ * purpose:    Reports the number of workers.
+ * arguments:  none
+ * returns:    The number of worker threads; 0 if tasks run inline.
+ * effects:    None.
+ */
+size_t ThreadPool::size() const {
+    return workers.size();
+}
+
+/**
+ * name:       hardwareThreads
+ * purpose:    Reports how many threads the machine can run at once.
+ * arguments:  none
+ * returns:    The number of hardware threads, or 1 if it is unknown.
+ * effects:    None.
+ */
+size_t ThreadPool::hardwareThreads() {
+    unsigned count = std::thread::hardware_concurrency();
+    return count == 0 ? 1 : count;
+}
+
+/**
+ * name:       work
+ * purpose:    Runs queued tasks until the pool stops.
+ * arguments:  none
+ * returns:    void
+ * effects:    Runs on each worker thread.
+ */
+void ThreadPool::work() {
+    while (true) {
+        std::packaged_task<void()> job;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            ready.wait(guard, [this]() {
+                return stopping or not tasks.empty();
+            });
+            if (stopping) {
+                return;
+            }
+            job = std::move(tasks.front());
+            tasks.pop();
+        }
+        job();
+    }
+}
@@ -0,0 +1,46 @@
+/**
+ * File: ThreadPool.h
+ * Description: Defines ThreadPool, a fixed set of worker threads that run
+ * submitted tasks in the order they were submitted. zap and unzap use it
+ * to code several blocks of a stream at once.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t threads);
+    ~ThreadPool();
+
+    std::future<void> submit(std::function<void()> task);
+
+    size_t size() const;
+
+    static size_t hardwareThreads();
+
+private:
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    void work();
+
+    std::vector<std::thread> workers;
+    std::queue<std::packaged_task<void()>> tasks;
+    std::mutex lock;
+    std::condition_variable ready;
+    bool stopping;
+};
+
+#endif
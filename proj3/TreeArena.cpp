@@ -0,0 +1,84 @@
+/**
+ * File: TreeArena.cpp
+ * Description: Implements TreeArena. Nodes are constructed in place in
+ * the arena's storage; HuffmanTreeNode has no destructor to run, so
+ * clearing the arena only has to forget them.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#include "TreeArena.h"
+#include <new>
+#include <stdexcept>
+
+/**
+ * name:       TreeArena
+ * purpose:    Creates an empty arena.
+ * arguments:  none
+ * returns:    n/a
+ * effects:    None.
+ */
+TreeArena::TreeArena() : used(0) {}
+
+/**
+ * name:       create
+ * purpose:    Creates a leaf node in the arena.
+ * arguments:  c - the node's character.
+ *             f - the node's frequency.
+ * returns:    A pointer to the node, valid until the arena is cleared.
+ * effects:    Throws a runtime_error if the arena is full.
+ */
+HuffmanTreeNode *TreeArena::create(char c, int f) {
+    return new (allocate()) HuffmanTreeNode(c, f);
+}
+
+/**
+ * name:       create
+ * purpose:    Creates a node with children in the arena.
+ * arguments:  c - the node's character ('\0' for internal nodes).
+ *             f - the node's frequency.
+ *             l, r - the node's children.
+ * returns:    A pointer to the node, valid until the arena is cleared.
+ * effects:    Throws a runtime_error if the arena is full.
+ */
+HuffmanTreeNode *TreeArena::create(char c, int f, HuffmanTreeNode *l,
+                                   HuffmanTreeNode *r) {
+    return new (allocate()) HuffmanTreeNode(c, f, l, r);
+}
+
+/**
+ * name:       clear
+ * purpose:    Frees every node in the arena at once.
+ * arguments:  none
+ * returns:    void
+ * effects:    Pointers to nodes created earlier must no longer be used.
+ */
+void TreeArena::clear() {
+    used = 0;
+}
+
+/**
+ * name:       size
+ * purpose:    Reports how many nodes the arena holds.
+ * arguments:  none
+ * returns:    The number of nodes created since the arena was last cleared.
+ * effects:    None.
+ */
+size_t TreeArena::size() const {
+    return used;
+}
+
+/**
+ * name:       allocate
+ * purpose:    Reserves the storage for one more node.
+ * arguments:  none
+ * returns:    The uninitialized storage.
+ * effects:    Throws a runtime_error if all MAX_NODES nodes are in use,
+ *             which only a malformed tree can cause.
+ */
+void *TreeArena::allocate() {
+    if (used == MAX_NODES) {
+        throw std::runtime_error("Huffman tree is too large.");
+    }
+    return storage + sizeof(HuffmanTreeNode) * used++;
+}
@@ -0,0 +1,45 @@
+/**
+ * File: TreeArena.h
+ * Description: Defines TreeArena, a fixed block of storage that Huffman
+ * tree nodes are created in. A tree over byte values never has more than
+ * MAX_NODES nodes, so one arena holds any tree zap builds, and creating,
+ * walking and dropping a tree touches no heap memory. The arena owns its
+ * nodes: a tree is freed by clearing (or destroying) the arena, never by
+ * deleting its nodes one at a time.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#ifndef TREEARENA_H
+#define TREEARENA_H
+
+#include <cstddef>
+#include "HuffmanTreeNode.h"
+
+class TreeArena {
+public:
+    // a full binary tree with 256 leaves has 255 internal nodes
+    static const size_t MAX_NODES = 511;
+
+    TreeArena();
+
+    HuffmanTreeNode *create(char c, int f);
+    HuffmanTreeNode *create(char c, int f, HuffmanTreeNode *l,
+                            HuffmanTreeNode *r);
+    void clear();
+
+    size_t size() const;
+
+private:
+    TreeArena(const TreeArena &) = delete;
+    TreeArena &operator=(const TreeArena &) = delete;
+
+    void *allocate();
+
+    // room for MAX_NODES nodes; the first used of them are live
+    alignas(HuffmanTreeNode) 
+                unsigned char storage[MAX_NODES * sizeof(HuffmanTreeNode)];
+    size_t used;
+};
+
+#endif
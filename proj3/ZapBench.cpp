@@ -0,0 +1,985 @@
+/**
+ * File: ZapBench.cpp
+ * Description: The benchmark harness behind "make bench". Each stage of
+ * zapping (histogram, tree build, code generation, encoding, header
+ * serialization, decoding, block checksums) and the whole zap and unzap
+ * round trip are timed on a generated corpus of varied entropy and size,
+ * plus any files named on the command line. Results go to stdout as one
+ * JSON object so runs can be compared by a script: throughput in MB/s,
+ * cycles per byte where the CPU has a time-stamp counter, the compression
+ * ratio, the specialized decoding loop each input's code picks, and the
+ * peak resident set size.
+ *
+ * "zap_bench --suite" runs the kernel suite instead, for tracking each
+ * kernel over time: the histogram kernels, the tree and code-length
+ * builds, code generation, and the encode and decode loops, on inputs
+ * drawn for every combination of size (1K to 1G), alphabet size and
+ * entropy asked for. The kernels that split their input run at each
+ * thread count asked for, and every result records its thread count, so
+ * scaling curves and SIMD/scalar comparisons can be read off the output.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#include "HuffmanCoder.h"
+#include "CanonicalCode.h"
+#include "LengthLimit.h"
+#include "Histogram.h"
+#include "Checksum.h"
+#include "HuffmanDecodeTable.h"
+#include "BitIO.h"
+#include "ThreadPool.h"
+#include "TreeArena.h"
+#include <sys/resource.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <x86intrin.h>
+#define ZAP_BENCH_TSC 1
+#endif
+
+#ifndef ZAP_BENCH_FLAGS
+#define ZAP_BENCH_FLAGS "unknown"
+#endif
+
+// each stage is repeated until it has run for this long, and at least
+// MIN_RUNS times; the fastest run is reported
+static const double MIN_SECONDS = 0.1;
+static const int MIN_RUNS = 3;
+
+/* One input of the corpus. */
+struct BenchInput {
+    std::string name;
+    std::vector<unsigned char> bytes;
+};
+
+/* The best time of one stage over one input. */
+struct StageResult {
+    const char *name;
+    double seconds;
+    double cycles;
+};
+
+// results are folded in here so the compiler cannot drop the work
+static volatile uint64_t sink;
+
+/**
+ * name:       readCycles
+ * purpose:    Reads the CPU's time-stamp counter.
+ * arguments:  none
+ * returns:    The counter, or 0 where there is none.
+ * effects:    None.
+ */
+static uint64_t readCycles() {
+#if ZAP_BENCH_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/**
+ * name:       timeStage
+ * purpose:    Times one stage.
+ * arguments:  name - the stage's name in the output.
+ *             stage - the work to time.
+ * returns:    The fastest of the runs, in seconds and cycles.
+ * effects:    Runs ++stage++ at least MIN_RUNS times.
+ */
+static StageResult timeStage(const char *name,
+                             const std::function<void()>& stage) {
+    typedef std::chrono::steady_clock Clock;
+    StageResult best = {name, 0, 0};
+    double total = 0;
+    for (int run = 0; run < MIN_RUNS or total < MIN_SECONDS; run++) {
+        Clock::time_point start = Clock::now();
+        uint64_t start_cycles = readCycles();
+        stage();
+        uint64_t cycles = readCycles() - start_cycles;
+        double seconds = std::chrono::duration<double>(Clock::now() -
+                                                       start).count();
+        total += seconds;
+        if (run == 0 or seconds < best.seconds) {
+            best.seconds = seconds;
+            best.cycles = static_cast<double>(cycles);
+        }
+    }
+    return best;
+}
+
+/**
+ * name:       generateCorpus
+ * purpose:    Makes the standard inputs, which are the same on every run.
+ * arguments:  size - the number of bytes in each input.
+ *             inputs - the inputs are appended here.
+ * returns:    void
+ * effects:    Appends four inputs: word-like text, skewed bytes (about 2
+ *             bits each), uniform noise, and long runs.
+ */
+static void generateCorpus(size_t size, std::vector<BenchInput>& inputs) {
+    static const char *words[] = {"the", "of", "and", "zap", "block",
+        "huffman", "code", "stream", "a", "to", "in", "is", "bits",
+        "table", "decode", "length"};
+    std::string suffix = (size >= (1 << 20))
+                            ? std::to_string(size >> 20) + "M"
+                            : std::to_string(size >> 10) + "K";
+    uint32_t state = 2026;
+    auto next = [&state]() {
+        state = state * 1103515245 + 12345;
+        return state >> 8;
+    };
+    BenchInput text = {"text-" + suffix, {}};
+    while (text.bytes.size() < size) {
+        // squaring the pick makes the first words the most common
+        uint32_t pick = next();
+        const char *word = words[(pick % 16) * (pick % 16) / 16];
+        text.bytes.insert(text.bytes.end(), word, word + strlen(word));
+        text.bytes.push_back((pick >> 12) % 11 == 0 ? '\n' : ' ');
+    }
+    text.bytes.resize(size);
+    BenchInput skewed = {"skewed-" + suffix, {}};
+    BenchInput noise = {"random-" + suffix, {}};
+    BenchInput runs = {"runs-" + suffix, {}};
+    for (size_t i = 0; i < size; i++) {
+        int symbol = 0;
+        while (symbol < 255 and next() % 4 != 0) { // geometric, p = 1/4
+            symbol++;
+        }
+        skewed.bytes.push_back(static_cast<unsigned char>(symbol));
+        noise.bytes.push_back(static_cast<unsigned char>(next()));
+    }
+    while (runs.bytes.size() < size) {
+        runs.bytes.insert(runs.bytes.end(), 1 + next() % 4096,
+                          static_cast<unsigned char>(next() % 4 + 'a'));
+    }
+    runs.bytes.resize(size);
+    inputs.push_back(text);
+    inputs.push_back(skewed);
+    inputs.push_back(noise);
+    inputs.push_back(runs);
+}
+
+/**
+ * name:       jsonString
+ * purpose:    Quotes a string for JSON.
+ * arguments:  text - the string.
+ * returns:    ++text++ in double quotes, with quotes, backslashes and
+ *             control characters escaped.
+ * effects:    None.
+ */
+static std::string jsonString(const std::string& text) {
+    std::ostringstream out;
+    out << '"';
+    for (unsigned char c : text) {
+        if (c == '"' or c == '\\') {
+            out << '\\' << c;
+        } else if (c < 0x20) {
+            out << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+                << static_cast<int>(c) << std::dec;
+        } else {
+            out << c;
+        }
+    }
+    out << '"';
+    return out.str();
+}
+
+/**
+ * name:       benchInput
+ * purpose:    Times every stage on one input and prints its JSON object.
+ * arguments:  input - the input.
+ *             out - the stream the object is written to.
+ * returns:    void
+ * effects:    Writes to ++out++.
+ */
+static void benchInput(const BenchInput& input, std::ostream& out) {
+    const unsigned char *data = input.bytes.data();
+    size_t size = input.bytes.size();
+    FrequencyTable frequencies = {};
+    countBytes(data, size, frequencies);
+    CodeLengths lengths = huffmanCodeLengths(frequencies);
+    CodeTable codes = canonicalCodes(lengths);
+    BitWriter writer;
+    HuffmanDecodeTable table;
+    std::string decoded;
+    HuffmanCoder coder;
+    std::vector<unsigned char> zapped, unzapped;
+
+    std::vector<StageResult> stages;
+    stages.push_back(timeStage("histogram", [&]() {
+        FrequencyTable counts = {};
+        countBytes(data, size, counts);
+        sink += counts[0];
+    }));
+    stages.push_back(timeStage("tree_build", [&]() {
+        sink += huffmanCodeLengths(frequencies)[data[0]];
+    }));
+    stages.push_back(timeStage("code_gen", [&]() {
+        sink += canonicalCodes(lengths)[data[0]].bits;
+    }));
+    stages.push_back(timeStage("encode", [&]() {
+        writer.clear();
+        writer.writeCodes(data, size, codes);
+        writer.flush();
+        sink += writer.bitCount();
+    }));
+    stages.push_back(timeStage("serialize", [&]() {
+        std::string header = serializeCodeLengths(lengths);
+        size_t pos = 0;
+        sink += deserializeCodeLengths(header, pos)[data[0]];
+    }));
+    stages.push_back(timeStage("decode", [&]() {
+        table.build(codes);
+        BitReader reader(reinterpret_cast<const unsigned char *>(
+                            writer.bytes().data()), writer.bytes().size(),
+                         writer.bitCount());
+        decoded.clear();
+        table.decode(reader, size, decoded);
+        sink += decoded.size();
+    }));
+    stages.push_back(timeStage("checksum", [&]() {
+        sink += crc32c(data, size);
+    }));
+    stages.push_back(timeStage("zap", [&]() {
+        coder.compress(data, size, zapped);
+        sink += zapped.size();
+    }));
+    stages.push_back(timeStage("unzap", [&]() {
+        coder.decompress(zapped.data(), zapped.size(), unzapped);
+        sink += unzapped.size();
+    }));
+    if (unzapped != input.bytes) {
+        throw std::runtime_error("Benchmark round trip did not match.");
+    }
+
+    out << "    {\"name\": " << jsonString(input.name)
+        << ", \"bytes\": " << size
+        << ", \"zapped_bytes\": " << zapped.size()
+        << ", \"ratio\": " << std::fixed << std::setprecision(4)
+        << static_cast<double>(zapped.size()) / size
+        << ", \"decode_kernel\": " << table.kernelLength()
+        << ", \"stages\": {";
+    for (size_t k = 0; k < stages.size(); k++) {
+        const StageResult& stage = stages[k];
+        out << (k > 0 ? ", " : "") << "\"" << stage.name << "\": {"
+            << "\"threads\": 1, \"seconds\": " << std::setprecision(9)
+            << stage.seconds
+            << ", \"mb_per_s\": " << std::setprecision(2)
+            << size / stage.seconds / 1e6 << ", \"cycles_per_byte\": ";
+#if ZAP_BENCH_TSC
+        out << std::setprecision(3) << stage.cycles / size;
+#else
+        out << "null";
+#endif
+        out << "}";
+    }
+    out << "}}";
+}
+
+/**
+ * name:       peakRssKilobytes
+ * purpose:    Reports the most memory the process has held.
+ * arguments:  none
+ * returns:    The peak resident set size in kilobytes.
+ * effects:    None.
+ */
+static long peakRssKilobytes() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024; // bytes on macOS
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+/* What the kernel suite runs, from its command line. */
+struct SuiteOptions {
+    std::vector<uint64_t> sizes;
+    std::vector<int> alphabets;
+    // bits per byte; a target above log2 of the alphabet size gives
+    // uniform bytes
+    std::vector<double> entropies;
+    std::vector<int> threads;
+    // only benchmarks whose names start with this are run
+    std::string filter;
+};
+
+/* One timed kernel of the suite. */
+struct SuiteResult {
+    std::string benchmark;
+    int threads;
+    StageResult time;
+    // whether the kernel's work grows with the input; the tree and code
+    // builds only depend on the alphabet and report no throughput
+    bool per_byte;
+};
+
+/* Reaches the coder's private tree-based build and code walk, which the
+ * zap path uses but does not export. A friend of HuffmanCoder. */
+class CoderKernels {
+public:
+    static HuffmanTreeNode* buildTree(HuffmanCoder& coder,
+                                      const FrequencyTable& frequencies,
+                                      TreeArena& arena);
+    static void treeCodes(HuffmanCoder& coder, const HuffmanTreeNode* root,
+                          CodeTable& codes);
+};
+
+/**
+ * name:       buildTree
+ * purpose:    Runs HuffmanCoder::buildHuffmanTree.
+ * arguments:  coder - the coder.
+ *             frequencies - the frequency of each byte value.
+ *             arena - the arena the nodes are created in.
+ * returns:    The root of the tree.
+ * effects:    Creates the tree in ++arena++.
+ */
+HuffmanTreeNode* CoderKernels::buildTree(HuffmanCoder& coder,
+                                         const FrequencyTable& frequencies,
+                                         TreeArena& arena) {
+    return coder.buildHuffmanTree(frequencies, arena);
+}
+
+/**
+ * name:       treeCodes
+ * purpose:    Runs HuffmanCoder::generateCharCodes.
+ * arguments:  coder - the coder.
+ *             root - the root of a Huffman tree.
+ *             codes - the table that receives the codes.
+ * returns:    void
+ * effects:    Fills ++codes++.
+ */
+void CoderKernels::treeCodes(HuffmanCoder& coder, const HuffmanTreeNode* root,
+                             CodeTable& codes) {
+    coder.generateCharCodes(root, codes);
+}
+
+/**
+ * name:       parseSize
+ * purpose:    Reads a byte count such as "4096", "64K", "16M" or "1G".
+ * arguments:  text - the count, with an optional binary suffix.
+ * returns:    The number of bytes.
+ * effects:    Throws a runtime_error if ++text++ is not a positive count.
+ */
+static uint64_t parseSize(const std::string& text) {
+    size_t digits = 0;
+    while (digits < text.size() and text[digits] >= '0' and 
+           text[digits] <= '9') {
+        digits++;
+    }
+    std::string suffix = text.substr(digits);
+    int shift = suffix == "K" ? 10 : suffix == "M" ? 20 : 
+                suffix == "G" ? 30 : 0;
+    if (digits == 0 or digits > 12 or (shift == 0 and not suffix.empty())) {
+        throw std::runtime_error("Bad size " + text + ".");
+    }
+    uint64_t size = std::stoull(text.substr(0, digits)) << shift;
+    if (size == 0) {
+        throw std::runtime_error("Bad size " + text + ".");
+    }
+    return size;
+}
+
+/**
+ * name:       sizeLabel
+ * purpose:    Names a byte count the way parseSize reads it.
+ * arguments:  size - the number of bytes.
+ * returns:    The count in the largest unit that divides it exactly.
+ * effects:    None.
+ */
+static std::string sizeLabel(uint64_t size) {
+    static const char units[] = {'G', 'M', 'K'};
+    for (int k = 0; k < 3; k++) {
+        int shift = 30 - 10 * k;
+        if (size >= (uint64_t(1) << shift) and 
+            size % (uint64_t(1) << shift) == 0) {
+            return std::to_string(size >> shift) + units[k];
+        }
+    }
+    return std::to_string(size);
+}
+
+/**
+ * name:       splitList
+ * purpose:    Splits a comma-separated option value.
+ * arguments:  text - the value.
+ * returns:    Its items, in order.
+ * effects:    Throws a runtime_error if an item is empty.
+ */
+static std::vector<std::string> splitList(const std::string& text) {
+    std::vector<std::string> items;
+    size_t start = 0;
+    while (true) {
+        size_t comma = text.find(',', start);
+        std::string item = text.substr(start, comma == std::string::npos
+                                              ? std::string::npos 
+                                              : comma - start);
+        if (item.empty()) {
+            throw std::runtime_error("Empty item in " + text + ".");
+        }
+        items.push_back(item);
+        if (comma == std::string::npos) {
+            return items;
+        }
+        start = comma + 1;
+    }
+}
+
+/**
+ * name:       parseNumber
+ * purpose:    Reads a whole option value as a number.
+ * arguments:  text - the value.
+ *             low - the smallest value allowed.
+ *             high - the largest value allowed.
+ * returns:    The number.
+ * effects:    Throws a runtime_error if ++text++ is not a number from 
+ *             ++low++ to ++high++.
+ */
+static double parseNumber(const std::string& text, double low, double high) {
+    size_t used = 0;
+    double value = 0;
+    try {
+        value = std::stod(text, &used);
+    } catch (const std::exception&) {
+        used = 0;
+    }
+    if (used == 0 or used != text.size() or not (value >= low) or 
+        not (value <= high)) {
+        throw std::runtime_error("Bad value " + text + ".");
+    }
+    return value;
+}
+
+/**
+ * name:       parseSuiteOptions
+ * purpose:    Reads the suite's command line.
+ * arguments:  argc - the number of arguments after "--suite".
+ *             argv - the arguments: --sizes=, --alphabets=, --entropies=
+ *             and --threads= take comma-separated lists, --filter= a
+ *             benchmark name prefix.
+ * returns:    The options, with defaults for any list not given.
+ * effects:    Throws a runtime_error on an unknown or malformed argument.
+ */
+static SuiteOptions parseSuiteOptions(int argc, char *argv[]) {
+    SuiteOptions options;
+    for (int i = 0; i < argc; i++) {
+        std::string arg = argv[i];
+        size_t equals = arg.find('=');
+        std::string name = arg.substr(0, equals);
+        if (equals == std::string::npos) {
+            throw std::runtime_error("Unknown argument " + arg + ".");
+        }
+        std::string value = arg.substr(equals + 1);
+        if (name == "--filter") {
+            options.filter = value;
+            continue;
+        }
+        for (const std::string& item : splitList(value)) {
+            if (name == "--sizes") {
+                options.sizes.push_back(parseSize(item));
+            } else if (name == "--alphabets") {
+                options.alphabets.push_back(int(parseNumber(item, 1, 256)));
+            } else if (name == "--entropies") {
+                options.entropies.push_back(parseNumber(item, 0, 8));
+            } else if (name == "--threads") {
+                options.threads.push_back(int(parseNumber(item, 1, 1024)));
+            } else {
+                throw std::runtime_error("Unknown argument " + arg + ".");
+            }
+        }
+    }
+    if (options.sizes.empty()) {
+        options.sizes = {1 << 10, 64 << 10, 4 << 20};
+    }
+    if (options.alphabets.empty()) {
+        options.alphabets = {2, 16, 256};
+    }
+    if (options.entropies.empty()) {
+        options.entropies = {1, 4, 8};
+    }
+    if (options.threads.empty()) {
+        // powers of two up to every hardware thread, for scaling curves
+        int hardware = static_cast<int>(ThreadPool::hardwareThreads());
+        for (int threads = 1; threads < hardware; threads *= 2) {
+            options.threads.push_back(threads);
+        }
+        options.threads.push_back(hardware);
+    }
+    return options;
+}
+
+/**
+ * name:       geometricEntropy
+ * purpose:    Finds the entropy of an alphabet whose byte i has 
+ *             probability proportional to ++ratio++ to the power i.
+ * arguments:  alphabet - the number of byte values.
+ *             ratio - the ratio, from 0 (exclusive) to 1.
+ * returns:    The entropy in bits per byte.
+ * effects:    None.
+ */
+static double geometricEntropy(int alphabet, double ratio) {
+    double total = 0, weight = 1;
+    for (int i = 0; i < alphabet; i++, weight *= ratio) {
+        total += weight;
+    }
+    double entropy = 0;
+    weight = 1;
+    for (int i = 0; i < alphabet; i++, weight *= ratio) {
+        double p = weight / total;
+        if (p > 0) {
+            entropy -= p * std::log2(p);
+        }
+    }
+    return entropy;
+}
+
+/**
+ * name:       measuredEntropy
+ * purpose:    Computes the order-0 entropy of some counted bytes.
+ * arguments:  counts - the frequency of each byte value.
+ * returns:    The entropy in bits per byte, 0 for no bytes.
+ * effects:    None.
+ */
+static double measuredEntropy(const FrequencyTable& counts) {
+    double total = 0;
+    for (uint64_t count : counts) {
+        total += count;
+    }
+    double entropy = 0;
+    for (uint64_t count : counts) {
+        if (count > 0) {
+            entropy -= count / total * std::log2(count / total);
+        }
+    }
+    return entropy;
+}
+
+/**
+ * name:       generateDistribution
+ * purpose:    Makes an input of bytes 0 to ++alphabet++ - 1 drawn 
+ *             independently, with byte i a fixed factor less likely than
+ *             byte i - 1, the factor chosen to give ++entropy++.
+ * arguments:  size - the number of bytes.
+ *             alphabet - the number of byte values, all of which occur 
+ *             (given room).
+ *             entropy - the entropy wanted, in bits per byte.
+ * returns:    The input, the same on every run.
+ * effects:    None.
+ */
+static BenchInput generateDistribution(uint64_t size, int alphabet,
+                                       double entropy) {
+    double ratio = 1;
+    if (entropy < std::log2(alphabet) - 1e-9) {
+        double low = 0, high = 1; // the entropy grows with the ratio
+        for (int step = 0; step < 60; step++) {
+            ratio = (low + high) / 2;
+            (geometricEntropy(alphabet, ratio) < entropy ? low : high) = 
+                                                                    ratio;
+        }
+    }
+    // bytes are drawn through a table of 2^16 slots, each byte getting 
+    // slots in proportion to its probability and at least one
+    const int SLOTS = 1 << 16;
+    std::vector<double> weights(alphabet);
+    double total = 0, weight = 1;
+    for (int i = 0; i < alphabet; i++, weight *= ratio) {
+        weights[i] = weight;
+        total += weight;
+    }
+    std::vector<int> slots(alphabet);
+    int used = 0;
+    for (int i = 0; i < alphabet; i++) {
+        slots[i] = std::max(1, static_cast<int>(weights[i] / total * SLOTS));
+        used += slots[i];
+    }
+    slots[0] += SLOTS - used; // byte 0 is the likeliest, so stays positive
+    std::vector<unsigned char> table;
+    table.reserve(SLOTS);
+    for (int i = 0; i < alphabet; i++) {
+        table.insert(table.end(), slots[i], static_cast<unsigned char>(i));
+    }
+    BenchInput input = {sizeLabel(size), {}};
+    input.bytes.resize(size);
+    uint64_t state = 2026 + alphabet;
+    for (uint64_t i = 0; i < size; i++) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        input.bytes[i] = table[state >> 48];
+    }
+    return input;
+}
+
+/**
+ * name:       runSlices
+ * purpose:    Runs one piece of work per thread and waits for them all.
+ * arguments:  pool - the threads, or nullptr to run on this thread.
+ *             threads - the number of pieces.
+ *             slice - the work, given the number of its piece.
+ * returns:    void
+ * effects:    Rethrows the first exception a piece throws.
+ */
+static void runSlices(ThreadPool *pool, int threads,
+                      const std::function<void(int)>& slice) {
+    if (not pool) {
+        for (int t = 0; t < threads; t++) {
+            slice(t);
+        }
+        return;
+    }
+    std::vector<std::future<void>> done;
+    for (int t = 0; t < threads; t++) {
+        done.push_back(pool->submit([&slice, t]() { slice(t); }));
+    }
+    for (std::future<void>& piece : done) {
+        piece.get();
+    }
+}
+
+/**
+ * name:       readerFor
+ * purpose:    Makes a reader over a flushed writer's bits.
+ * arguments:  writer - the writer.
+ * returns:    A reader positioned at the first bit.
+ * effects:    None; the reader points into ++writer++.
+ */
+static BitReader readerFor(const BitWriter& writer) {
+    return BitReader(reinterpret_cast<const unsigned char *>(
+                        writer.bytes().data()), writer.bytes().size(),
+                     writer.bitCount());
+}
+
+/**
+ * name:       benchThreaded
+ * purpose:    Times the kernels that split the input between threads: the
+ *             histogram, encoding and decoding, each thread taking one
+ *             contiguous slice.
+ * arguments:  input - the input.
+ *             codes - the code for the input.
+ *             table - the decode tables for ++codes++.
+ *             threads - the number of threads.
+ *             options - the suite's options, for the filter.
+ *             results - the results are appended here.
+ * returns:    void
+ * effects:    Throws a runtime_error if a decoder does not give back the
+ *             input.
+ */
+static void benchThreaded(const BenchInput& input, const CodeTable& codes,
+                          const HuffmanDecodeTable& table, int threads,
+                          const SuiteOptions& options,
+                          std::vector<SuiteResult>& results) {
+    const unsigned char *data = input.bytes.data();
+    uint64_t size = input.bytes.size();
+    std::unique_ptr<ThreadPool> pool;
+    if (threads > 1) {
+        pool.reset(new ThreadPool(threads));
+    }
+    auto begin = [size, threads](int t) { return size * t / threads; };
+    auto length = [&begin](int t) { return begin(t + 1) - begin(t); };
+    auto wanted = [&options](const std::string& name) {
+        return name.compare(0, options.filter.size(), options.filter) == 0;
+    };
+    // returns whether the filter let the kernel run
+    auto run = [&](const std::string& name, 
+                   const std::function<void(int)>& slice) {
+        if (not wanted(name)) {
+            return false;
+        }
+        results.push_back({name, threads, timeStage("", [&]() {
+            runSlices(pool.get(), threads, slice);
+        }), true});
+        return true;
+    };
+
+    std::vector<FrequencyTable> counts(threads);
+    run(std::string("histogram/") + histogramKernel(), [&](int t) {
+        counts[t] = FrequencyTable();
+        countBytes(data + begin(t), length(t), counts[t]);
+        sink += counts[t][0];
+    });
+    run("histogram/scalar", [&](int t) {
+        counts[t] = FrequencyTable();
+        countBytesScalar(data + begin(t), length(t), counts[t]);
+        sink += counts[t][0];
+    });
+
+    // the bits each decoder reads, coded only if it will run
+    std::vector<BitWriter> whole(threads);
+    std::vector<BitWriter> parts(4 * threads);
+    for (int t = 0; t < threads and wanted("decode/kernel"); t++) {
+        whole[t].writeCodes(data + begin(t), length(t), codes);
+        whole[t].flush();
+    }
+    for (int t = 0; t < threads and wanted("decode/interleaved4"); t++) {
+        for (uint64_t i = 0; i < length(t); i++) {
+            const HuffmanCode& code = codes[data[begin(t) + i]];
+            parts[4 * t + i % 4].write(code.bits, code.length);
+        }
+        for (int k = 0; k < 4; k++) {
+            parts[4 * t + k].flush();
+        }
+    }
+    std::vector<BitWriter> scratch(threads);
+    run("encode/write_codes", [&](int t) {
+        scratch[t].clear();
+        scratch[t].writeCodes(data + begin(t), length(t), codes);
+        scratch[t].flush();
+    });
+    run("encode/per_code", [&](int t) {
+        scratch[t].clear();
+        for (uint64_t i = begin(t); i < begin(t + 1); i++) {
+            scratch[t].write(codes[data[i]].bits, codes[data[i]].length);
+        }
+        scratch[t].flush();
+    });
+
+    std::vector<std::string> decoded(threads);
+    auto check = [&]() {
+        for (int t = 0; t < threads; t++) {
+            if (decoded[t].size() != length(t) or (length(t) > 0 and
+                std::memcmp(decoded[t].data(), data + begin(t), 
+                            length(t)) != 0)) {
+                throw std::runtime_error("Benchmark decode did not match.");
+            }
+            decoded[t].clear();
+        }
+    };
+    if (run("decode/kernel", [&](int t) {
+        BitReader reader = readerFor(whole[t]);
+        decoded[t].clear();
+        table.decode(reader, length(t), decoded[t]);
+    })) {
+        check();
+    }
+    if (run("decode/interleaved4", [&](int t) {
+        BitReader readers[4] = {
+            readerFor(parts[4 * t]), readerFor(parts[4 * t + 1]),
+            readerFor(parts[4 * t + 2]), readerFor(parts[4 * t + 3])
+        };
+        decoded[t].clear();
+        table.decodeInterleaved(readers, 4, length(t), decoded[t]);
+    })) {
+        check();
+    }
+}
+
+/**
+ * name:       benchSuiteInput
+ * purpose:    Times every kernel of the suite on one input and prints its
+ *             JSON object.
+ * arguments:  input - the input.
+ *             alphabet - the number of byte values it was drawn from.
+ *             target - the entropy it was drawn for.
+ *             options - the suite's options.
+ *             out - the stream the object is written to.
+ * returns:    void
+ * effects:    Writes to ++out++. Throws a runtime_error if a decoder does
+ *             not give back the input.
+ */
+static void benchSuiteInput(const BenchInput& input, int alphabet,
+                            double target, const SuiteOptions& options,
+                            std::ostream& out) {
+    const unsigned char *data = input.bytes.data();
+    size_t size = input.bytes.size();
+    FrequencyTable frequencies = {};
+    countBytes(data, size, frequencies);
+    CodeLengths lengths = huffmanCodeLengths(frequencies);
+    CodeTable codes = canonicalCodes(lengths);
+    HuffmanDecodeTable table;
+    table.build(codes);
+    HuffmanCoder coder;
+    TreeArena arena;
+    HuffmanTreeNode* root = CoderKernels::buildTree(coder, frequencies, 
+                                                    arena);
+
+    // these depend only on the counts, so they run on one thread
+    std::vector<SuiteResult> results;
+    auto run = [&](const std::string& name,
+                   const std::function<void()>& kernel) {
+        if (name.compare(0, options.filter.size(), options.filter) == 0) {
+            results.push_back({name, 1, timeStage("", kernel), false});
+        }
+    };
+    run("tree_build/tree", [&]() {
+        TreeArena nodes;
+        sink += CoderKernels::buildTree(coder, frequencies, nodes)->
+                                                        get_freq();
+    });
+    run("tree_build/lengths", [&]() {
+        sink += huffmanCodeLengths(frequencies)[data[0]];
+    });
+    for (int limit : {15, 11}) { // the decoder's widest and fastest
+        run("tree_build/limited_" + std::to_string(limit), [&]() {
+            sink += lengthLimitedCodeLengths(frequencies, limit)[data[0]];
+        });
+    }
+    run("code_gen/canonical", [&]() {
+        sink += canonicalCodes(lengths)[data[0]].bits;
+    });
+    run("code_gen/tree_walk", [&]() {
+        CodeTable walked = {};
+        CoderKernels::treeCodes(coder, root, walked);
+        sink += walked[data[0]].bits;
+    });
+    run("code_gen/decode_table", [&]() {
+        HuffmanDecodeTable built;
+        built.build(codes);
+        sink += built.maxCodeLength();
+    });
+    for (int threads : options.threads) {
+        benchThreaded(input, codes, table, threads, options, results);
+    }
+
+    out << "    {\"name\": " << jsonString(input.name + "-a" + 
+                                           std::to_string(alphabet))
+        << ", \"bytes\": " << size
+        << ", \"alphabet\": " << alphabet
+        << ", \"distinct_bytes\": " << distinctBytes(frequencies)
+        << std::fixed << std::setprecision(3)
+        << ", \"target_entropy\": " << target
+        << ", \"entropy\": " << measuredEntropy(frequencies)
+        << ", \"max_code_length\": " << maxCodeLength(lengths)
+        << ", \"decode_kernel\": " << table.kernelLength()
+        << ", \"results\": [";
+    for (size_t k = 0; k < results.size(); k++) {
+        const SuiteResult& result = results[k];
+        out << (k > 0 ? "," : "") << "\n      {\"benchmark\": "
+            << jsonString(result.benchmark)
+            << ", \"threads\": " << result.threads
+            << ", \"seconds\": " << std::setprecision(9) 
+            << result.time.seconds << ", \"mb_per_s\": ";
+        if (result.per_byte) {
+            out << std::setprecision(2) << size / result.time.seconds / 1e6;
+        } else {
+            out << "null";
+        }
+#if ZAP_BENCH_TSC
+        out << ", \"cycles\": " << std::setprecision(0) 
+            << result.time.cycles << ", \"cycles_per_byte\": ";
+        if (result.per_byte) {
+            out << std::setprecision(3) << result.time.cycles / size;
+        } else {
+            out << "null";
+        }
+#else
+        out << ", \"cycles\": null, \"cycles_per_byte\": null";
+#endif
+        out << "}";
+    }
+    out << "]}";
+}
+
+/**
+ * name:       runSuite
+ * purpose:    Runs the kernel suite: every kernel on a generated input of
+ *             each size, alphabet size and entropy asked for, at each 
+ *             thread count.
+ * arguments:  argc - the number of arguments after "--suite".
+ *             argv - the arguments; see parseSuiteOptions.
+ * returns:    0 on success, 1 if the arguments are malformed.
+ * effects:    Prints the results as JSON to stdout. Cycle counts are of
+ *             the timing thread, so they are wall-clock cycles when more
+ *             than one thread works.
+ */
+static int runSuite(int argc, char *argv[]) {
+    SuiteOptions options;
+    try {
+        options = parseSuiteOptions(argc, argv);
+    } catch (const std::runtime_error& error) {
+        std::cerr << error.what() << "\nUsage: zap_bench --suite "
+                  << "[--sizes=1K,64K,1G] [--alphabets=2,16,256] "
+                  << "[--entropies=1,4,8] [--threads=1,2,4] "
+                  << "[--filter=PREFIX]" << std::endl;
+        return 1;
+    }
+    std::cout << "{\n  \"suite\": \"kernels\",\n  \"compiler_flags\": " 
+              << jsonString(ZAP_BENCH_FLAGS)
+              << ",\n  \"histogram_kernel\": "
+              << jsonString(histogramKernel())
+              << ",\n  \"checksum_kernel\": "
+              << jsonString(checksumKernel())
+              << ",\n  \"hardware_threads\": "
+              << ThreadPool::hardwareThreads() << ",\n  \"inputs\": [\n";
+    bool first = true;
+    for (uint64_t size : options.sizes) {
+        for (int alphabet : options.alphabets) {
+            // targets past the alphabet's most all give uniform bytes
+            std::vector<double> targets;
+            for (double entropy : options.entropies) {
+                double target = std::min(entropy, std::log2(alphabet));
+                if (std::find(targets.begin(), targets.end(), target) == 
+                    targets.end()) {
+                    targets.push_back(target);
+                }
+            }
+            for (double target : targets) {
+                BenchInput input = generateDistribution(size, alphabet, 
+                                                        target);
+                std::cout << (first ? "" : ",\n");
+                benchSuiteInput(input, alphabet, target, options, 
+                                std::cout);
+                std::cout.flush();
+                first = false;
+            }
+        }
+    }
+    std::cout << "\n  ],\n  \"peak_rss_kb\": " << peakRssKilobytes()
+              << "\n}" << std::endl;
+    return 0;
+}
+
+/**
+ * name:       main
+ * purpose:    Runs the benchmark.
+ * arguments:  argc - the number of arguments.
+ *             argv - extra input files to time besides the corpus, or
+ *             "--suite" and the suite's options.
+ * returns:    0 on success, 1 if a file cannot be read.
+ * effects:    Prints the results as JSON to stdout. A first argument of
+ *             "--suite" runs the kernel suite instead (see runSuite).
+ */
+int main(int argc, char *argv[]) {
+    if (argc > 1 and std::string(argv[1]) == "--suite") {
+        return runSuite(argc - 2, argv + 2);
+    }
+    std::vector<BenchInput> inputs;
+    generateCorpus(64 << 10, inputs);
+    generateCorpus(4 << 20, inputs);
+    for (int i = 1; i < argc; i++) {
+        std::ifstream file(argv[i], std::ios::binary);
+        if (not file) {
+            std::cerr << "Cannot read " << argv[i] << "." << std::endl;
+            return 1;
+        }
+        BenchInput input = {argv[i], {}};
+        input.bytes.assign(std::istreambuf_iterator<char>(file),
+                           std::istreambuf_iterator<char>());
+        if (not input.bytes.empty()) {
+            inputs.push_back(input);
+        }
+    }
+    std::cout << "{\n  \"compiler_flags\": " << jsonString(ZAP_BENCH_FLAGS)
+              << ",\n  \"histogram_kernel\": "
+              << jsonString(histogramKernel())
+              << ",\n  \"checksum_kernel\": "
+              << jsonString(checksumKernel())
+              << ",\n  \"jobs\": 1,\n  \"inputs\": [\n";
+    for (size_t i = 0; i < inputs.size(); i++) {
+        benchInput(inputs[i], std::cout);
+        std::cout << (i + 1 < inputs.size() ? ",\n" : "\n");
+    }
+    std::cout << "  ],\n  \"peak_rss_kb\": " << peakRssKilobytes()
+              << "\n}" << std::endl;
+    return 0;
+}
@@ -0,0 +1,73 @@
+/**
+ * File: ZapFormat.cpp
+ * Description: Implements the helpers declared in ZapFormat.h. Integers
+ * are stored as LEB128 varints: 7 bits per byte, least significant group
+ * first, with the high bit set on every byte except the last.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#include "ZapFormat.h"
+#include <stdexcept>
+
+const std::string LEGACY_MAGIC = "ZAP";
+const std::string CANONICAL_MAGIC = "ZCAN";
+const std::string BLOCK_MAGIC = "ZBLK";
+const std::string TRANSFORM_MAGIC = "ZBLT";
+const std::string DICTIONARY_MAGIC = "ZDIC";
+const std::string MESSAGE_MAGIC = "ZMSG";
+const std::string INDEX_MAGIC = "ZIDX";
+const std::string ADAPTIVE_MAGIC = "ZADP";
+const std::string ARCHIVE_MAGIC = "ZARC";
+
+/**
+ * name:       hasMagic
+ * purpose:    Checks whether data starts with a magic number.
+ * arguments:  data - the bytes to check.
+ *             magic - the magic number.
+ * returns:    true if ++data++ begins with ++magic++.
+ * effects:    None.
+ */
+bool hasMagic(const std::string &data, const std::string &magic) {
+    return data.compare(0, magic.size(), magic) == 0;
+}
+
+/**
+ * name:       putVarint
+ * purpose:    Appends an unsigned integer as a varint.
+ * arguments:  out - the string to append to.
+ *             value - the integer to store.
+ * returns:    void
+ * effects:    Appends 1 to 10 bytes to ++out++.
+ */
+void putVarint(std::string &out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+/**
+ * name:       getVarint
+ * purpose:    Reads a varint written by putVarint.
+ * arguments:  data - the bytes to read from.
+ *             pos - the position of the varint; moved past it.
+ * returns:    The integer read.
+ * effects:    Throws a runtime_error if the varint is truncated or longer
+ *             than 64 bits.
+ */
+uint64_t getVarint(const std::string &data, size_t &pos) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (pos >= data.size()) {
+            throw std::runtime_error("Zapped file header is truncated.");
+        }
+        unsigned char byte = static_cast<unsigned char>(data[pos++]);
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+    throw std::runtime_error("Zapped file header is malformed.");
+}
@@ -0,0 +1,42 @@
+/**
+ * File: ZapFormat.h
+ * Description: Declares the magic numbers that identify each zapped file
+ * layout and the variable-length integer helpers their headers use.
+ * Author: Weston Starbird
+ * Date: 2026-10-14
+ */
+
+#ifndef ZAPFORMAT_H
+#define ZAPFORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/* The original layout written by BinaryIO and PackedBinaryIO. */
+extern const std::string LEGACY_MAGIC;
+/* A single canonical-code stream: code lengths, text length, bits. */
+extern const std::string CANONICAL_MAGIC;
+/* A stream of independent blocks; see BlockFormat.h. */
+extern const std::string BLOCK_MAGIC;
+/* A block stream whose blocks are transformed; see BlockTransform.h. */
+extern const std::string TRANSFORM_MAGIC;
+/* A trained code saved by zap train; see Dictionary.h. */
+extern const std::string DICTIONARY_MAGIC;
+/* A message coded with a dictionary: its id, the text length, bits. */
+extern const std::string MESSAGE_MAGIC;
+/* The last bytes of a block stream that has an index; see BlockFormat.h. */
+extern const std::string INDEX_MAGIC;
+/* Text coded as it arrives, with a code that adapts; see 
+ * AdaptiveModel.h. */
+extern const std::string ADAPTIVE_MAGIC;
+/* Many zapped files in one; see BatchCoder.h. */
+extern const std::string ARCHIVE_MAGIC;
+
+bool hasMagic(const std::string &data, const std::string &magic);
+
+void putVarint(std::string &out, uint64_t value);
+
+uint64_t getVarint(const std::string &data, size_t &pos);
+
+#endif
@@ -9,10 +9,284 @@
  */
 
 #include "HuffmanCoder.h"
+#include "BatchCoder.h"
+#include "BlockFormat.h"
+#include "AdaptiveModel.h"
+#include "Dictionary.h"
 #include <iostream>
+#include <iomanip>
+#include <cctype>
 #include <cstdlib>
+#include <memory>
+#include <stdexcept>
+#include <vector>
 
 
+static const char *USAGE =
+    "Usage: ./zap [zap | unzap] [--canonical] [--max-code-length=N] "
+    "[--block-size=N[K|M]] [--interleave] [--split] [--context] "
+    "[--transform=rle|bwt|mtf[,...]] [--adaptive[=N[K|M]]] [-j N] "
+    "[--no-checksums] [--dictionary=FILE] [--stats[=json]] "
+    "inputFile outputFile\n"
+    "       ./zap unzap --range=START:LENGTH [options] inputFile outputFile\n"
+    "       ./zap [zap | unzap] --batch [--archive] [options] "
+    "(listFile | directory | archive) (outputDirectory | archive)\n"
+    "       ./zap train [--max-code-length=N] dictionaryFile sampleFile...\n"
+    "Use - as inputFile or outputFile for stdin or stdout. -j N codes N "
+    "blocks at once (0 = one per core). --dictionary codes with a "
+    "dictionary made by train, for small messages. --split cuts blocks "
+    "where the kind of data changes. --context codes each byte by the "
+    "byte before it, for structured text. --transform runs each block "
+    "through the listed stages first, e.g. --transform=bwt,mtf. "
+    "--adaptive codes the input as it arrives, rebuilding the code every "
+    "N bytes (16K by default), for live streams such as logs. Blocks "
+    "carry a checksum of their text that unzap verifies; --no-checksums "
+    "leaves it out, for older versions of zap. --stats "
+    "reports the time of each stage (summed over threads with -j) and how "
+    "well the codes did, as one JSON line with --stats=json, which moves "
+    "the other messages to stderr; it goes to stderr when outputFile is -. "
+    "--batch codes many files in one run, -j N at a time: every file under "
+    "a directory, or those in a list of one path per line (optionally a "
+    "tab and the name to store it under), each to its own file under "
+    "outputDirectory; --archive zaps them all into one archive, which "
+    "unzap --batch unpacks into outputDirectory. --range unzaps only LENGTH "
+    "bytes from offset START, decoding just the blocks that hold them.";
+
+// more threads than this would only add block buffers, not speed
+static const int MAX_JOBS = 1024;
+
+/**
+ * name:       parseSize
+ * purpose:    Reads a byte count with an optional K or M suffix.
+ * arguments:  text - the count as typed, e.g. "64K".
+ *             size - set to the count in bytes.
+ * returns:    true if ++text++ is a count from 1 to MAX_BLOCK_SIZE.
+ * effects:    Modifies ++size++.
+ */
+static bool parseSize(const std::string& text, uint64_t& size) {
+    if (text.empty() or not std::isdigit(static_cast<unsigned char>(text[0]))) {
+        return false; // stoull would accept a sign or leading spaces
+    }
+    size_t digits = 0;
+    unsigned long long value;
+    try {
+        value = std::stoull(text, &digits);
+    } catch (const std::logic_error &) { // too large
+        return false;
+    }
+    std::string suffix = text.substr(digits);
+    int shift = 0;
+    if (suffix == "K" or suffix == "k") {
+        shift = 10;
+    } else if (suffix == "M" or suffix == "m") {
+        shift = 20;
+    } else if (not suffix.empty()) {
+        return false;
+    }
+    // compare before shifting so a huge count cannot overflow
+    if (value == 0 or value > (MAX_BLOCK_SIZE >> shift)) {
+        return false;
+    }
+    size = value << shift;
+    return true;
+}
+
+/**
+ * name:       parseOption
+ * purpose:    Applies one command line option to the coder options.
+ * arguments:  option - the option as typed, e.g. "--canonical".
+ *             options - the options to update.
+ *             dictionary_file - set to the file named by --dictionary.
+ * returns:    true if the option was recognized, false otherwise.
+ * effects:    Modifies ++options++ and ++dictionary_file++.
+ */
+static bool parseOption(const std::string& option, CoderOptions& options,
+                        std::string& dictionary_file) {
+    const std::string max_length_flag = "--max-code-length=";
+    const std::string block_size_flag = "--block-size=";
+    const std::string jobs_flag = "--jobs=";
+    const std::string dictionary_flag = "--dictionary=";
+    const std::string transform_flag = "--transform=";
+    const std::string adaptive_flag = "--adaptive=";
+    if (option == "--canonical") {
+        options.canonical = true;
+    } else if (option == "--interleave") {
+        options.interleave = true;
+    } else if (option == "--split") {
+        options.split_blocks = true;
+    } else if (option == "--context") {
+        options.context_model = true;
+    } else if (option == "--no-checksums") {
+        options.block_checksums = false;
+    } else if (option == "--adaptive") {
+        options.adaptive_interval = DEFAULT_ADAPTIVE_INTERVAL;
+    } else if (option.compare(0, adaptive_flag.size(), adaptive_flag) == 0) {
+        return parseSize(option.substr(adaptive_flag.size()), 
+                         options.adaptive_interval);
+    } else if (option.compare(0, max_length_flag.size(), 
+                                            max_length_flag) == 0) {
+        std::string length = option.substr(max_length_flag.size());
+        if (length.empty() or length.find_first_not_of("0123456789") 
+                                                    != std::string::npos) {
+            return false;
+        }
+        try {
+            options.max_code_length = std::stoi(length);
+        } catch (const std::logic_error &) { // too large
+            return false;
+        }
+        if (options.max_code_length < 1 or options.max_code_length > 63) {
+            return false;
+        }
+    } else if (option.compare(0, block_size_flag.size(), 
+                                            block_size_flag) == 0) {
+        return parseSize(option.substr(block_size_flag.size()), 
+                         options.block_size);
+    } else if (option.compare(0, jobs_flag.size(), jobs_flag) == 0) {
+        std::string count = option.substr(jobs_flag.size());
+        if (count.empty() or count.find_first_not_of("0123456789") 
+                                                    != std::string::npos) {
+            return false;
+        }
+        try {
+            options.jobs = std::stoi(count);
+        } catch (const std::logic_error &) { // too large
+            return false;
+        }
+        if (options.jobs > MAX_JOBS) {
+            return false;
+        }
+    } else if (option.compare(0, dictionary_flag.size(), 
+                                            dictionary_flag) == 0) {
+        dictionary_file = option.substr(dictionary_flag.size());
+        return not dictionary_file.empty();
+    } else if (option.compare(0, transform_flag.size(), 
+                                            transform_flag) == 0) {
+        return parseTransforms(option.substr(transform_flag.size()), 
+                               options.transforms);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * name:       parseCount
+ * purpose:    Reads a plain decimal count, which may be 0.
+ * arguments:  text - the count as typed.
+ *             count - set to the count.
+ * returns:    true if ++text++ is only digits and fits in 64 bits.
+ * effects:    Modifies ++count++.
+ */
+static bool parseCount(const std::string& text, uint64_t& count) {
+    if (text.empty() or text.find_first_not_of("0123456789") 
+                                                    != std::string::npos) {
+        return false; // stoull would accept a sign or leading spaces
+    }
+    try {
+        count = std::stoull(text);
+    } catch (const std::logic_error &) { // too large
+        return false;
+    }
+    return true;
+}
+
+/**
+ * name:       parseRange
+ * purpose:    Reads the START:LENGTH of --range.
+ * arguments:  text - the range as typed, e.g. "1000:500".
+ *             start - set to the offset of the first byte.
+ *             length - set to the number of bytes.
+ * returns:    true if ++text++ is two counts split by a colon.
+ * effects:    Modifies ++start++ and ++length++.
+ */
+static bool parseRange(const std::string& text, uint64_t& start,
+                       uint64_t& length) {
+    size_t colon = text.find(':');
+    return colon != std::string::npos and 
+           parseCount(text.substr(0, colon), start) and
+           parseCount(text.substr(colon + 1), length);
+}
+
+/**
+ * name:       train
+ * purpose:    Runs "zap train": trains a dictionary over sample files and
+ *             saves it.
+ * arguments:  argc, argv - the command line; options start at argv[2], 
+ *             followed by the dictionary file and the sample files.
+ * returns:    0 on success, EXIT_FAILURE if the command line is wrong.
+ * effects:    Writes the dictionary file and prints its id to stdout.
+ */
+static int train(int argc, char* argv[]) {
+    CoderOptions options;
+    std::string unused;
+    int i = 2;
+    while (i < argc and std::string(argv[i]).compare(0, 2, "--") == 0) {
+        if (not parseOption(argv[i], options, unused)) {
+            std::cerr << USAGE << std::endl;
+            return EXIT_FAILURE;
+        }
+        i++;
+    }
+    if (argc - i < 2) { // a dictionary file and at least one sample
+        std::cerr << USAGE << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::string dictionary_file(argv[i++]);
+    std::vector<std::string> samples(argv + i, argv + argc);
+    int max_length = options.max_code_length > 0 
+                        ? options.max_code_length 
+                        : DEFAULT_DICTIONARY_CODE_LENGTH;
+    Dictionary dictionary = Dictionary::train(samples, max_length);
+    dictionary.save(dictionary_file);
+    std::cout << "Trained dictionary " << std::hex << std::setw(8) 
+              << std::setfill('0') << dictionary.id() << std::dec
+              << " from " << samples.size() << " sample file(s)." 
+              << std::endl;
+    return 0;
+}
+
+/**
+ * name:       batch
+ * purpose:    Runs "zap --batch" or "unzap --batch".
+ * arguments:  mode - "zap" or "unzap".
+ *             options - the settings each file is coded with.
+ *             source - the directory, list or archive to code.
+ *             destination - the output directory, or the archive to write
+ *             when ++archive++ is set.
+ *             archive - true to zap into one archive.
+ *             stats - set to the batch's timings and counters.
+ * returns:    0 on success, EXIT_FAILURE if the mode is wrong or --archive
+ *             is given to unzap.
+ * effects:    Writes the results and prints how many files were coded.
+ */
+static int batch(const std::string& mode, const CoderOptions& options,
+                 const std::string& source, const std::string& destination,
+                 bool archive, CoderStats& stats) {
+    if ((mode != "zap" and mode != "unzap") or (archive and mode != "zap")) {
+        std::cerr << USAGE << std::endl;
+        return EXIT_FAILURE;
+    }
+    BatchCoder coder(options);
+    uint64_t files = 0;
+    if (mode == "zap") {
+        std::vector<BatchFile> inputs = listBatchFiles(source);
+        files = archive ? coder.zapArchive(inputs, destination)
+                        : coder.zap(inputs, destination);
+    } else if (isBatchArchive(source)) {
+        files = coder.unzapArchive(source, destination);
+    } else {
+        files = coder.unzap(listBatchFiles(source), destination);
+    }
+    stats = coder.statistics();
+    std::ostream& messages = (destination == STDIO_NAME or 
+                              options.messages_to_stderr) ? std::cerr 
+                                                          : std::cout;
+    messages << "Success! " << (mode == "zap" ? "Zapped " : "Unzapped ") 
+             << files << " file(s)." << std::endl;
+    return 0;
+}
+
 /**
  * name:       main
  * purpose:    Serves as the entry point for the Huffman coding program, 
@@ -20,47 +294,111 @@
  *             decompress ("unzap") a given input file and write the result 
  *             to an output file.
  * arguments:  argc - the number of command line arguments passed to the 
- * program.
+ *             program.
  *             argv - an array of pointers to the strings representing those 
  *             arguments.
  * returns:    0 on successful compression or decompression; 
  *             EXIT_FAILURE if there is an error in command line arguments or 
- *             during
- *             the operation.
+ *             during the operation.
  * effects:    Parses command line arguments to determine operation mode 
- *             (zap or unzap),
- *             input file name, and output file name. Depending on the mode, 
- *             it either 
- *             compresses or decompresses the content of the input file and 
- *             writes the 
+ *             (zap or unzap), any options, the input file name, and the 
+ *             output file name. Depending on the mode, it either compresses
+ *             or decompresses the content of the input file and writes the 
  *             result to the output file. Prints to stderr and exits with 
- *             EXIT_FAILURE 
- *             if the command line arguments do not match expected format 
- *             or if an 
- *             unsupported mode is provided.
+ *             EXIT_FAILURE if the command line arguments do not match the 
+ *             expected format or if an unsupported mode or option is given.
  */
 int main(int argc, char* argv[]) {
-    if (argc != 4) {
-        std::cerr << "Usage: ./zap [zap | unzap] inputFile outputFile" 
-                                                            << std::endl;
+    if (argc < 4) {
+        std::cerr << USAGE << std::endl;
         return EXIT_FAILURE;
     }
     // read in first command line argument into string "mode"
     std::string mode(argv[1]);
-    std::string input_file(argv[2]);
-    std::string output_file(argv[3]);
+    if (mode == "train") {
+        return train(argc, argv);
+    }
+    // options sit between the mode and the two file names
+    CoderOptions options;
+    std::string dictionary_file;
+    bool print_stats = false, stats_json = false;
+    bool batch_mode = false, archive = false;
+    bool ranged = false;
+    uint64_t range_start = 0, range_length = 0;
+    const std::string range_flag = "--range=";
+    for (int i = 2; i < argc - 2; i++) {
+        std::string option(argv[i]);
+        if (option == "-j" and i + 1 < argc - 2) {
+            option = "--jobs=" + std::string(argv[++i]); // "-j N"
+        }
+        if (option == "--stats" or option == "--stats=json") {
+            // a report on the run, not a setting of the coder
+            print_stats = true;
+            stats_json = (option == "--stats=json");
+            continue;
+        }
+        if (option == "--batch" or option == "--archive") {
+            batch_mode = true; // --archive implies --batch
+            archive = archive or option == "--archive";
+            continue;
+        }
+        if (option.compare(0, range_flag.size(), range_flag) == 0) {
+            ranged = true; // picks what unzap writes, not how it codes
+            if (not parseRange(option.substr(range_flag.size()), 
+                               range_start, range_length)) {
+                std::cerr << USAGE << std::endl;
+                return EXIT_FAILURE;
+            }
+            continue;
+        }
+        if (not parseOption(option, options, dictionary_file)) {
+            std::cerr << USAGE << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    // a JSON report must be all that stdout holds
+    options.messages_to_stderr = stats_json;
+    if (ranged and (mode != "unzap" or batch_mode)) {
+        std::cerr << USAGE << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::string input_file(argv[argc - 2]);
+    std::string output_file(argv[argc - 1]);
+    std::unique_ptr<Dictionary> dictionary;
+    if (not dictionary_file.empty()) {
+        dictionary.reset(new Dictionary(dictionary_file));
+        options.dictionary = dictionary.get();
+    }
+    // like the coder's messages, the report is kept off stdout when it
+    // carries data
+    std::ostream& report = (output_file == STDIO_NAME) ? std::cerr 
+                                                       : std::cout;
+    if (batch_mode) {
+        CoderStats stats;
+        int result = batch(mode, options, input_file, output_file, archive,
+                           stats);
+        if (result == 0 and print_stats) {
+            printStats(report, stats, mode, stats_json);
+        }
+        return result;
+    }
 
-    HuffmanCoder coder;
+    HuffmanCoder coder(options);
         // check what mode is, if command line format is wrong, print an error
         if (mode == "zap") {
             coder.encoder(input_file, output_file);
+        } else if (mode == "unzap" and ranged) {
+            coder.decodeRange(input_file, output_file, range_start, 
+                              range_length);
         } else if (mode == "unzap") {
             coder.decoder(input_file, output_file);
         } else {
-            std::cerr << "Usage: ./zap [zap | unzap] inputFile outputFile" 
-                                                                << std::endl;
+            std::cerr << USAGE << std::endl;
             return EXIT_FAILURE;
         }
+    if (print_stats) {
+        printStats(report, coder.statistics(), mode, stats_json);
+    }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -5,17 +5,18 @@
 // Assume HuffmanTreeNode and NodeComparator are included via the header.
 
 void count_freqs(std::istream &text) {
-    std::unordered_map<char, int> frequencies;
-    char ch; 
-    while (text >> std::noskipws >> ch) {  
-        // read every char including whitespace
-        frequencies[ch]++; 
-        // increment the frequency 
-        //corresponding to the current char ch on the unordered mapd
-    }
-    for (const auto &pair : frequencies) { 
-        // increment through pairs of frequencies and print them
-        std::cout << pair.first << ": " << pair.second << std::endl;
+    // read every char including whitespace, then count them all at once
+    std::string contents((std::istreambuf_iterator<char>(text)),
+                         std::istreambuf_iterator<char>());
+    FrequencyTable frequencies = {};
+    countBytes(reinterpret_cast<const unsigned char *>(contents.data()),
+               contents.size(), frequencies);
+    for (int c = 0; c < 256; c++) { 
+        // print the frequency of every char that appeared, in byte order
+        if (frequencies[c] > 0) {
+            std::cout << static_cast<char>(c) << ": " << frequencies[c]
+                      << std::endl;
+        }
     }
 }
 
@@ -6,7 +6,9 @@
 #include <iostream>
 #include <unordered_map>
 #include <queue> // For priority_queue
+#include <iterator>
 #include "HuffmanTreeNode.h"
+#include "Histogram.h"
 
 void count_freqs(std::istream &text);
 std::string serialize_tree(HuffmanTreeNode *root);
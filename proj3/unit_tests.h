@@ -8,13 +8,63 @@
  * Date: 2024-04-03
  */
 
+#include <sys/stat.h>
+#include <unistd.h>
 #include <cassert> 
+#include <cstdio> 
+#include <fstream> 
 #include <sstream> 
 #include <string> 
+#include <chrono>
+#include <thread>
+#include <functional>
+#include <cstdlib>
+#include <iostream>
 #include "phaseOne.h"
 #include "HuffmanCoder.h"
 #include "HuffmanTreeNode.h"
 #include "ZapUtil.h"
+#include "BitIO.h"
+#include "HuffmanDecodeTable.h"
+#include "CanonicalCode.h"
+#include "LengthLimit.h"
+#include "Histogram.h"
+#include "FileIO.h"
+#include "ThreadPool.h"
+#include "TreeArena.h"
+#include "StreamEncoder.h"
+#include "Dictionary.h"
+#include "BlockSplit.h"
+#include "ContextModel.h"
+#include "BlockTransform.h"
+#include "BatchCoder.h"
+#include "ZapFormat.h"
+#include "Checksum.h"
+#include "PackedBinaryIO.h"
+
+// noiseText(): Returns ++size++ bytes of noise from a linear congruential
+// generator started at ++seed++, the same bytes for the same seed.
+std::string noiseText(size_t size, uint32_t seed) {
+    std::string text;
+    uint32_t state = seed;
+    for (size_t i = 0; i < size; i++) {
+        state = state * 1103515245 + 12345;
+        text += static_cast<char>(state >> 24);
+    }
+    return text;
+}
+
+// expectRuntimeError(): Runs ++action++ and returns the message of the
+// runtime_error it throws; aborts when it throws none, even under NDEBUG.
+std::string expectRuntimeError(const std::function<void()> &action) {
+    try {
+        action();
+    } catch (const std::runtime_error &error) {
+        return error.what();
+    }
+    std::cerr << "expected a runtime_error, but none was thrown\n";
+    std::abort();
+}
 
 // unit_tests for phaseOne --> translate to phaseTwo(same methods)
 
@@ -93,20 +143,29 @@ void testEncodeDecodeText() {
     HuffmanCoder hc;
     HuffmanTreeNode* root = makeFigure1Tree('\0');
 
-    std::unordered_map<char, std::string> charCodes;
-    hc.generateCharCodes(root, charCodes, "");
+    CodeTable charCodes = {};
+    hc.generateCharCodes(root, charCodes);
     std::string originalText = "aabbcc";
-    std::string encodedText = hc.encodeText(originalText, charCodes);
-    std::string decodedText = hc.decodeText(encodedText, root);
+    BitWriter writer;
+    hc.encodeText(originalText, charCodes, writer);
+    writer.flush();
+    BitReader reader(reinterpret_cast<const unsigned char *>(
+                        writer.bytes().data()), writer.bytes().size(),
+                     writer.bitCount());
+    std::string decodedText = hc.decodeText(reader, root);
 
     assert(originalText == decodedText);
 }
 
 // testBuildHuffmanTree(): Validates Huffman tree construction from frequencies
 void testBuildHuffmanTree() {
-    std::unordered_map<char, int> frequencies = {{'a', 3}, {'b', 2}, {'c', 1}};
+    FrequencyTable frequencies = {};
+    frequencies['a'] = 3;
+    frequencies['b'] = 2;
+    frequencies['c'] = 1;
     HuffmanCoder hc;
-    HuffmanTreeNode* root = hc.buildHuffmanTree(frequencies);
+    TreeArena arena;
+    HuffmanTreeNode* root = hc.buildHuffmanTree(frequencies, arena);
 
     // Check the structure manually or use treeEquals from ZapUtil if 
     // applicable
@@ -126,15 +185,20 @@ void testEncodeDecodeTextComprehensive() {
     HuffmanTreeNode* root = makeFigure1Tree('\0');
 
     // Generate Huffman codes based on the tree structure
-    std::unordered_map<char, std::string> charCodes;
-    hc.generateCharCodes(root, charCodes, "");
+    CodeTable charCodes = {};
+    hc.generateCharCodes(root, charCodes);
 
     // Test various strings
     std::vector<std::string> testStrings = {"a", "b", "c", "d", "e", "f", 
                                                     "abcdef", "fabecd", ""};
     for (const auto& originalText : testStrings) {
-        std::string encodedText = hc.encodeText(originalText, charCodes);
-        std::string decodedText = hc.decodeText(encodedText, root);
+        BitWriter writer;
+        hc.encodeText(originalText, charCodes, writer);
+        writer.flush();
+        BitReader reader(reinterpret_cast<const unsigned char *>(
+                            writer.bytes().data()), writer.bytes().size(),
+                         writer.bitCount());
+        std::string decodedText = hc.decodeText(reader, root);
 
         assert(originalText == decodedText);
     }
@@ -148,10 +212,1365 @@ void testSerializeDeserializeTree() {
 
     // Serialize then deserialize the tree
     std::string serializedTree = hc.serializeHuffmanTree(originalTree);
+    TreeArena arena;
     HuffmanTreeNode* deserializedTree = hc.deserializeHuffmanTree(
-                                                        serializedTree);
+                                                serializedTree, arena);
 
     // Use treeEquals to assert tree structure equality
     assert(treeEquals(originalTree, deserializedTree, true, false));
 }
 
+// testBitWriterPacking(): Checks codes are packed most significant bit first
+// with a zero padded final byte, the same layout BinaryIO writes.
+void testBitWriterPacking() {
+    BitWriter writer;
+    writer.write(0x5, 3);  // 101
+    writer.write(0x1, 5);  // 00001
+    writer.write(0x3, 2);  // 11
+    writer.flush();
+
+    assert(writer.bitCount() == 10);
+    assert(writer.bytes().size() == 2);
+    assert(static_cast<unsigned char>(writer.bytes()[0]) == 0xA1);
+    assert(static_cast<unsigned char>(writer.bytes()[1]) == 0xC0);
+}
+
+// testBitReaderRoundTrip(): Reads back long and short codes, including runs
+// of zeros that cross the 64-bit accumulator.
+void testBitReaderRoundTrip() {
+    BitWriter writer;
+    writer.write(0x1ABCDEF012345ULL, 49);
+    writer.writeZeros(70);
+    writer.write(0x7, 3);
+    writer.write(0xFFFFFFFFFFFFFFFFULL, 64);
+    writer.flush();
+    assert(writer.bitCount() == 49 + 70 + 3 + 64);
+
+    BitReader reader(reinterpret_cast<const unsigned char *>(
+                        writer.bytes().data()), writer.bytes().size(),
+                     writer.bitCount());
+    assert(reader.peek(49) == 0x1ABCDEF012345ULL);
+    reader.consume(49);
+    for (int i = 0; i < 70; i++) {
+        assert(reader.readBit() == 0);
+    }
+    assert(reader.peek(3) == 0x7);
+    reader.consume(3);
+    assert(reader.peek(32) == 0xFFFFFFFFULL);
+    reader.consume(32);
+    assert(reader.peek(32) == 0xFFFFFFFFULL);
+    reader.consume(32);
+    assert(reader.bitsRemaining() == 0);
+
+    expectRuntimeError([&]() {
+        reader.consume(1);
+    });
+}
+
+// testDecodeTableLongCodes(): Decodes codes longer than the primary table,
+// including ones that need a third level, and rejects a code no symbol has.
+void testDecodeTableLongCodes() {
+    // a degenerate "staircase" code: 0, 10, 110, ..., 1...10 (25 bits)
+    CodeTable codes = {};
+    for (int i = 0; i < 25; i++) {
+        codes['a' + i].bits = ((uint64_t(1) << i) - 1) << 1;
+        codes['a' + i].length = i + 1;
+    }
+    HuffmanDecodeTable table;
+    table.build(codes);
+    assert(table.maxCodeLength() == 25);
+
+    std::string text = "yaxbcdmwakqr";
+    BitWriter writer;
+    for (char c : text) {
+        writer.write(codes[c].bits, codes[c].length);
+    }
+    writer.flush();
+    BitReader reader(reinterpret_cast<const unsigned char *>(
+                        writer.bytes().data()), writer.bytes().size(),
+                     writer.bitCount());
+    std::string decoded;
+    table.decode(reader, decoded);
+    assert(decoded == text);
+
+    // 25 ones is not a code of this table
+    BitWriter bad;
+    bad.write((uint64_t(1) << 25) - 1, 25);
+    bad.flush();
+    BitReader bad_reader(reinterpret_cast<const unsigned char *>(
+                            bad.bytes().data()), bad.bytes().size(),
+                         bad.bitCount());
+    expectRuntimeError([&]() {
+        table.decode(bad_reader, decoded);
+    });
+}
+
+// testCanonicalCodes(): Checks canonical codes for the figure 1 tree and
+// that the code-length header round trips and rejects bad lengths.
+void testCanonicalCodes() {
+    HuffmanTreeNode* root = makeFigure1Tree('\0');
+    CodeLengths lengths = codeLengthsFromTree(root);
+    assert(lengths['a'] == 3 and lengths['f'] == 3);
+    assert(lengths['c'] == 2 and lengths['d'] == 2);
+
+    // length 2 first in byte order, then length 3 in byte order
+    CodeTable codes = canonicalCodes(lengths);
+    assert(codes['c'].bits == 0x0 and codes['d'].bits == 0x1);
+    assert(codes['a'].bits == 0x4 and codes['b'].bits == 0x5);
+    assert(codes['e'].bits == 0x6 and codes['f'].bits == 0x7);
+
+    std::string header = serializeCodeLengths(lengths);
+    assert(header.size() == 1 + 2 * 6);
+    size_t pos = 0;
+    assert(deserializeCodeLengths(header, pos) == lengths);
+    assert(pos == header.size());
+
+    // three codes of length 1 cannot exist
+    CodeLengths bad = {};
+    bad['x'] = bad['y'] = bad['z'] = 1;
+    expectRuntimeError([&]() {
+        canonicalCodes(bad);
+    });
+}
+
+// testLengthLimitedCodeLengths(): Checks package-merge finds the optimal
+// limited lengths for a small case and keeps a skewed alphabet complete.
+void testLengthLimitedCodeLengths() {
+    // unconstrained lengths would be 4, 4, 3, 2, 1
+    FrequencyTable small = {};
+    small['a'] = 1;
+    small['b'] = 1;
+    small['c'] = 2;
+    small['d'] = 4;
+    small['e'] = 8;
+    CodeLengths lengths = lengthLimitedCodeLengths(small, 3);
+    assert(lengths['a'] == 3 and lengths['b'] == 3);
+    assert(lengths['c'] == 3 and lengths['d'] == 3);
+    assert(lengths['e'] == 1);
+    assert(encodedBitCount(small, lengths) == 32);
+
+    // Fibonacci frequencies give a 29-deep unconstrained tree
+    FrequencyTable skewed = {};
+    uint64_t a = 1, b = 1;
+    for (int symbol = 0; symbol < 30; symbol++) {
+        skewed[symbol] = a;
+        uint64_t next = a + b;
+        a = b;
+        b = next;
+    }
+    lengths = lengthLimitedCodeLengths(skewed, 15);
+    assert(maxCodeLength(lengths) == 15);
+    double kraft = 0;
+    for (int symbol = 0; symbol < 30; symbol++) {
+        assert(lengths[symbol] >= 1);
+        kraft += 1.0 / (uint64_t(1) << lengths[symbol]);
+    }
+    assert(kraft == 1.0);
+    // a complete code turns back into a full tree
+    TreeArena arena;
+    HuffmanTreeNode* root = treeFromCodes(canonicalCodes(lengths), arena);
+    assert(codeLengthsFromTree(root) == lengths);
+}
+
+// testGenerateCharCodesTable(): Checks the flat code table for the figure 1
+// tree and the one-bit code given to a tree that is a single leaf.
+void testGenerateCharCodesTable() {
+    HuffmanCoder hc;
+    HuffmanTreeNode* root = makeFigure1Tree('\0');
+    CodeTable codes = {};
+    hc.generateCharCodes(root, codes);
+    assert(codes['a'].bits == 0x0 and codes['a'].length == 3);
+    assert(codes['f'].bits == 0x3 and codes['f'].length == 3);
+    assert(codes['c'].bits == 0x2 and codes['c'].length == 2);
+    assert(codes['d'].bits == 0x3 and codes['d'].length == 2);
+    assert(codes['z'].length == 0);
+
+    HuffmanTreeNode leaf('q', 5);
+    CodeTable single = {};
+    hc.generateCharCodes(&leaf, single);
+    assert(single['q'].bits == 0 and single['q'].length == 1);
+}
+
+// testSinglePassInput(): Checks zapping and unzapping each read their input
+// file exactly once.
+void testSinglePassInput() {
+    const std::string text = "the quick brown fox jumps over the lazy dog";
+    std::ofstream("single_pass_test.txt", std::ios::binary) << text;
+
+    HuffmanCoder zapper;
+    zapper.encoder("single_pass_test.txt", "single_pass_test.zap");
+    assert(zapper.bytesRead() == text.size());
+
+    std::ifstream zapped("single_pass_test.zap", 
+                                        std::ios::binary | std::ios::ate);
+    uint64_t zapped_size = zapped.tellg();
+    HuffmanCoder unzapper;
+    unzapper.decoder("single_pass_test.zap", "single_pass_test.out");
+    assert(unzapper.bytesRead() == zapped_size);
+
+    std::remove("single_pass_test.txt");
+    std::remove("single_pass_test.zap");
+    std::remove("single_pass_test.out");
+}
+
+// testHistogramKernels(): Checks that the runtime-selected histogram kernel
+// and the scalar kernel agree with a plain count on random bytes, long runs
+// of one byte, and sizes and offsets that do not line up with a vector.
+void testHistogramKernels() {
+    std::string data = noiseText(5000, 12345);
+    data.append(1000, 'x');
+    data.append(77, '\0');
+    data.append(33, '\xff');
+    for (size_t offset = 0; offset < 3; offset++) {
+        for (size_t size : {size_t(0), size_t(1), size_t(31), size_t(65),
+                            data.size() - offset}) {
+            const unsigned char *start = 
+                reinterpret_cast<const unsigned char *>(data.data()) + offset;
+            FrequencyTable expected = {};
+            for (size_t i = 0; i < size; i++) {
+                expected[start[i]]++;
+            }
+            FrequencyTable fast = {};
+            FrequencyTable scalar = {};
+            countBytes(start, size, fast);
+            countBytesScalar(start, size, scalar);
+            assert(fast == expected);
+            assert(scalar == expected);
+        }
+    }
+    std::string kernel = histogramKernel();
+    assert(kernel == "avx2" or kernel == "neon" or kernel == "scalar");
+}
+
+// testFileWriterAndMappedFile(): Checks that FileWriter keeps small,
+// chunk-sized and repeated writes in order, and that MappedFile reads the
+// result back, including an empty file.
+void testFileWriterAndMappedFile() {
+    std::string expected = "header";
+    std::string big(FileWriter::CHUNK_SIZE + 123, 'b');
+    {
+        FileWriter writer("file_io_test.bin");
+        writer.write("header");
+        writer.write(big);
+        writer.writeRepeated('r', FileWriter::CHUNK_SIZE * 2 + 5);
+        writer.write(std::string("tail"));
+        writer.close();
+    }
+    expected += big + std::string(FileWriter::CHUNK_SIZE * 2 + 5, 'r')
+                                                                + "tail";
+    {
+        MappedFile mapped("file_io_test.bin");
+        assert(mapped.size() == expected.size());
+        assert(std::string(reinterpret_cast<const char *>(mapped.data()),
+                           mapped.size()) == expected);
+    }
+    {
+        FileWriter writer("file_io_test.bin");
+        writer.close();
+        MappedFile mapped("file_io_test.bin");
+        assert(mapped.size() == 0);
+    }
+    std::remove("file_io_test.bin");
+}
+
+// testBlockStreamRoundTrip(): Checks that a "ZBLK" stream with blocks much
+// smaller than the input, and a final short block, decodes to the input.
+void testBlockStreamRoundTrip() {
+    std::string text;
+    for (int i = 0; i < 3000; i++) {
+        // later blocks use different letters, so each gets its own code
+        text += static_cast<char>('a' + (i * i / 700) % 26);
+    }
+    text.append(1234, 'z');
+    {
+        std::ofstream out("block_test.txt", std::ios::binary);
+        out << text;
+    }
+    CoderOptions options;
+    options.block_size = 1000;
+    HuffmanCoder zapper(options);
+    zapper.encoder("block_test.txt", "block_test.zap");
+    assert(zapper.bytesRead() == text.size());
+
+    std::ifstream zapped("block_test.zap", std::ios::binary);
+    std::string magic(4, '\0');
+    zapped.read(&magic[0], 4);
+    assert(magic == "ZBLK");
+
+    HuffmanCoder unzapper;
+    unzapper.decoder("block_test.zap", "block_test.out");
+    std::ifstream decoded("block_test.out", std::ios::binary);
+    std::ostringstream contents;
+    contents << decoded.rdbuf();
+    assert(contents.str() == text);
+
+    std::remove("block_test.txt");
+    std::remove("block_test.zap");
+    std::remove("block_test.out");
+}
+
+// testThreadPool(): Checks that pooled and inline tasks all run, that a
+// task's exception reaches its future, and that a stream coded with
+// several jobs decodes to the input.
+void testThreadPool() {
+    for (size_t threads : {size_t(0), size_t(3)}) {
+        ThreadPool pool(threads);
+        assert(pool.size() == threads);
+        std::vector<int> results(50, 0);
+        std::vector<std::future<void>> done;
+        for (int i = 0; i < 50; i++) {
+            done.push_back(pool.submit([&results, i]() {
+                results[i] = i * i;
+            }));
+        }
+        for (std::future<void> &task : done) {
+            task.get();
+        }
+        for (int i = 0; i < 50; i++) {
+            assert(results[i] == i * i);
+        }
+        std::future<void> failed = pool.submit([]() {
+            throw std::runtime_error("task failed");
+        });
+        expectRuntimeError([&]() {
+            failed.get();
+        });
+    }
+
+    std::string text;
+    for (int i = 0; i < 20000; i++) {
+        text += static_cast<char>('a' + (i / 512 + i % 7) % 26);
+    }
+    {
+        std::ofstream out("pool_test.txt", std::ios::binary);
+        out << text;
+    }
+    CoderOptions options;
+    options.block_size = 1024;
+    options.jobs = 4;
+    HuffmanCoder zapper(options);
+    zapper.encoder("pool_test.txt", "pool_test.zap");
+    HuffmanCoder unzapper(options);
+    unzapper.decoder("pool_test.zap", "pool_test.out");
+    std::ifstream decoded("pool_test.out", std::ios::binary);
+    std::ostringstream contents;
+    contents << decoded.rdbuf();
+    assert(contents.str() == text);
+
+    std::remove("pool_test.txt");
+    std::remove("pool_test.zap");
+    std::remove("pool_test.out");
+}
+
+// testInterleavedBlocks(): Checks that --interleave writes INTERLEAVED_BLOCK
+// blocks and that they decode, including a last block shorter than the
+// number of streams.
+void testInterleavedBlocks() {
+    std::string text;
+    for (int i = 0; i < 2005; i++) { // two 1001-byte blocks and 3 bytes
+        text += static_cast<char>('a' + (i * 7 + i / 300) % 19);
+    }
+    {
+        std::ofstream out("interleave_test.txt", std::ios::binary);
+        out << text;
+    }
+    CoderOptions options;
+    options.block_size = 1001;
+    options.interleave = true;
+    HuffmanCoder zapper(options);
+    zapper.encoder("interleave_test.txt", "interleave_test.zap");
+
+    std::ifstream zapped("interleave_test.zap", std::ios::binary);
+    std::string header(7, '\0');
+    zapped.read(&header[0], 7); // magic, 2-byte block size, block type
+    assert(header.compare(0, 4, "ZBLK") == 0);
+    assert(static_cast<unsigned char>(header[6]) == 
+           (INTERLEAVED_BLOCK | CHECKSUM_FLAG));
+
+    HuffmanCoder unzapper;
+    unzapper.decoder("interleave_test.zap", "interleave_test.out");
+    std::ifstream decoded("interleave_test.out", std::ios::binary);
+    std::ostringstream contents;
+    contents << decoded.rdbuf();
+    assert(contents.str() == text);
+
+    std::remove("interleave_test.txt");
+    std::remove("interleave_test.zap");
+    std::remove("interleave_test.out");
+}
+
+// testTreeArena(): Checks that a tree over all 256 bytes fits in one arena,
+// that clearing lets the arena be reused, and that overfilling it throws.
+void testTreeArena() {
+    FrequencyTable frequencies = {};
+    for (int symbol = 0; symbol < 256; symbol++) {
+        frequencies[symbol] = symbol + 1;
+    }
+    HuffmanCoder hc;
+    TreeArena arena;
+    for (int round = 0; round < 3; round++) {
+        arena.clear();
+        HuffmanTreeNode* root = hc.buildHuffmanTree(frequencies, arena);
+        assert(arena.size() == TreeArena::MAX_NODES);
+        assert(root->get_freq() == 256 * 257 / 2);
+        CodeLengths lengths = codeLengthsFromTree(root);
+        for (int symbol = 0; symbol < 256; symbol++) {
+            assert(lengths[symbol] > 0);
+        }
+    }
+    expectRuntimeError([&]() {
+        arena.create('x', 1);
+    });
+    assert(arena.size() == TreeArena::MAX_NODES);
+}
+
+// testHuffmanCodeLengths(): Checks that the in-place code lengths and the
+// two-queue tree are both optimal, including frequencies too large for the
+// tree nodes' int counts.
+void testHuffmanCodeLengths() {
+    HuffmanCoder hc;
+    TreeArena arena;
+    uint64_t seed = 12345;
+    for (int round = 0; round < 200; round++) {
+        FrequencyTable frequencies = {};
+        int distinct = 1 + round % 256;
+        for (int i = 0; i < distinct; i++) {
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            int symbol = (seed >> 33) % 256;
+            frequencies[symbol] += (round % 3 == 0) ? 1 : (seed >> 50) + 1;
+        }
+        CodeLengths lengths = huffmanCodeLengths(frequencies);
+        arena.clear();
+        CodeLengths tree_lengths = codeLengthsFromTree(
+                                    hc.buildHuffmanTree(frequencies, arena));
+        assert(encodedBitCount(frequencies, lengths) ==
+               encodedBitCount(frequencies, tree_lengths));
+        // a complete code, so the lengths form a full tree
+        arena.clear();
+        treeFromCodes(canonicalCodes(lengths), arena);
+    }
+
+    // two bytes over INT_MAX each: an int weight would wrap and pair them
+    FrequencyTable large = {};
+    large['a'] = 3000000000ULL;
+    large['b'] = 3000000000ULL;
+    large['c'] = 1;
+    large['d'] = 1;
+    CodeLengths lengths = huffmanCodeLengths(large);
+    assert(lengths['a'] == 2 and lengths['b'] == 1);
+    assert(lengths['c'] == 3 and lengths['d'] == 3);
+    arena.clear();
+    CodeLengths tree_lengths = codeLengthsFromTree(
+                                    hc.buildHuffmanTree(large, arena));
+    assert(encodedBitCount(large, tree_lengths) ==
+           encodedBitCount(large, lengths));
+
+    FrequencyTable single = {};
+    single['q'] = 7;
+    assert(huffmanCodeLengths(single)['q'] == 1);
+}
+
+// testBufferApi(): Checks that compress, StreamEncoder and decompress agree
+// with the file coders, across repeated calls on one coder.
+void testBufferApi() {
+    std::string text;
+    for (int i = 0; i < 30000; i++) {
+        text += static_cast<char>('a' + (i * i / 1000 + i % 5) % 26);
+    }
+    const unsigned char* bytes = 
+                reinterpret_cast<const unsigned char *>(text.data());
+    {
+        std::ofstream out("buffer_test.txt", std::ios::binary);
+        out << text;
+    }
+    CoderOptions options;
+    options.block_size = 4096;
+    HuffmanCoder file_coder(options);
+    file_coder.encoder("buffer_test.txt", "buffer_test.zap");
+    std::ifstream zapped_file("buffer_test.zap", std::ios::binary);
+    std::ostringstream file_contents;
+    file_contents << zapped_file.rdbuf();
+    std::string expected = file_contents.str();
+
+    HuffmanCoder coder(options);
+    std::vector<unsigned char> zapped, decoded;
+    for (int round = 0; round < 3; round++) {
+        size_t size = (round == 1) ? 0 : text.size();
+        coder.compress(bytes, size, zapped);
+        if (round != 1) {
+            assert(std::string(zapped.begin(), zapped.end()) == expected);
+        }
+        coder.decompress(zapped.data(), zapped.size(), decoded);
+        assert(std::string(decoded.begin(), decoded.end()) == 
+                                                    text.substr(0, size));
+    }
+
+    // pieces of every size give the same stream as one buffer
+    StreamEncoder stream(options);
+    for (size_t piece : {size_t(1), size_t(777), size_t(4096), 
+                                                        size_t(10000)}) {
+        std::vector<unsigned char> pushed;
+        for (size_t pos = 0; pos < text.size(); pos += piece) {
+            stream.push(bytes + pos, std::min(piece, text.size() - pos),
+                        pushed);
+        }
+        stream.finish(pushed);
+        assert(std::string(pushed.begin(), pushed.end()) == expected);
+    }
+
+    // unframed layouts decode from memory too
+    HuffmanCoder legacy;
+    legacy.encoder("buffer_test.txt", "buffer_test.zap");
+    std::ifstream legacy_file("buffer_test.zap", std::ios::binary);
+    std::ostringstream legacy_contents;
+    legacy_contents << legacy_file.rdbuf();
+    std::string legacy_zapped = legacy_contents.str();
+    coder.decompress(reinterpret_cast<const unsigned char *>(
+                        legacy_zapped.data()), legacy_zapped.size(), decoded);
+    assert(std::string(decoded.begin(), decoded.end()) == text);
+
+    // buffers too short for any magic are refused, not read past
+    for (const std::string& magic : {BLOCK_MAGIC, ADAPTIVE_MAGIC}) {
+        for (size_t size = 1; size < magic.size(); size++) {
+            std::vector<unsigned char> cut(magic.begin(), 
+                                           magic.begin() + size);
+            expectRuntimeError([&]() {
+                coder.decompress(cut.data(), cut.size(), decoded);
+            });
+            expectRuntimeError([&]() {
+                coder.decompressRange(cut.data(), cut.size(), 0, 1, decoded);
+            });
+        }
+    }
+
+    std::remove("buffer_test.txt");
+    std::remove("buffer_test.zap");
+}
+
+// testDictionaryMessages(): Checks that a trained dictionary survives a
+// save and load, and that small messages coded with it carry only a few
+// header bytes, decode, and are refused without the same dictionary.
+void testDictionaryMessages() {
+    std::string sample;
+    for (int i = 0; i < 5000; i++) {
+        sample += "GET /index.html 200 "[i % 20];
+    }
+    {
+        std::ofstream out("dictionary_sample.txt", std::ios::binary);
+        out << sample;
+    }
+    Dictionary trained = Dictionary::train({"dictionary_sample.txt"}, 
+                                           DEFAULT_DICTIONARY_CODE_LENGTH);
+    trained.save("dictionary_test.zdic");
+    Dictionary loaded("dictionary_test.zdic");
+    assert(loaded.id() == trained.id());
+    assert(loaded.lengths() == trained.lengths());
+    assert(maxCodeLength(loaded.lengths()) <= 
+                                        DEFAULT_DICTIONARY_CODE_LENGTH);
+
+    CoderOptions options;
+    options.dictionary = &loaded;
+    HuffmanCoder coder(options);
+    // the last byte never occurs in the sample
+    std::string message = "GET /index.html 404\xff";
+    const unsigned char* bytes = 
+                reinterpret_cast<const unsigned char *>(message.data());
+    std::vector<unsigned char> zapped, decoded;
+    coder.compress(bytes, message.size(), zapped);
+    assert(std::string(zapped.begin(), zapped.begin() + 4) == "ZMSG");
+    uint64_t bits = 0;
+    for (unsigned char c : message) {
+        bits += loaded.lengths()[c];
+    }
+    assert(zapped.size() == 4 + 4 + 1 + (bits + 7) / 8);
+    coder.decompress(zapped.data(), zapped.size(), decoded);
+    assert(std::string(decoded.begin(), decoded.end()) == message);
+
+    // files work the same way
+    {
+        std::ofstream out("dictionary_test.txt", std::ios::binary);
+        out << message;
+    }
+    coder.encoder("dictionary_test.txt", "dictionary_test.zap");
+    coder.decoder("dictionary_test.zap", "dictionary_test.out");
+    std::ifstream decoded_file("dictionary_test.out", std::ios::binary);
+    std::ostringstream contents;
+    contents << decoded_file.rdbuf();
+    assert(contents.str() == message);
+
+    FrequencyTable other_frequencies = {};
+    other_frequencies['x'] = 100;
+    Dictionary other = Dictionary::fromFrequencies(other_frequencies, 16);
+    assert(other.id() != loaded.id());
+    CoderOptions other_options;
+    other_options.dictionary = &other;
+    HuffmanCoder wrong(other_options);
+    HuffmanCoder missing;
+    for (HuffmanCoder* decoder : {&wrong, &missing}) {
+        expectRuntimeError([&]() {
+            decoder->decompress(zapped.data(), zapped.size(), decoded);
+        });
+    }
+
+    std::remove("dictionary_sample.txt");
+    std::remove("dictionary_test.zdic");
+    std::remove("dictionary_test.txt");
+    std::remove("dictionary_test.zap");
+    std::remove("dictionary_test.out");
+}
+
+// testRawAndRunBlocks(): Checks that a stream stores noise as a RAW_BLOCK,
+// a run of one byte as a RUN_BLOCK and text as a HUFFMAN_BLOCK, that the
+// noise grows by only its headers, and that the mix decodes.
+void testRawAndRunBlocks() {
+    std::string text = noiseText(4096, 12345); // noise no code can shrink
+    text += std::string(4096, 'x');
+    for (int i = 0; i < 4096; i++) {
+        text += static_cast<char>('a' + (i * 7 + i / 300) % 19);
+    }
+    CoderOptions options;
+    options.block_size = 4096;
+    options.interleave = true;
+    HuffmanCoder coder(options);
+    std::vector<unsigned char> zapped, decoded;
+    coder.compress(reinterpret_cast<const unsigned char *>(text.data()),
+                   text.size(), zapped);
+
+    FileReader in(zapped.data() + 4, zapped.size() - 4); // past the magic
+    uint64_t block_size = readStreamHeader(in);
+    const BlockType expected[] = {RAW_BLOCK, RUN_BLOCK, INTERLEAVED_BLOCK};
+    for (BlockType type : expected) {
+        BlockHeader header = readBlockHeader(in, block_size);
+        assert(header.type == type);
+        assert(header.text_size == 4096);
+        std::string payload(header.payload_size, '\0');
+        assert(in.read(&payload[0], payload.size()) == payload.size());
+        if (type == RAW_BLOCK) {
+            assert(payload == text.substr(0, 4096));
+        } else if (type == RUN_BLOCK) {
+            assert(payload == "x");
+        }
+    }
+    assert(readBlockHeader(in, block_size).type == END_BLOCK);
+
+    coder.decompress(zapped.data(), zapped.size(), decoded);
+    assert(std::string(decoded.begin(), decoded.end()) == text);
+}
+
+// testSplitBlocks(): Checks that splitBlock cuts where text turns into
+// noise and back but leaves uniform text whole, and that a --split
+// stream comes out smaller than one code per block and still decodes.
+void testSplitBlocks() {
+    std::string letters;
+    for (int i = 0; i < 3 * (int)SPLIT_SEGMENT_SIZE; i++) {
+        letters += static_cast<char>('a' + (i * 7 + i / 300) % 9);
+    }
+    std::string noise = noiseText(letters.size(), 777);
+    std::string text = letters + noise + letters;
+    std::vector<size_t> pieces;
+    splitBlock(reinterpret_cast<const unsigned char *>(text.data()),
+               text.size(), pieces);
+    assert(pieces.size() == 3);
+    assert(pieces[0] == letters.size() and pieces[1] == noise.size());
+    splitBlock(reinterpret_cast<const unsigned char *>(letters.data()),
+               letters.size(), pieces);
+    assert(pieces.size() == 1 and pieces[0] == letters.size());
+
+    CoderOptions options;
+    options.block_size = text.size();
+    HuffmanCoder whole_coder(options);
+    options.split_blocks = true;
+    HuffmanCoder split_coder(options);
+    std::vector<unsigned char> whole, split, decoded;
+    const unsigned char* bytes = 
+                reinterpret_cast<const unsigned char *>(text.data());
+    whole_coder.compress(bytes, text.size(), whole);
+    split_coder.compress(bytes, text.size(), split);
+    assert(split.size() < whole.size());
+    split_coder.decompress(split.data(), split.size(), decoded);
+    assert(std::string(decoded.begin(), decoded.end()) == text);
+}
+
+// testContextBlocks(): Checks that the context map survives a round trip,
+// that --context codes text whose bytes depend on the byte before as a
+// smaller CONTEXT_BLOCK that decodes, and that noise still goes raw.
+void testContextBlocks() {
+    ContextMap cluster_of;
+    for (int context = 0; context < 256; context++) {
+        cluster_of[context] = static_cast<uint8_t>(context % 11);
+    }
+    std::string map = serializeContextMap(cluster_of, 11);
+    size_t pos = 0;
+    int clusters = 0;
+    assert(deserializeContextMap(map, pos, clusters) == cluster_of);
+    assert(clusters == 11 and pos == map.size());
+
+    std::string text;
+    for (unsigned char choice : noiseText(20000, 99)) { // from two next
+        char previous = text.empty() ? 'a' : text.back();
+        text += static_cast<char>('a' + (previous - 'a' + 1 + 
+                                         (choice >> 6) % 2) % 26);
+    }
+    const unsigned char* bytes = 
+                reinterpret_cast<const unsigned char *>(text.data());
+    CoderOptions options;
+    options.block_size = 1 << 16;
+    HuffmanCoder order0_coder(options);
+    options.context_model = true;
+    HuffmanCoder context_coder(options);
+    std::vector<unsigned char> order0, zapped, decoded;
+    order0_coder.compress(bytes, text.size(), order0);
+    context_coder.compress(bytes, text.size(), zapped);
+    // magic, 3-byte block size
+    assert(zapped[7] == (CONTEXT_BLOCK | CHECKSUM_FLAG));
+    assert(zapped.size() * 3 < order0.size());
+    context_coder.decompress(zapped.data(), zapped.size(), decoded);
+    assert(std::string(decoded.begin(), decoded.end()) == text);
+
+    std::string noise = noiseText(5000, 100);
+    context_coder.compress(reinterpret_cast<const unsigned char *>(
+                                    noise.data()), noise.size(), zapped);
+    assert(zapped[7] == (RAW_BLOCK | CHECKSUM_FLAG));
+}
+
+// testBlockTransforms(): Checks the BWT of "banana", that every pipeline
+// undoes itself on runs and noise, that a corrupt BWT row is caught, and
+// that a "ZBLT" stream records its pipeline and decodes.
+void testBlockTransforms() {
+    TransformPipeline bwt;
+    assert(parseTransforms("bwt", bwt));
+    std::string text = "banana", scratch;
+    uint64_t size = text.size();
+    forwardTransforms(bwt, text, size, scratch);
+    assert(text == std::string("\3\0\0\0nnbaaa", 10) and size == 10);
+
+    std::string sample = std::string(4, 'a') + "b" + std::string(259, 'c') + 
+                         std::string(260, 'd') + "abracadabra";
+    sample += noiseText(3000, 5);
+    const char* lists[] = {"rle", "bwt", "mtf", "bwt,mtf,rle", "rle,rle"};
+    for (const char* list : lists) {
+        TransformPipeline pipeline;
+        assert(parseTransforms(list, pipeline));
+        text = sample;
+        size = text.size();
+        forwardTransforms(pipeline, text, size, scratch);
+        assert(size <= transformedSizeBound(pipeline, sample.size()));
+        inverseTransforms(pipeline, text, size, sample.size(), scratch);
+        assert(text == sample and size == sample.size());
+    }
+    TransformPipeline pipeline;
+    assert(not parseTransforms("bwt,zip", pipeline));
+    assert(not parseTransforms("", pipeline));
+
+    text = std::string("\7\0\0\0nnbaaa", 10); // row 7 of 6
+    size = text.size();
+    expectRuntimeError([&]() {
+        inverseTransforms(bwt, text, size, 6, scratch);
+    });
+
+    CoderOptions options;
+    options.block_size = 1000;
+    assert(parseTransforms("bwt,mtf", options.transforms));
+    HuffmanCoder coder(options);
+    std::vector<unsigned char> zapped, decoded;
+    coder.compress(reinterpret_cast<const unsigned char *>(sample.data()), 
+                   sample.size(), zapped);
+    assert(std::string(zapped.begin(), zapped.begin() + 7) == 
+                            std::string("ZBLT\2\2\3", 7));
+    coder.decompress(zapped.data(), zapped.size(), decoded);
+    assert(std::string(decoded.begin(), decoded.end()) == sample);
+}
+
+// testStats(): Checks the counters compress and decompress keep: bytes in
+// and out, blocks, and a code no shorter than the entropy bound; and that
+// the JSON report carries them.
+void testStats() {
+    std::string text;
+    for (unsigned char byte : noiseText(5000, 11)) {
+        text += "aaaabbc"[byte % 7];
+    }
+    CoderOptions options;
+    options.block_size = 1000;
+    HuffmanCoder coder(options);
+    std::vector<unsigned char> zapped, decoded;
+    coder.compress(reinterpret_cast<const unsigned char *>(text.data()), 
+                   text.size(), zapped);
+    CoderStats stats = coder.statistics();
+    assert(stats.input_bytes == text.size());
+    assert(stats.output_bytes == zapped.size());
+    assert(stats.blocks == 5 and stats.symbols == text.size());
+    assert(stats.code_bits >= stats.entropy_bits);
+    assert(stats.code_bits <= stats.entropy_bits + stats.symbols);
+    assert(stats.max_code_length == 2); // a is 1 bit, b and c are 2
+
+    std::ostringstream report;
+    printStats(report, stats, "zap", true);
+    std::string json = report.str();
+    assert(json.front() == '{' and json.find("}\n") == json.size() - 2);
+    assert(json.find("\"input_bytes\": 5000,") != std::string::npos);
+    assert(json.find("\"blocks\": 5,") != std::string::npos);
+    assert(json.find("\"thread_seconds\": {") != std::string::npos);
+
+    // stage times with -j are summed over the workers, and say so
+    options.jobs = 3;
+    HuffmanCoder parallel(options);
+    parallel.compress(reinterpret_cast<const unsigned char *>(text.data()),
+                      text.size(), zapped);
+    assert(parallel.statistics().threads == 3);
+    report.str("");
+    printStats(report, parallel.statistics(), "zap", true);
+    assert(report.str().find("\"threads\": 3,") != std::string::npos);
+    report.str("");
+    printStats(report, parallel.statistics(), "zap", false);
+    assert(report.str().find("summed over 3 threads") != std::string::npos);
+
+    coder.decompress(zapped.data(), zapped.size(), decoded);
+    stats = coder.statistics();
+    assert(stats.input_bytes == zapped.size());
+    assert(stats.output_bytes == text.size() and stats.blocks == 5);
+    assert(stats.symbols == 0 and stats.max_code_length == 2);
+}
+
+// testBatch(): Zaps a directory of files file by file and into an archive
+// on three workers, checks both unzap to the originals, and that an
+// archive naming a file outside the output directory is refused.
+void testBatch() {
+    const char* dirs[] = {"batch_test_in", "batch_test_in/sub"};
+    for (const char* dir : dirs) {
+        ::mkdir(dir, 0755);
+    }
+    std::vector<std::string> names = {"a.txt", "b.txt", "empty.txt",
+                                      "sub/c.txt"};
+    std::vector<std::string> texts;
+    for (size_t k = 0; k < names.size(); k++) {
+        std::string text = (k == 2) ? "" : std::string(3000 + 1000 * k, 
+                                                       char('a' + k));
+        text += (k == 2) ? "" : "zapped in a batch";
+        std::ofstream("batch_test_in/" + names[k], std::ios::binary) << text;
+        texts.push_back(text);
+    }
+    std::vector<BatchFile> files = listBatchFiles("batch_test_in");
+    assert(files.size() == 4 and files[3].name == "sub/c.txt");
+
+    CoderOptions options;
+    options.jobs = 3;
+    BatchCoder coder(options);
+    assert(coder.zap(files, "batch_test_zap") == 4);
+    assert(coder.statistics().input_bytes == 3000 + 4000 + 6000 + 51);
+    assert(coder.unzap(listBatchFiles("batch_test_zap"), 
+                       "batch_test_out") == 4);
+    assert(coder.zapArchive(files, "batch_test.zarc") == 4);
+    assert(isBatchArchive("batch_test.zarc"));
+    assert(not isBatchArchive("batch_test_in"));
+    assert(coder.unzapArchive("batch_test.zarc", "batch_test_arc") == 4);
+    for (size_t k = 0; k < names.size(); k++) {
+        std::ifstream out("batch_test_out/" + names[k], std::ios::binary);
+        std::ifstream arc("batch_test_arc/" + names[k], std::ios::binary);
+        std::stringstream from_files, from_archive;
+        from_files << out.rdbuf();
+        from_archive << arc.rdbuf();
+        assert(from_files.str() == texts[k]);
+        assert(from_archive.str() == texts[k]);
+    }
+
+    std::string escape = ARCHIVE_MAGIC;
+    putVarint(escape, 4);
+    escape += "../x";
+    putVarint(escape, 0);
+    std::ofstream("batch_test.zarc", std::ios::binary) << escape;
+    expectRuntimeError([&]() {
+        coder.unzapArchive("batch_test.zarc", "batch_test_arc");
+    });
+
+    std::remove("batch_test.zarc");
+    const char* roots[] = {"batch_test_in", "batch_test_zap", 
+                           "batch_test_out", "batch_test_arc"};
+    for (const char* root : roots) {
+        std::string dir = root;
+        for (size_t k = 0; k < names.size(); k++) {
+            std::string suffix = (dir == "batch_test_zap") ? ".zap" : "";
+            std::remove((dir + "/" + names[k] + suffix).c_str());
+        }
+        std::remove((dir + "/sub").c_str());
+        std::remove(dir.c_str());
+    }
+}
+
+// testBlockIndex(): Zaps a text into many small blocks, with and without a
+// transform, and checks that ranges inside a block, across blocks, past
+// the end and of no bytes unzap to the same bytes as the whole text, from
+// memory and from a file; and that an index not matching its blocks is
+// refused.
+void testBlockIndex() {
+    std::string text;
+    for (int k = 0; k < 700; k++) {
+        text += "line " + std::to_string(k * 7919 % 1000) + " of the index\n";
+    }
+    const unsigned char* bytes = 
+                    reinterpret_cast<const unsigned char *>(text.data());
+    for (bool transformed : {false, true}) {
+        CoderOptions options;
+        options.block_size = 1000;
+        options.jobs = 2;
+        if (transformed) {
+            options.transforms = {BWT_TRANSFORM, MTF_TRANSFORM};
+        }
+        HuffmanCoder coder(options);
+        std::vector<unsigned char> zapped, range;
+        coder.compress(bytes, text.size(), zapped);
+        coder.decompress(zapped.data(), zapped.size(), range);
+        assert(std::string(range.begin(), range.end()) == text);
+
+        uint64_t ranges[][2] = {{0, 10}, {1500, 200}, {999, 2}, 
+                                {2500, 4000}, {text.size() - 5, 100}, 
+                                {text.size() + 10, 5}, {3000, 0}};
+        for (auto& r : ranges) {
+            coder.decompressRange(zapped.data(), zapped.size(), r[0], r[1],
+                                  range);
+            std::string expected = r[0] < text.size() 
+                                    ? text.substr(r[0], r[1]) : "";
+            assert(std::string(range.begin(), range.end()) == expected);
+        }
+        // a range never touches the blocks before it
+        std::vector<unsigned char> damaged = zapped;
+        damaged[60] ^= 0xff; // inside the first block
+        coder.decompressRange(damaged.data(), damaged.size(), 1500, 200, 
+                              range);
+        assert(std::string(range.begin(), range.end()) == 
+               text.substr(1500, 200));
+
+        std::ofstream("index_test.zap", std::ios::binary).write(
+            reinterpret_cast<const char *>(zapped.data()), zapped.size());
+        coder.decodeRange("index_test.zap", "index_test.txt", 4321, 1234);
+        std::ifstream out("index_test.txt", std::ios::binary);
+        std::stringstream decoded;
+        decoded << out.rdbuf();
+        assert(decoded.str() == text.substr(4321, 1234));
+
+        // the first index entry follows the end block, after the count
+        size_t index_size = 0;
+        for (int k = 0; k < 8; k++) {
+            index_size |= static_cast<size_t>(
+                zapped[zapped.size() - INDEX_FOOTER_SIZE + k]) << (8 * k);
+        }
+        size_t entry = zapped.size() - INDEX_FOOTER_SIZE - index_size + 2;
+        zapped[entry + 1]--; // the first block's coded size, now wrong
+        expectRuntimeError([&]() {
+            coder.decompressRange(zapped.data(), zapped.size(), 0, 10, 
+                                  range);
+        });
+    }
+    std::remove("index_test.zap");
+    std::remove("index_test.txt");
+}
+
+// testPipelinedIO(): Reads a file of several chunks through a read-ahead
+// reader in uneven pieces and writes it back through a write-behind 
+// writer, mixing small, large and repeated writes; checks both match the
+// same work done on the calling thread, that zap and unzap agree with
+// pipelining on and off, and that a failed write is thrown.
+void testPipelinedIO() {
+    std::string text = noiseText(3 * FileWriter::CHUNK_SIZE + 12345, 7);
+    for (char& c : text) {
+        c = static_cast<char>('a' + (static_cast<unsigned char>(c) >> 4));
+    }
+    std::ofstream("pipeline_test.txt", std::ios::binary) << text;
+
+    for (bool pipelined : {false, true}) {
+        FileReader input("pipeline_test.txt");
+        FileWriter output("pipeline_test.out");
+        if (pipelined) {
+            input.readAhead();
+            output.writeBehind();
+        }
+        std::string piece(FileWriter::CHUNK_SIZE + 7, '\0');
+        size_t sizes[] = {1, 100, FileReader::BUFFER_SIZE, 
+                          FileWriter::CHUNK_SIZE + 7, 3};
+        size_t got, k = 0;
+        while ((got = input.read(&piece[0], sizes[k++ % 5])) > 0) {
+            output.write(piece.data(), got);
+        }
+        assert(input.bytesRead() == text.size());
+        output.writeRepeated('z', 2 * FileWriter::CHUNK_SIZE + 1);
+        output.close();
+        std::ifstream out("pipeline_test.out", std::ios::binary);
+        std::stringstream written;
+        written << out.rdbuf();
+        assert(written.str() == text + 
+                        std::string(2 * FileWriter::CHUNK_SIZE + 1, 'z'));
+    }
+
+    for (bool pipelined : {false, true}) {
+        CoderOptions options;
+        options.block_size = 100000;
+        options.pipelined_io = pipelined;
+        HuffmanCoder coder(options);
+        coder.encoder("pipeline_test.txt", "pipeline_test.zap");
+        coder.decoder("pipeline_test.zap", "pipeline_test.out");
+        std::ifstream out("pipeline_test.out", std::ios::binary);
+        std::stringstream decoded;
+        decoded << out.rdbuf();
+        assert(decoded.str() == text);
+    }
+
+#ifdef __linux__
+    FileWriter full("/dev/full"); // every write fails with ENOSPC
+    full.writeBehind();
+    expectRuntimeError([&]() {
+        full.write(text); // a chunk may fail before the last is queued
+        full.close();
+    });
+#endif
+    std::remove("pipeline_test.txt");
+    std::remove("pipeline_test.zap");
+    std::remove("pipeline_test.out");
+}
+
+// testAdaptive(): Zaps text whose letters change half way as an adaptive
+// stream and checks it unzaps, shrinks, and is cut into segments of the
+// interval; that a truncated stream is refused; and, through a pipe, that
+// the first segment reaches the output before the input has ended.
+void testAdaptive() {
+    std::string text;
+    for (int k = 0; k < 20000; k++) {
+        text += (k < 10000) ? "abcab" : "0120";
+    }
+    CoderOptions options;
+    options.adaptive_interval = 4096;
+    HuffmanCoder coder(options);
+    std::vector<unsigned char> zapped, decoded;
+    coder.compress(reinterpret_cast<const unsigned char *>(text.data()),
+                   text.size(), zapped);
+    assert(hasMagic(std::string(zapped.begin(), zapped.end()),
+                    ADAPTIVE_MAGIC));
+    assert(coder.statistics().blocks == (text.size() + 4095) / 4096);
+    // the first segment is stored at 8 bits a byte and the switch to digits
+    // takes a few segments to learn, but the rest codes near 2 bits a byte
+    assert(zapped.size() < text.size() / 2);
+    int longest = coder.statistics().max_code_length;
+    assert(longest > 0);
+    coder.decompress(zapped.data(), zapped.size(), decoded);
+    assert(std::string(decoded.begin(), decoded.end()) == text);
+    assert(coder.statistics().max_code_length == longest);
+
+    coder.compress(nullptr, 0, zapped);
+    coder.decompress(zapped.data(), zapped.size(), decoded);
+    assert(decoded.empty());
+
+    coder.compress(reinterpret_cast<const unsigned char *>(text.data()),
+                   text.size(), zapped);
+    expectRuntimeError([&]() {
+        coder.decompress(zapped.data(), zapped.size() / 2, decoded);
+    });
+
+#ifdef __linux__
+    int ends[2];
+    assert(pipe(ends) == 0);
+    bool output_early = false;
+    std::thread producer([&]() {
+        // a little text, then wait for zapped bytes before the rest
+        assert(write(ends[1], text.data(), 1000) == 1000);
+        for (int tries = 0; tries < 500 and not output_early; tries++) {
+            struct stat info;
+            output_early = stat("adaptive_test.zap", &info) == 0 and 
+                           info.st_size > 0;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        assert(write(ends[1], text.data() + 1000, text.size() - 1000) == 
+               static_cast<ssize_t>(text.size() - 1000));
+        close(ends[1]);
+    });
+    coder.encoder("/dev/fd/" + std::to_string(ends[0]), "adaptive_test.zap");
+    producer.join();
+    close(ends[0]);
+    assert(output_early);
+    coder.decoder("adaptive_test.zap", "adaptive_test.out");
+    std::ifstream out("adaptive_test.out", std::ios::binary);
+    std::stringstream unzapped;
+    unzapped << out.rdbuf();
+    assert(unzapped.str() == text);
+    std::remove("adaptive_test.zap");
+    std::remove("adaptive_test.out");
+#endif
+}
+
+// testDecodeKernels(): Decodes text coded with length limits that pick each
+// specialized decoding loop, and the generic one, both from one stream and
+// from four interleaved ones; and checks a loop still rejects cut bits.
+void testDecodeKernels() {
+    // halving frequencies would give codes about 40 bits deep
+    FrequencyTable frequencies = {};
+    for (int symbol = 0; symbol < 256; symbol++) {
+        frequencies[symbol] = 1 + (symbol < 40 ? uint64_t(1) << (40 - symbol)
+                                               : 0);
+    }
+    std::string text = noiseText(10007, 12345); // not whole groups
+    const int limits[] = {10, 12, 14, 20};
+    const int kernels[] = {11, 12, 15, 0};
+    for (int k = 0; k < 4; k++) {
+        CodeTable codes = canonicalCodes(
+                lengthLimitedCodeLengths(frequencies, limits[k]));
+        HuffmanDecodeTable table;
+        table.build(codes);
+        assert(table.maxCodeLength() == limits[k]);
+        assert(table.kernelLength() == kernels[k]);
+
+        BitWriter whole;
+        BitWriter parts[4];
+        for (size_t i = 0; i < text.size(); i++) {
+            const HuffmanCode& code = codes[static_cast<unsigned char>(
+                                                text[i])];
+            whole.write(code.bits, code.length);
+            parts[i % 4].write(code.bits, code.length);
+        }
+        whole.flush();
+        BitReader reader(reinterpret_cast<const unsigned char *>(
+                            whole.bytes().data()), whole.bytes().size(),
+                         whole.bitCount());
+        std::string decoded;
+        table.decode(reader, text.size(), decoded);
+        assert(decoded == text);
+
+        std::vector<BitReader> readers;
+        for (BitWriter& part : parts) {
+            part.flush();
+            readers.push_back(BitReader(reinterpret_cast<const unsigned char *>(
+                                part.bytes().data()), part.bytes().size(),
+                              part.bitCount()));
+        }
+        decoded.clear();
+        table.decodeInterleaved(readers.data(), 4, text.size(), decoded);
+        assert(decoded == text);
+
+        BitReader cut(reinterpret_cast<const unsigned char *>(
+                        whole.bytes().data()), whole.bytes().size(),
+                      whole.bitCount() - 1);
+        expectRuntimeError([&]() {
+            decoded.clear();
+            table.decode(cut, text.size(), decoded);
+        });
+    }
+}
+
+// testWriteCodes(): Checks that writing a whole text with writeCodes packs
+// the same bits as writing its codes one by one, for code lengths that
+// pick each group size and the fallback, after bits already pending, and
+// across several write slices.
+void testWriteCodes() {
+    FrequencyTable frequencies = {};
+    for (int symbol = 0; symbol < 256; symbol++) {
+        frequencies[symbol] = 1 + (symbol < 40 ? uint64_t(1) << (40 - symbol)
+                                               : 0);
+    }
+    std::string noise = noiseText(200003, 777);
+    std::vector<unsigned char> text(noise.begin(), noise.end());
+    const int limits[] = {9, 11, 14, 18, 28};
+    for (int k = 0; k < 6; k++) {
+        CodeLengths lengths = (k < 5)
+                ? lengthLimitedCodeLengths(frequencies, limits[k])
+                : huffmanCodeLengths(frequencies);
+        CodeTable codes = canonicalCodes(lengths);
+        assert(k < 5 or maxCodeLength(lengths) > 28);
+        BitWriter one_by_one, bulk;
+        one_by_one.write(5, 3);
+        bulk.write(5, 3);
+        for (unsigned char symbol : text) {
+            one_by_one.write(codes[symbol].bits, codes[symbol].length);
+        }
+        bulk.writeCodes(text.data(), text.size(), codes);
+        bulk.writeCodes(text.data(), 7, codes); // a short call keeps going
+        for (int i = 0; i < 7; i++) {
+            one_by_one.write(codes[text[i]].bits, codes[text[i]].length);
+        }
+        assert(bulk.bitCount() == one_by_one.bitCount());
+        one_by_one.flush();
+        bulk.flush();
+        assert(bulk.bytes() == one_by_one.bytes());
+    }
+}
+
+// testBlockChecksums(): Checks the CRC-32C kernels against the standard
+// check value and each other, that a block stream refuses a block whose
+// text was corrupted, naming it, also when only a range is unzapped, and
+// that --no-checksums writes blocks without one.
+void testBlockChecksums() {
+    const unsigned char check[] = "123456789";
+    assert(crc32c(check, 9) == 0xe3069283);
+    assert(crc32cScalar(check, 9) == 0xe3069283);
+    std::string noise = noiseText(5000, 4242);
+    const unsigned char* bytes = 
+                reinterpret_cast<const unsigned char *>(noise.data());
+    for (size_t size : {0, 1, 7, 8, 9, 63, 1000, 4999}) {
+        assert(crc32c(bytes, size) == crc32cScalar(bytes, size));
+    }
+
+    // noise is stored raw, so a changed byte decodes without complaint
+    // unless the checksum catches it
+    CoderOptions options;
+    options.block_size = 1000;
+    HuffmanCoder coder(options);
+    std::vector<unsigned char> zapped, decoded;
+    coder.compress(bytes, noise.size(), zapped);
+    // magic, 2-byte block size, then per block a type byte, two 2-byte
+    // lengths, the checksum and the text
+    size_t block_bytes = 1 + 2 + 2 + 4 + 1000;
+    assert(zapped[6] == (RAW_BLOCK | CHECKSUM_FLAG));
+    zapped[6 + 2 * block_bytes + 9 + 500] ^= 0x10;
+    assert(expectRuntimeError([&]() {
+        coder.decompress(zapped.data(), zapped.size(), decoded);
+    }) == "Zapped block 2 does not match its checksum.");
+    assert(expectRuntimeError([&]() {
+        coder.decompressRange(zapped.data(), zapped.size(), 2990, 20, 
+                              decoded);
+    }) == "Zapped block 2 does not match its checksum.");
+    coder.decompressRange(zapped.data(), zapped.size(), 3000, 20, decoded);
+    assert(std::string(decoded.begin(), decoded.end()) == 
+           noise.substr(3000, 20));
+
+    options.block_checksums = false;
+    HuffmanCoder unchecked(options);
+    unchecked.compress(bytes, noise.size(), zapped);
+    assert(zapped[6] == RAW_BLOCK);
+    unchecked.decompress(zapped.data(), zapped.size(), decoded);
+    assert(std::string(decoded.begin(), decoded.end()) == noise);
+}
+
+// testHardenedTreeParser(): Feeds the tree parser serialized trees that are
+// cut short, too deep, padded or repeat a byte, and checks each is refused
+// while the deepest allowed tree is rebuilt; then decodes a legacy file in
+// bounded pieces and checks cut bits are still refused.
+void testHardenedTreeParser() {
+    HuffmanCoder hc;
+    // a caterpillar: each internal node's left child is a leaf
+    std::string deepest;
+    for (int i = 0; i < 64; i++) {
+        deepest += "IL";
+        deepest += static_cast<char>(i);
+    }
+    deepest += "L";
+    deepest += static_cast<char>(64);
+    {
+        TreeArena arena;
+        HuffmanTreeNode* root = hc.deserializeHuffmanTree(deepest, arena);
+        assert(arena.size() == 129);
+        HuffmanDecodeTable table;
+        table.build(root);
+        assert(table.maxCodeLength() == 64);
+    }
+
+    std::string too_deep = "IL" + std::string(1, '\xff') + deepest;
+    const std::string malformed[] = {
+        "L", "IL", "ILa", "ILaL", "ILaLbL", "ILaLbX", "ILaLa", "X",
+        std::string(100000, 'I'), too_deep
+    };
+    for (const std::string& tree : malformed) {
+        TreeArena arena;
+        assert(expectRuntimeError([&]() {
+            hc.deserializeHuffmanTree(tree, arena);
+        }) == "Huffman tree is malformed.");
+    }
+    TreeArena empty;
+    assert(hc.deserializeHuffmanTree("", empty) == nullptr);
+
+    // a legacy file coded with the deepest tree, whose codes are 1 to 64
+    // bits long, decodes through runs of whole codes and a one-by-one tail
+    TreeArena arena;
+    HuffmanTreeNode* root = hc.deserializeHuffmanTree(deepest, arena);
+    CodeTable codes = {};
+    hc.generateCharCodes(root, codes);
+    std::string text;
+    for (int i = 0; i < 100000; i++) {
+        text += static_cast<char>(i % 3 == 0 ? i % 65 : 0);
+    }
+    BitWriter bits;
+    hc.encodeText(text, codes, bits);
+    bits.flush();
+    PackedBinaryIO binary_io;
+    std::string file = binary_io.fileHeader(deepest, bits.bitCount(), 
+                                            "test") + bits.bytes();
+    std::vector<unsigned char> zapped(file.begin(), file.end()), decoded;
+    hc.decompress(zapped.data(), zapped.size(), decoded);
+    assert(std::string(decoded.begin(), decoded.end()) == text);
+
+    // one bit fewer in the count leaves the last code cut short
+    size_t count_pos = 7 + deepest.size();
+    for (size_t pos = count_pos; zapped[pos]-- == 0; pos++) {}
+    expectRuntimeError([&]() {
+        hc.decompress(zapped.data(), zapped.size(), decoded);
+    });
+}
+
+// testOversizeHeaders(): Feeds the decoder short streams whose block and
+// segment headers claim the largest sizes the format allows, and checks
+// each fails as truncated, on one thread and on several.
+void testOversizeHeaders() {
+    uint64_t text_size = MAX_BLOCK_SIZE;
+    std::string block = BLOCK_MAGIC;
+    putVarint(block, MAX_BLOCK_SIZE);
+    block += static_cast<char>(HUFFMAN_BLOCK);
+    putVarint(block, text_size);
+    putVarint(block, maxPayloadSize(text_size));
+    block += "ab";
+    std::string segment = ADAPTIVE_MAGIC;
+    putVarint(segment, MAX_BLOCK_SIZE);
+    putVarint(segment, 63);
+    putVarint(segment, text_size);
+    putVarint(segment, (text_size * 63 + 7) / 8);
+    segment += "ab";
+
+    const std::string streams[] = {block, segment};
+    const char *messages[] = {"Zapped block stream is truncated.",
+                              "Zapped adaptive stream is truncated."};
+    for (int jobs : {1, 4}) {
+        CoderOptions options;
+        options.jobs = jobs;
+        HuffmanCoder coder(options);
+        for (int k = 0; k < 2; k++) {
+            std::vector<unsigned char> decoded;
+            assert(expectRuntimeError([&]() {
+                coder.decompress(reinterpret_cast<const unsigned char *>(
+                                    streams[k].data()), streams[k].size(),
+                                 decoded);
+            }) == messages[k]);
+        }
+    }
+}
+
+// testSameFileRefused(): Checks that zap, unzap and a ranged unzap refuse
+// an output that is their input, by its own name or through a hard link,
+// and leave the file as it was.
+void testSameFileRefused() {
+    std::string text = "the same file, twice over\n";
+    std::ofstream("same_test.txt", std::ios::binary) << text;
+    std::remove("same_test.link");
+    assert(::link("same_test.txt", "same_test.link") == 0);
+    HuffmanCoder coder;
+    for (const char* output : {"same_test.txt", "same_test.link"}) {
+        assert(expectRuntimeError([&]() {
+            coder.encoder("same_test.txt", output);
+        }) == "Cannot zap same_test.txt onto itself.");
+    }
+    coder.encoder("same_test.txt", "same_test.zap");
+    std::ifstream zap_in("same_test.zap", std::ios::binary);
+    std::stringstream zapped;
+    zapped << zap_in.rdbuf();
+    for (const char* output : {"same_test.zap", "./same_test.zap"}) {
+        assert(expectRuntimeError([&]() {
+            coder.decoder("same_test.zap", output);
+        }) == "Cannot unzap same_test.zap onto itself.");
+        assert(expectRuntimeError([&]() {
+            coder.decodeRange("same_test.zap", output, 0, 4);
+        }) == "Cannot unzap same_test.zap onto itself.");
+    }
+    std::ifstream text_in("same_test.txt", std::ios::binary);
+    std::stringstream kept;
+    kept << text_in.rdbuf();
+    assert(kept.str() == text);
+    std::ifstream zap_again("same_test.zap", std::ios::binary);
+    std::stringstream zapped_again;
+    zapped_again << zap_again.rdbuf();
+    assert(zapped_again.str() == zapped.str() and not zapped.str().empty());
+    std::remove("same_test.txt");
+    std::remove("same_test.link");
+    std::remove("same_test.zap");
+}